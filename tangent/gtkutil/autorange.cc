@@ -0,0 +1,334 @@
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/gtkutil/autorange.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tangent/gtkutil/workerpool.h"
+
+namespace colormap {
+
+namespace {
+
+/// Samples are processed in blocks of this many elements: first the minimum
+/// and maximum of the block are computed (growing the bins if needed), and
+/// then the block, which is still in cache, is binned.
+const size_t kBlockSize = 16 * 1024;
+
+/// Updates smaller than this are not worth splitting across threads
+const size_t kParallelThreshold = 1024 * 1024;
+
+const double kInf = std::numeric_limits<double>::infinity();
+
+template <typename T>
+void minmax_scalar(const T* data, size_t n, Range* out) {
+  for (size_t idx = 0; idx < n; idx++) {
+    double value = data[idx];
+    if (std::isfinite(value)) {
+      out->min = std::min(out->min, value);
+      out->max = std::max(out->max, value);
+    }
+  }
+}
+
+}  // namespace
+
+// NOTE(josh): In the SIMD implementations non-finite lanes are replaced with
+// +inf (for the minimum) or -inf (for the maximum) so that they never win the
+// comparison. NaN compares false for `|x| < inf` so it is excluded as well.
+#ifdef __SSE2__
+
+Range get_minmax(const float* data, size_t n) {
+  const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+  const __m128 neg_inf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 lo = inf;
+  __m128 hi = neg_inf;
+
+  size_t idx = 0;
+  for (; idx + 4 <= n; idx += 4) {
+    __m128 x = _mm_loadu_ps(data + idx);
+    __m128 valid = _mm_cmplt_ps(_mm_and_ps(x, abs_mask), inf);
+    __m128 x_lo = _mm_or_ps(_mm_and_ps(valid, x), _mm_andnot_ps(valid, inf));
+    __m128 x_hi =
+        _mm_or_ps(_mm_and_ps(valid, x), _mm_andnot_ps(valid, neg_inf));
+    lo = _mm_min_ps(lo, x_lo);
+    hi = _mm_max_ps(hi, x_hi);
+  }
+
+  float lanes_lo[4];
+  float lanes_hi[4];
+  _mm_storeu_ps(lanes_lo, lo);
+  _mm_storeu_ps(lanes_hi, hi);
+  Range out{kInf, -kInf};
+  for (size_t lane = 0; lane < 4; lane++) {
+    out.min = std::min<double>(out.min, lanes_lo[lane]);
+    out.max = std::max<double>(out.max, lanes_hi[lane]);
+  }
+  minmax_scalar(data + idx, n - idx, &out);
+  return out;
+}
+
+Range get_minmax(const double* data, size_t n) {
+  const __m128d inf = _mm_set1_pd(kInf);
+  const __m128d neg_inf = _mm_set1_pd(-kInf);
+  const __m128d abs_mask =
+      _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+  __m128d lo = inf;
+  __m128d hi = neg_inf;
+
+  size_t idx = 0;
+  for (; idx + 2 <= n; idx += 2) {
+    __m128d x = _mm_loadu_pd(data + idx);
+    __m128d valid = _mm_cmplt_pd(_mm_and_pd(x, abs_mask), inf);
+    __m128d x_lo = _mm_or_pd(_mm_and_pd(valid, x), _mm_andnot_pd(valid, inf));
+    __m128d x_hi =
+        _mm_or_pd(_mm_and_pd(valid, x), _mm_andnot_pd(valid, neg_inf));
+    lo = _mm_min_pd(lo, x_lo);
+    hi = _mm_max_pd(hi, x_hi);
+  }
+
+  double lanes_lo[2];
+  double lanes_hi[2];
+  _mm_storeu_pd(lanes_lo, lo);
+  _mm_storeu_pd(lanes_hi, hi);
+  Range out{std::min(lanes_lo[0], lanes_lo[1]),
+            std::max(lanes_hi[0], lanes_hi[1])};
+  minmax_scalar(data + idx, n - idx, &out);
+  return out;
+}
+
+#else
+
+Range get_minmax(const float* data, size_t n) {
+  Range out{kInf, -kInf};
+  minmax_scalar(data, n, &out);
+  return out;
+}
+
+Range get_minmax(const double* data, size_t n) {
+  Range out{kInf, -kInf};
+  minmax_scalar(data, n, &out);
+  return out;
+}
+
+#endif  // __SSE2__
+
+RangeEstimator::RangeEstimator(size_t nbins)
+    : bins_(std::max<size_t>(2, nbins + (nbins % 2)), 0),
+      bin_range_{0, 0},
+      minmax_{kInf, -kInf},
+      count_{0} {}
+
+void RangeEstimator::reset() {
+  std::fill(bins_.begin(), bins_.end(), 0);
+  bin_range_ = Range{0, 0};
+  minmax_ = Range{kInf, -kInf};
+  count_ = 0;
+}
+
+void RangeEstimator::update(const float* data, size_t n,
+                            unsigned int nthreads) {
+  if (nthreads != 1 && n >= kParallelThreshold) {
+    update_parallel(data, n, nthreads);
+  } else {
+    update_serial(data, n);
+  }
+}
+
+void RangeEstimator::update(const double* data, size_t n,
+                            unsigned int nthreads) {
+  if (nthreads != 1 && n >= kParallelThreshold) {
+    update_parallel(data, n, nthreads);
+  } else {
+    update_serial(data, n);
+  }
+}
+
+template <typename T>
+void RangeEstimator::update_serial(const T* data, size_t n) {
+  for (size_t begin = 0; begin < n; begin += kBlockSize) {
+    size_t block_size = std::min(kBlockSize, n - begin);
+    Range block_minmax = colormap::get_minmax(data + begin, block_size);
+    if (block_minmax.min <= block_minmax.max) {
+      accumulate_block(data + begin, block_size, block_minmax);
+    }
+  }
+}
+
+template <typename T>
+void RangeEstimator::update_parallel(const T* data, size_t n,
+                                     unsigned int nthreads) {
+  if (!nthreads) {
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  WorkerPool* pool = WorkerPool::get_default();
+  size_t chunk_size = (n + nthreads - 1) / nthreads;
+
+  // NOTE(josh): The bins are first grown to cover all of the samples and then
+  // every partial starts with those same bins. No partial ever needs to grow,
+  // so merging them back is exact, bin for bin.
+  std::vector<Range> chunk_minmax(nthreads);
+  pool->run(nthreads, [&](size_t idx) {
+    size_t begin = std::min(n, idx * chunk_size);
+    size_t chunk_end = std::min(n, begin + chunk_size);
+    chunk_minmax[idx] = colormap::get_minmax(data + begin, chunk_end - begin);
+  });
+  Range data_minmax{kInf, -kInf};
+  for (const Range& range : chunk_minmax) {
+    data_minmax.min = std::min(data_minmax.min, range.min);
+    data_minmax.max = std::max(data_minmax.max, range.max);
+  }
+  if (!(data_minmax.min <= data_minmax.max)) {
+    return;
+  }
+  if (bin_range_.max > bin_range_.min) {
+    grow(data_minmax);
+  } else {
+    set_bin_range(data_minmax);
+  }
+
+  RangeEstimator seed(bins_.size());
+  seed.bin_range_ = bin_range_;
+  std::vector<RangeEstimator> partials(nthreads, seed);
+  pool->run(nthreads, [&](size_t idx) {
+    size_t begin = std::min(n, idx * chunk_size);
+    size_t chunk_end = std::min(n, begin + chunk_size);
+    partials[idx].update_serial(data + begin, chunk_end - begin);
+  });
+  for (const RangeEstimator& partial : partials) {
+    merge(partial);
+  }
+}
+
+template <typename T>
+void RangeEstimator::accumulate_block(const T* data, size_t n,
+                                      Range block_minmax) {
+  if (!(bin_range_.max > bin_range_.min)) {
+    set_bin_range(block_minmax);
+  } else {
+    grow(block_minmax);
+  }
+  minmax_.min = std::min(minmax_.min, block_minmax.min);
+  minmax_.max = std::max(minmax_.max, block_minmax.max);
+
+  const double offset = bin_range_.min;
+  const double scale = bins_.size() / (bin_range_.max - bin_range_.min);
+  const size_t last = bins_.size() - 1;
+  uint64_t* bins = bins_.data();
+  for (size_t idx = 0; idx < n; idx++) {
+    double value = data[idx];
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    size_t bin = static_cast<size_t>(std::max(0.0, (value - offset) * scale));
+    bins[std::min(bin, last)]++;
+    count_++;
+  }
+}
+
+void RangeEstimator::set_bin_range(Range range) {
+  bin_range_ = range;
+  if (!(bin_range_.max > bin_range_.min)) {
+    // All samples so far are identical, give the bins some nonzero width
+    // that is small relative to the value.
+    double width = std::max(std::fabs(bin_range_.min), 1.0) / (1 << 20);
+    bin_range_.min -= width / 2;
+    bin_range_.max += width / 2;
+  }
+}
+
+void RangeEstimator::grow(Range range) {
+  const size_t half = bins_.size() / 2;
+  while (range.min < bin_range_.min || range.max > bin_range_.max) {
+    double width = bin_range_.max - bin_range_.min;
+    if (range.min < bin_range_.min) {
+      // merge pairs into the upper half, iterating downward so that we don't
+      // overwrite a bin before it is read.
+      for (size_t idx = half; idx > 0; idx--) {
+        bins_[half + idx - 1] = bins_[2 * idx - 2] + bins_[2 * idx - 1];
+      }
+      std::fill(bins_.begin(), bins_.begin() + half, 0);
+      bin_range_.min -= width;
+    } else {
+      for (size_t idx = 0; idx < half; idx++) {
+        bins_[idx] = bins_[2 * idx] + bins_[2 * idx + 1];
+      }
+      std::fill(bins_.begin() + half, bins_.end(), 0);
+      bin_range_.max += width;
+    }
+  }
+}
+
+void RangeEstimator::merge(const RangeEstimator& other) {
+  if (!other.count_) {
+    return;
+  }
+  if (!count_) {
+    reset();
+    bin_range_ = other.bin_range_;
+  } else {
+    grow(other.bin_range_);
+  }
+
+  if (bin_range_.min == other.bin_range_.min &&
+      bin_range_.max == other.bin_range_.max &&
+      bins_.size() == other.bins_.size()) {
+    for (size_t idx = 0; idx < bins_.size(); idx++) {
+      bins_[idx] += other.bins_[idx];
+    }
+    minmax_.min = std::min(minmax_.min, other.minmax_.min);
+    minmax_.max = std::max(minmax_.max, other.minmax_.max);
+    count_ += other.count_;
+    return;
+  }
+
+  // NOTE(josh): each bin of `other` is assigned to the bin containing its
+  // center, which may misplace its samples by up to one bin.
+  const double other_width =
+      (other.bin_range_.max - other.bin_range_.min) / other.bins_.size();
+  const double scale = bins_.size() / (bin_range_.max - bin_range_.min);
+  const size_t last = bins_.size() - 1;
+  for (size_t idx = 0; idx < other.bins_.size(); idx++) {
+    if (!other.bins_[idx]) {
+      continue;
+    }
+    double center = other.bin_range_.min + (idx + 0.5) * other_width;
+    size_t bin = static_cast<size_t>(
+        std::max(0.0, (center - bin_range_.min) * scale));
+    bins_[std::min(bin, last)] += other.bins_[idx];
+  }
+  minmax_.min = std::min(minmax_.min, other.minmax_.min);
+  minmax_.max = std::max(minmax_.max, other.minmax_.max);
+  count_ += other.count_;
+}
+
+double RangeEstimator::get_percentile(double pct) const {
+  if (!count_) {
+    return 0;
+  }
+  double target = std::min(std::max(pct, 0.0), 100.0) / 100.0 * count_;
+  double width = (bin_range_.max - bin_range_.min) / bins_.size();
+  uint64_t cumulative = 0;
+  for (size_t idx = 0; idx < bins_.size(); idx++) {
+    if (bins_[idx] && cumulative + bins_[idx] >= target) {
+      double frac = (target - cumulative) / bins_[idx];
+      double value = bin_range_.min + (idx + frac) * width;
+      return std::min(std::max(value, minmax_.min), minmax_.max);
+    }
+    cumulative += bins_[idx];
+  }
+  return minmax_.max;
+}
+
+Range RangeEstimator::get_range(double lower, double upper) const {
+  return Range{get_percentile(lower), get_percentile(upper)};
+}
+
+}  // namespace colormap
@@ -0,0 +1,95 @@
+#pragma once
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tangent/gtkutil/colormap.h"
+
+namespace colormap {
+
+/// Streaming estimator for the range and distribution of a collection of
+/// samples, used to choose the range of a colormap (e.g. clipping at the 1st
+/// and 99th percentile) without sorting a copy of the data.
+///
+/// Samples are accumulated into a fixed number of equal-width bins. The bins
+/// are sized to the data seen so far, and when new samples fall outside of
+/// them the bin width is doubled (merging adjacent pairs of bins) until they
+/// are covered. Each call to `update()` makes a single pass over the data, in
+/// cache-sized blocks, so the estimator may be fed incrementally as data
+/// streams in. Percentiles are accurate to within one bin width. Non-finite
+/// samples (NaN and +/-inf) are ignored.
+class RangeEstimator {
+ public:
+  explicit RangeEstimator(size_t nbins = 4096);
+
+  /// Accumulate `n` samples. If `nthreads` is not one and `n` is large, the
+  /// samples are split across the threads of `WorkerPool::get_default()`
+  /// (zero means the number of hardware threads) and the partial results,
+  /// which all share the same bins, are merged.
+  void update(const float* data, size_t n, unsigned int nthreads = 1);
+  void update(const double* data, size_t n, unsigned int nthreads = 1);
+
+  /// Accumulate the samples of another estimator into this one
+  void merge(const RangeEstimator& other);
+
+  /// Discard all accumulated samples
+  void reset();
+
+  /// Return the number of (finite) samples accumulated so far
+  uint64_t get_count() const {
+    return count_;
+  }
+
+  /// Return the exact minimum and maximum of the samples accumulated so far
+  Range get_minmax() const {
+    return minmax_;
+  }
+
+  /// Return the approximate value at percentile `pct` (in [0, 100])
+  double get_percentile(double pct) const;
+
+  /// Return the approximate range spanning the `lower` and `upper`
+  /// percentiles, suitable to pass to `ColorMap::rescale()`.
+  Range get_range(double lower, double upper) const;
+
+  /// Return the counts of each bin, and the range that the bins span
+  const std::vector<uint64_t>& get_bins() const {
+    return bins_;
+  }
+
+  Range get_bin_range() const {
+    return bin_range_;
+  }
+
+ private:
+  template <typename T>
+  void update_serial(const T* data, size_t n);
+
+  template <typename T>
+  void update_parallel(const T* data, size_t n, unsigned int nthreads);
+
+  template <typename T>
+  void accumulate_block(const T* data, size_t n, Range block_minmax);
+
+  // Double the width of the bins (possibly repeatedly) until they span
+  // `range`.
+  void grow(Range range);
+
+  // Set the range of the (empty) bins to `range`, widened slightly if it is
+  // a single value.
+  void set_bin_range(Range range);
+
+  std::vector<uint64_t> bins_;
+  Range bin_range_;
+  Range minmax_;
+  uint64_t count_;
+};
+
+/// Return the minimum and maximum of the finite samples among `n` at `data`.
+/// If there are no finite samples then the returned range has min > max.
+Range get_minmax(const float* data, size_t n);
+Range get_minmax(const double* data, size_t n);
+
+}  // namespace colormap
@@ -4,7 +4,11 @@
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
 #include <type_traits>
 
 namespace colormap {
@@ -17,11 +21,27 @@ struct Color3 {
   T b;
 };
 
+/// Color with straight (not premultiplied) alpha
+template <typename T>
+struct Color4 {
+  typedef T value_type;
+  T r;
+  T g;
+  T b;
+  T a;
+};
+
 typedef Color3<unsigned int> Color3u;
 typedef Color3<float> Color3f;
 
+/// Packed 8-bit colors. These hold the same values as `Color3u` in a quarter
+/// of the storage, so they are the preferred entry type for tables that are
+/// consulted per-pixel.
+typedef Color3<uint8_t> Color3b;
+typedef Color4<uint8_t> Color4b;
+
 template <class Color>
-Color lerp(const Color a, const Color b, double interp) {
+constexpr Color lerp(const Color a, const Color b, double interp) {
   return Color{
       static_cast<typename Color::value_type>(a.r * interp +
                                               b.r * (1.0 - interp)),  //
@@ -32,6 +52,45 @@ Color lerp(const Color a, const Color b, double interp) {
   };
 }
 
+template <typename T>
+constexpr Color4<T> lerp(const Color4<T> a, const Color4<T> b,
+                         double interp) {
+  return Color4<T>{
+      static_cast<T>(a.r * interp + b.r * (1.0 - interp)),
+      static_cast<T>(a.g * interp + b.g * (1.0 - interp)),
+      static_cast<T>(a.b * interp + b.b * (1.0 - interp)),
+      static_cast<T>(a.a * interp + b.a * (1.0 - interp)),
+  };
+}
+
+/// Blend a single integer channel with a 16.16 fixed-point weight: returns
+/// `a * interp + b * (1 - interp)` rounded to nearest, where `interp` is in
+/// [0, 65536]. Bit-identical to the integer SIMD span kernels.
+inline int lerp_fixed(int a, int b, uint32_t interp) {
+  return b + (((a - b) * static_cast<int>(interp >> 1) + 0x4000) >> 15);
+}
+
+/// Integer-only variant of `lerp()` for 8-bit channel values (i.e. Color3u,
+/// Color3b, Color4b) with a 16.16 fixed-point weight in [0, 65536].
+template <typename T>
+Color3<T> lerp_fixed(const Color3<T> a, const Color3<T> b, uint32_t interp) {
+  static_assert(std::is_integral<T>::value,
+                "fixed-point interpolation requires integral channels");
+  return Color3<T>{static_cast<T>(lerp_fixed(a.r, b.r, interp)),
+                   static_cast<T>(lerp_fixed(a.g, b.g, interp)),
+                   static_cast<T>(lerp_fixed(a.b, b.b, interp))};
+}
+
+template <typename T>
+Color4<T> lerp_fixed(const Color4<T> a, const Color4<T> b, uint32_t interp) {
+  static_assert(std::is_integral<T>::value,
+                "fixed-point interpolation requires integral channels");
+  return Color4<T>{static_cast<T>(lerp_fixed(a.r, b.r, interp)),
+                   static_cast<T>(lerp_fixed(a.g, b.g, interp)),
+                   static_cast<T>(lerp_fixed(a.b, b.b, interp)),
+                   static_cast<T>(lerp_fixed(a.a, b.a, interp))};
+}
+
 struct Range {
   double min;
   double max;
@@ -54,24 +113,391 @@ void convert(const Color3<T> in, Color3<U>* out) {
   }
 }
 
+/// Convert to a color with an alpha channel. The output is fully opaque.
+template <typename T, typename U>
+void convert(const Color3<T> in, Color4<U>* out) {
+  Color3<U> rgb;
+  convert(in, &rgb);
+  out->r = rgb.r;
+  out->g = rgb.g;
+  out->b = rgb.b;
+  out->a = std::is_integral<U>::value ? 255 : 1;
+}
+
+/// Transform applied to sample values before they are placed on a colormap.
+/// A sample `x` in the range `[min, max]` is placed at
+/// `(f(x) - f(min)) / (f(max) - f(min))` of the way through the colormap,
+/// where `f` is determined by `kind`. The transform is fused into the table
+/// lookup and the batch kernels, so there is no need for a separate pass over
+/// the data.
+struct Norm {
+  enum Kind {
+    LINEAR,  ///< f(x) = x
+    LOG,     ///< f(x) = log10(x), non-positive values map to the bottom
+    SYMLOG,  ///< f(x) = sign(x) * log10(1 + |x| / param)
+    POWER,   ///< f(x) = sign(x) * |x|^param
+  };
+
+  Kind kind;
+  double param;  ///< linear threshold for SYMLOG, exponent for POWER
+
+  static Norm linear() {
+    return Norm{LINEAR, 0};
+  }
+
+  static Norm log() {
+    return Norm{LOG, 0};
+  }
+
+  static Norm symlog(double linthresh = 1.0) {
+    return Norm{SYMLOG, linthresh};
+  }
+
+  static Norm power(double gamma) {
+    return Norm{POWER, gamma};
+  }
+
+  /// Evaluate `f(x)`. NaN is passed through.
+  double transform(double x) const {
+    switch (kind) {
+      case LINEAR:
+        return x;
+      case LOG:
+        if (!(x > 0)) {
+          return std::isnan(x) ? x : -std::numeric_limits<double>::infinity();
+        }
+        return std::log10(x);
+      case SYMLOG:
+        return std::copysign(std::log10(1.0 + std::fabs(x) / param), x);
+      case POWER:
+        return std::copysign(std::pow(std::fabs(x), param), x);
+    }
+    return x;
+  }
+
+  /// Return the fractional position of `x` within `range` after applying the
+  /// transform. The result is not clamped.
+  double normalize(double x, Range range) const {
+    double lower = transform(range.min);
+    double upper = transform(range.max);
+    return (transform(x) - lower) / (upper - lower);
+  }
+};
+
+/// Return the range spanning the `lower` and `upper` percentiles (each in
+/// [0, 100]) of the `n` samples at `data`. NaN samples are ignored. This is
+/// the clip range of a "percentile-clip" normalization, and may be passed to
+/// `ColorMap::rescale()`.
+Range get_percentile_range(const float* data, size_t n, double lower,
+                           double upper);
+
+/// Color space in which adjacent supports are blended when baking a table
+enum Interpolation {
+  INTERP_SRGB,   ///< blend the stored (sRGB) values directly, as `get()` does
+  INTERP_OKLAB,  ///< blend in the perceptually uniform OKLab space
+};
+
+/// Convert an sRGB color with channels in [0, 1] to OKLab. The output fields
+/// `r`, `g`, `b` hold the `L`, `a`, `b` coordinates respectively.
+Color3<double> srgb_to_oklab(const Color3<double>& srgb);
+
+/// Convert an OKLab color (stored as for `srgb_to_oklab`) to sRGB with
+/// channels clamped to [0, 1].
+Color3<double> oklab_to_srgb(const Color3<double>& lab);
+
+/// Pack a color into a single CAIRO_FORMAT_ARGB32 pixel (native-endian,
+/// premultiplied alpha). Channels are clamped to the valid range.
+template <typename Color>
+uint32_t pack_argb32(const Color color, double alpha = 1.0) {
+  Color3<double> unit;
+  convert(color, &unit);
+  alpha = std::min(std::max(alpha, 0.0), 1.0);
+  double channels[3] = {unit.r, unit.g, unit.b};
+  uint32_t out = static_cast<uint32_t>(alpha * 255.0 + 0.5) << 24;
+  for (size_t idx = 0; idx < 3; idx++) {
+    double value = std::min(std::max(channels[idx], 0.0), 1.0) * alpha;
+    out |= static_cast<uint32_t>(value * 255.0 + 0.5) << (8 * (2 - idx));
+  }
+  return out;
+}
+
+/// Pack a color with (straight) alpha into a single premultiplied
+/// CAIRO_FORMAT_ARGB32 pixel.
+inline uint32_t pack_argb32(const Color4b color) {
+  uint32_t alpha = color.a;
+  uint32_t channels[3] = {color.r, color.g, color.b};
+  uint32_t out = alpha << 24;
+  for (size_t idx = 0; idx < 3; idx++) {
+    out |= ((channels[idx] * alpha + 127) / 255) << (8 * (2 - idx));
+  }
+  return out;
+}
+
+/// Parameters for the batch colorization kernels. A sample `x` is written
+/// as `lut[clamp((f(x) - offset) * scale, 0, size - 1)]` where `f` is the
+/// transform of `norm`. NaN samples are written as `bad`.
+struct Argb32Kernel {
+  const uint32_t* lut;  ///< table of packed ARGB32 pixels
+  uint32_t size;        ///< number of entries in `lut`
+  float offset;         ///< value of `f(x)` at the start of `lut`
+  float scale;          ///< number of table entries per unit of `f(x)`
+  uint32_t bad;         ///< packed ARGB32 pixel written for NaN samples
+  Norm norm;            ///< transform applied to each sample
+};
+
+/// Colorize `n` samples from `in` into `n` pixels in `out`. Dispatches at
+/// runtime to an AVX2, SSE4.1, or scalar implementation depending on what the
+/// host supports. Non-linear norms are evaluated by the scalar
+/// implementation in the same pass.
+void map_span_argb32(const Argb32Kernel& kernel, const float* in, size_t n,
+                     uint32_t* out);
+
+/// Colorize a `width` x `height` block of samples. `in_stride` is the
+/// distance (in elements) between the start of consecutive input rows, and
+/// `out_stride` is the distance (in bytes) between the start of consecutive
+/// output rows, such as returned by `cairo_image_surface_get_stride()`.
+void map_span_argb32(const Argb32Kernel& kernel, const float* in,
+                     size_t in_stride, size_t width, size_t height,
+                     uint8_t* out, size_t out_stride);
+
+/// Like `map_span_argb32` but blends the two `lut` entries bracketing each
+/// sample, using 16.16 fixed-point weights in integer SIMD lanes (see
+/// `lerp_fixed()`). A sample is placed at position
+/// `clamp((f(x) - offset) * scale, 0, size - 1)` and entry `i` is the color
+/// at position `i`. Tables larger than 32768 entries fall back to
+/// `map_span_argb32`, since adjacent entries are then indistinguishable.
+void map_span_argb32_lerp(const Argb32Kernel& kernel, const float* in,
+                          size_t n, uint32_t* out);
+
+/// Colorize `n` integer labels (e.g. a segmentation image) into `n` pixels
+/// in `out`, wrapping labels that exceed the table:
+/// `out[i] = lut[in[i] % size]`. Dispatches like `map_span_argb32`; the
+/// vectorized implementations compute the remainder with a floating point
+/// reciprocal and an integer correction rather than a division.
+void map_labels_argb32(const uint32_t* lut, uint32_t size, const uint16_t* in,
+                       size_t n, uint32_t* out);
+void map_labels_argb32(const uint32_t* lut, uint32_t size, const uint32_t* in,
+                       size_t n, uint32_t* out);
+
+/// Return the name of the instruction set used by `map_span_argb32` on this
+/// host (one of "avx2", "sse4.1", or "scalar").
+const char* get_span_isa();
+
+/// Lookup tables are aligned to (at least) this many bytes so that a table
+/// never straddles more cache lines than it needs to.
+const size_t kCacheLineSize = 64;
+
+/// Allocate uninitialized storage for `count` objects of `T`, aligned to
+/// `kCacheLineSize`. Only suitable for trivial types.
+template <typename T>
+std::shared_ptr<T> make_aligned_array(size_t count) {
+  void* mem = nullptr;
+  size_t nbytes = std::max<size_t>(count, 1) * sizeof(T);
+  if (posix_memalign(&mem, kCacheLineSize, nbytes)) {
+    return std::shared_ptr<T>();
+  }
+  return std::shared_ptr<T>(static_cast<T*>(mem), free);
+}
+
+/// Number of entries in tables baked implicitly by the convenience span API
+const size_t kDefaultTableSize = 1024;
+
+template <typename Color>
+class ColorMap;
+
+/// A dense sampling of a ColorMap over its range. Lookup is a single
+/// multiply-add followed by an index into cache-aligned storage, so this is
+/// the preferred path for colorizing large fields. Lookup tables are created
+/// with ColorMap::bake(). Copies are cheap and share the (immutable) storage.
+template <typename Color>
+class LookupTable {
+ public:
+  LookupTable()
+      : size_{0}, range_{0, 0}, norm_(Norm::linear()), scale_{0}, bias_{0} {}
+
+  /// Return the index of the table entry for the value `x`. Values outside
+  /// of the range (and NaN) are clamped to the first or last entry.
+  size_t index(double x) const {
+    if (norm_.kind != Norm::LINEAR) {
+      x = norm_.transform(x);
+    }
+    double float_index = x * scale_ + bias_;
+    // NOTE(josh): written such that NaN compares false and maps to zero
+    if (!(float_index > 0)) {
+      return 0;
+    }
+    if (float_index >= size_) {
+      return size_ - 1;
+    }
+    return static_cast<size_t>(float_index);
+  }
+
+  Color get(double x) const {
+    return data_.get()[index(x)];
+  }
+
+  Color operator()(double x) const {
+    return get(x);
+  }
+
+  /// Return a pointer to the first entry of the table
+  const Color* data() const {
+    return data_.get();
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  Range get_range() const {
+    return range_;
+  }
+
+  Norm get_norm() const {
+    return norm_;
+  }
+
+  /// Return a pointer to the first entry of the table, with each entry packed
+  /// as an opaque CAIRO_FORMAT_ARGB32 pixel.
+  const uint32_t* argb32() const {
+    return argb_.get();
+  }
+
+  /// Return the parameters for the batch kernels which evaluate this table
+  Argb32Kernel get_kernel() const {
+    Argb32Kernel kernel;
+    kernel.lut = argb_.get();
+    kernel.size = static_cast<uint32_t>(size_);
+    kernel.offset = static_cast<float>(norm_.transform(range_.min));
+    kernel.scale = static_cast<float>(scale_);
+    kernel.bad = size_ ? argb_.get()[0] : 0;
+    kernel.norm = norm_;
+    return kernel;
+  }
+
+  /// Colorize `n` samples into premultiplied ARGB32 pixels, such as the
+  /// buffer returned by `cairo_image_surface_get_data()`.
+  void map_span(const float* in, size_t n, uint32_t* argb_out) const {
+    map_span_argb32(get_kernel(), in, n, argb_out);
+  }
+
+  /// Colorize a block of samples into an ARGB32 image. `in_stride` is in
+  /// elements, `out_stride` is in bytes. See `map_span_argb32()`.
+  void map_span(const float* in, size_t in_stride, size_t width,
+                size_t height, uint8_t* argb_out, size_t out_stride) const {
+    map_span_argb32(get_kernel(), in, in_stride, width, height, argb_out,
+                    out_stride);
+  }
+
+  /// Colorize `n` integer labels into premultiplied ARGB32 pixels. Entry
+  /// `label % size()` is used for each label, so this is intended for tables
+  /// created with `ColorMap::categorical()`.
+  void map_labels(const uint16_t* in, size_t n, uint32_t* argb_out) const {
+    map_labels_argb32(argb_.get(), static_cast<uint32_t>(size_), in, n,
+                      argb_out);
+  }
+
+  void map_labels(const uint32_t* in, size_t n, uint32_t* argb_out) const {
+    map_labels_argb32(argb_.get(), static_cast<uint32_t>(size_), in, n,
+                      argb_out);
+  }
+
+  /// Return the parameters for `map_span_argb32_lerp()`. Entry `i` of the
+  /// table is the color at the center of its bin, so the kernel is offset by
+  /// half of an entry.
+  Argb32Kernel get_lerp_kernel() const {
+    Argb32Kernel kernel = get_kernel();
+    if (scale_ > 0) {
+      kernel.offset = static_cast<float>(norm_.transform(range_.min) +
+                                         0.5 / scale_);
+    }
+    return kernel;
+  }
+
+  /// Colorize `n` samples into premultiplied ARGB32 pixels, blending
+  /// adjacent table entries in fixed-point. This removes the banding of a
+  /// small (e.g. 256 entry) table at close to the cost of `map_span()`.
+  void map_span_lerp(const float* in, size_t n, uint32_t* argb_out) const {
+    map_span_argb32_lerp(get_lerp_kernel(), in, n, argb_out);
+  }
+
+  /// Return the multiplier and offset which map a (transformed) value in the
+  /// range to a (floating point) index into the table:
+  /// `index = f(x) * scale + bias`.
+  double get_scale() const {
+    return scale_;
+  }
+
+  double get_bias() const {
+    return bias_;
+  }
+
+ private:
+  template <typename>
+  friend class ColorMap;
+
+  LookupTable(Range range, Norm norm, size_t size)
+      : data_{make_aligned_array<Color>(size)},
+        argb_{make_aligned_array<uint32_t>(size)},
+        size_{(data_ && argb_) ? size : 0},
+        range_(range),
+        norm_(norm),
+        scale_{0},
+        bias_{0} {
+    double lower = norm.transform(range.min);
+    double upper = norm.transform(range.max);
+    if (upper > lower) {
+      scale_ = size_ / (upper - lower);
+      bias_ = -lower * scale_;
+    }
+  }
+
+  std::shared_ptr<Color> data_;
+  std::shared_ptr<uint32_t> argb_;
+  size_t size_;
+  Range range_;
+  Norm norm_;
+  double scale_;
+  double bias_;
+};
+
 template <typename Color>
 class ColorMap {
  public:
   template <size_t N>
-  explicit ColorMap(const Color (&supports)[N])
-      : supports_{supports}, nsupports_{N}, range_{0, N} {}
+  constexpr explicit ColorMap(const Color (&supports)[N])
+      : supports_{supports},
+        nsupports_{N},
+        range_{0, N},
+        norm_{Norm::LINEAR, 0} {}
 
-  ColorMap(const Color* supports, size_t nsupports)
+  constexpr ColorMap(const Color* supports, size_t nsupports)
       : supports_{supports},
         nsupports_{nsupports},
-        range_{0, static_cast<double>(nsupports)} {}
+        range_{0, static_cast<double>(nsupports)},
+        norm_{Norm::LINEAR, 0} {}
 
+  /// Return a copy of this colormap spanning the range [x_min, x_max]
   ColorMap rescale(double x_min, double x_max) const {
-    ColorMap rescaled(supports_, nsupports_);
-    rescaled.range = {x_min, x_max};
+    ColorMap rescaled(*this);
+    rescaled.range_ = {x_min, x_max};
     return rescaled;
   }
 
+  /// Return a copy of this colormap spanning `range`
+  ColorMap rescale(Range range) const {
+    return rescale(range.min, range.max);
+  }
+
+  /// Return a copy of this colormap which applies `norm` to samples before
+  /// placing them within the range. The norm is carried through to tables
+  /// baked from the returned map.
+  ColorMap with_norm(Norm norm) const {
+    ColorMap normed(*this);
+    normed.norm_ = norm;
+    return normed;
+  }
+
   template <class OtherColor>
   OtherColor as(double x) {
     OtherColor out;
@@ -80,43 +506,182 @@ class ColorMap {
   }
 
   Color get(double x) const {
-    x = std::min(x, range_.max);
-    double float_index =
-        ((x - range_.min) / (range_.max - range_.min)) * nsupports_;
+    return get_normalized(norm_.normalize(x, range_));
+  }
+
+  /// Same as `get()` but, for maps with integral channels, the supports are
+  /// blended with a 16.16 fixed-point weight (see `lerp_fixed()`) rather than
+  /// in double precision. The result is rounded to nearest rather than
+  /// truncated, so it may differ from `get()` by one in each channel.
+  Color get_fixed(double x) const {
+    double float_index = norm_.normalize(x, range_) * nsupports_;
+    if (!(float_index > 0)) {
+      float_index = 0;
+    }
+    float_index = std::min<double>(float_index, nsupports_ - 1);
+    uint32_t fixed_index = static_cast<uint32_t>(float_index * 65536.0);
+    size_t lower_idx = fixed_index >> 16;
+    size_t upper_idx = std::min<size_t>(lower_idx + 1, nsupports_ - 1);
+    return lerp_fixed(supports_[upper_idx], supports_[lower_idx],
+                      fixed_index & 0xffff);
+  }
 
-    size_t lower_idx = std::max<size_t>(0, std::floor(float_index));
-    size_t upper_idx = std::min<size_t>(nsupports_ - 1, std::ceil(float_index));
+  /// Return the color at the fractional position `t` through the colormap,
+  /// where 0 is the first support and 1 is the end of the last. Values
+  /// outside of [0, 1] (and NaN) are clamped.
+  Color get_normalized(double t) const {
+    size_t lower_idx = 0;
+    size_t upper_idx = 0;
+    double interp = 0;
+    locate(t, &lower_idx, &upper_idx, &interp);
     if (lower_idx == upper_idx) {
       return supports_[lower_idx];
     }
-
-    double prev = lower_idx * (range_.max - range_.min) / nsupports_;
-    double next = upper_idx * (range_.max - range_.min) / nsupports_;
-    double interp = (x - prev) / (next - prev);
     return lerp(supports_[upper_idx], supports_[lower_idx], interp);
   }
 
-  size_t get_nsupports() const {
+  /// Sample the colormap at `size` evenly spaced points (the centers of
+  /// `size` equal bins spanning the current range) and return the resulting
+  /// lookup table. Typical sizes are 256, 1024, or 4096 entries. `get()`
+  /// remains the exact reference implementation; the table is accurate to
+  /// within half of a bin.
+  ///
+  /// With INTERP_OKLAB the supports are converted to OKLab once, blended
+  /// there, and converted back for each entry. Lookups into the resulting
+  /// table cost the same as for an sRGB table.
+  ///
+  /// The entry type of the table may differ from that of the map, e.g.
+  /// `bake<Color3b>()` stores 8-bit channels, a quarter of the storage of
+  /// `Color3u`.
+  template <typename Out = Color>
+  LookupTable<Out> bake(size_t size,
+                        Interpolation method = INTERP_SRGB) const {
+    LookupTable<Out> table(range_, norm_, size);
+    Out* data = table.data_.get();
+    uint32_t* argb = table.argb_.get();
+
+    std::unique_ptr<Color3<double>[]> lab;
+    if (method == INTERP_OKLAB) {
+      lab.reset(new Color3<double>[nsupports_]);
+      for (size_t idx = 0; idx < nsupports_; idx++) {
+        Color3<double> srgb;
+        convert(supports_[idx], &srgb);
+        lab[idx] = srgb_to_oklab(srgb);
+      }
+    }
+
+    for (size_t idx = 0; idx < table.size_; idx++) {
+      double t = (idx + 0.5) / table.size_;
+      if (lab) {
+        size_t lower_idx = 0;
+        size_t upper_idx = 0;
+        double interp = 0;
+        locate(t, &lower_idx, &upper_idx, &interp);
+        Color3<double> blend = lab[lower_idx];
+        if (lower_idx != upper_idx) {
+          blend = lerp(lab[upper_idx], lab[lower_idx], interp);
+        }
+        convert(oklab_to_srgb(blend), &data[idx]);
+      } else {
+        convert(get_normalized(t), &data[idx]);
+      }
+      argb[idx] = pack_argb32(data[idx]);
+    }
+    return table;
+  }
+
+  /// Return the color of category `label` for qualitative maps (e.g. ACCENT,
+  /// SET1). Each support is one category and labels wrap around, so no
+  /// interpolation is done and the range and norm are ignored.
+  Color get_category(size_t label) const {
+    return supports_[label % nsupports_];
+  }
+
+  /// Return a table with one entry per support, for colorizing label images
+  /// with `LookupTable::map_labels()`. The table spans [0, nsupports) so that
+  /// `index()` and `get()` also map a label to its own category.
+  template <typename Out = Color>
+  LookupTable<Out> categorical() const {
+    LookupTable<Out> table(Range{0, static_cast<double>(nsupports_)},
+                           Norm::linear(), nsupports_);
+    for (size_t idx = 0; idx < table.size_; idx++) {
+      convert(supports_[idx], &table.data_.get()[idx]);
+      table.argb_.get()[idx] = pack_argb32(table.data_.get()[idx]);
+    }
+    return table;
+  }
+
+  /// Colorize `n` samples into premultiplied ARGB32 pixels. This bakes a
+  /// table of `kDefaultTableSize` entries on each call, so callers that
+  /// colorize many spans with the same map should `bake()` once and use
+  /// `LookupTable::map_span()` instead.
+  void map_span(const float* in, size_t n, uint32_t* argb_out) const {
+    bake(kDefaultTableSize).map_span(in, n, argb_out);
+  }
+
+  /// Row-strided variant of `map_span()`. `in_stride` is in elements,
+  /// `out_stride` is in bytes.
+  void map_span(const float* in, size_t in_stride, size_t width,
+                size_t height, uint8_t* argb_out, size_t out_stride) const {
+    bake(kDefaultTableSize)
+        .map_span(in, in_stride, width, height, argb_out, out_stride);
+  }
+
+  constexpr size_t get_nsupports() const {
     return nsupports_;
   }
 
-  Range get_range() const {
+  constexpr Range get_range() const {
     return range_;
   }
 
+  constexpr Norm get_norm() const {
+    return norm_;
+  }
+
+  /// Return a pointer to the first support of the colormap
+  constexpr const Color* get_supports() const {
+    return supports_;
+  }
+
   Color operator()(double x) const {
     return get(x);
   }
 
  private:
+  // Find the pair of supports which bracket the fractional position `t` and
+  // the interpolation weight of the upper one.
+  void locate(double t, size_t* lower_idx, size_t* upper_idx,
+              double* interp) const {
+    double float_index = t * nsupports_;
+    // NOTE(josh): written such that NaN compares false and maps to zero
+    if (!(float_index > 0)) {
+      float_index = 0;
+    }
+    float_index = std::min<double>(float_index, nsupports_ - 1);
+
+    *lower_idx = static_cast<size_t>(std::floor(float_index));
+    *upper_idx = static_cast<size_t>(std::ceil(float_index));
+    if (*lower_idx == *upper_idx) {
+      *interp = 0;
+      return;
+    }
+    *interp = float_index - *lower_idx;
+  }
+
   const Color* supports_;
   size_t nsupports_;
   Range range_;
+  Norm norm_;
 };
 
 typedef ColorMap<Color3u> Map3u;
 typedef ColorMap<Color3f> Map3f;
 
+typedef LookupTable<Color3u> Table3u;
+typedef LookupTable<Color3f> Table3f;
+typedef LookupTable<Color3b> Table3b;
+
 enum ColorNames3u {
   ACCENT,
   BLUES,
@@ -0,0 +1,267 @@
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+//
+// Measure the cost per sample of each of the colormap evaluation paths, for
+// each of the named maps, at input sizes which fit in L1, L2, and only in
+// DRAM. Results are printed as one JSON object per line.
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "argue/argue.h"
+#include "tangent/gtkutil/colormap.h"
+
+/// Parsed command line options
+struct ProgramOpts {
+  double min_time;     ///< minimum seconds to spend on each measurement
+  std::string filter;  ///< only run measurements whose path or map matches
+  int table_size;      ///< number of entries in baked tables
+};
+
+/// Input size for a cache level
+struct InputSize {
+  const char* level;
+  size_t nsamples;
+};
+
+// NOTE(josh): float samples, so 16KiB, 256KiB, and 64MiB
+const InputSize kInputSizes[] = {
+    {"L1", 4 * 1024},
+    {"L2", 64 * 1024},
+    {"DRAM", 16 * 1024 * 1024},
+};
+
+struct NamedMap3u {
+  const char* name;
+  colormap::ColorNames3u id;
+};
+
+struct NamedMap3f {
+  const char* name;
+  colormap::ColorNames3f id;
+};
+
+const NamedMap3u kMaps3u[] = {
+    {"accent", colormap::ACCENT},     {"blues", colormap::BLUES},
+    {"brbg", colormap::BRBG},         {"bugn", colormap::BUGN},
+    {"bupu", colormap::BUPU},         {"chromajs", colormap::CHROMAJS},
+    {"dark2", colormap::DARK2},       {"gnbu", colormap::GNBU},
+    {"whgnbu", colormap::WHGNBU},     {"gnpu", colormap::GNPU},
+    {"greens", colormap::GREENS},     {"greys", colormap::GREYS},
+    {"oranges", colormap::ORANGES},   {"orrd", colormap::ORRD},
+    {"paired", colormap::PAIRED},     {"parula", colormap::PARULA},
+    {"pastel1", colormap::PASTEL1},   {"pastel2", colormap::PASTEL2},
+    {"piyg", colormap::PIYG},         {"prgn", colormap::PRGN},
+    {"pubugn", colormap::PUBUGN},     {"pubu", colormap::PUBU},
+    {"puor", colormap::PUOR},         {"purd", colormap::PURD},
+    {"purples", colormap::PURPLES},   {"rdbu", colormap::RDBU},
+    {"rdwhbu", colormap::RDWHBU},     {"rdgy", colormap::RDGY},
+    {"rdpu", colormap::RDPU},         {"rdylbu", colormap::RDYLBU},
+    {"rdylgn", colormap::RDYLGN},     {"reds", colormap::REDS},
+    {"sand", colormap::SAND},         {"set1", colormap::SET1},
+    {"set2", colormap::SET2},         {"set3", colormap::SET3},
+    {"spectral", colormap::SPECTRAL}, {"whylrd", colormap::WHYLRD},
+    {"ylgnbu", colormap::YLGNBU},     {"ylgn", colormap::YLGN},
+    {"ylorbr", colormap::YLORBR},     {"ylorrd", colormap::YLORRD},
+    {"ylrd", colormap::YLRD},
+};
+
+const NamedMap3f kMaps3f[] = {
+    {"inferno", colormap::INFERNO},   {"jet", colormap::JET},
+    {"magma", colormap::MAGMA},       {"moreland", colormap::MORELAND},
+    {"plasma", colormap::PLASMA},     {"viridis", colormap::VIRIDIS},
+};
+
+/// Input samples for one size, shared by all of the maps
+struct Inputs {
+  const InputSize* size;
+  std::vector<float> samples;
+  std::vector<uint16_t> labels;
+  std::vector<uint32_t> pixels;
+};
+
+class Bench {
+ public:
+  explicit Bench(const ProgramOpts& opts) : opts_(opts), sink_{0} {}
+
+  // Call `fn` (which processes all samples of `inputs`) until at least
+  // `min_time` has elapsed and print the mean cost per sample.
+  template <class Fn>
+  void measure(const char* path, const char* map_name, const Inputs& inputs,
+               Fn fn) {
+    if (!opts_.filter.empty() &&
+        std::string(path).find(opts_.filter) == std::string::npos &&
+        std::string(map_name).find(opts_.filter) == std::string::npos) {
+      return;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    fn();  // warm up caches and any lazy dispatch
+    size_t reps = 0;
+    Clock::time_point start = Clock::now();
+    std::chrono::duration<double> elapsed{0};
+    do {
+      fn();
+      reps++;
+      elapsed = Clock::now() - start;
+    } while (elapsed.count() < opts_.min_time);
+
+    double ns_per_sample =
+        elapsed.count() * 1e9 / (reps * inputs.size->nsamples);
+    fmt::print(
+        "{{\"path\": \"{}\", \"map\": \"{}\", \"level\": \"{}\", "
+        "\"samples\": {}, \"reps\": {}, \"ns_per_sample\": {:.4f}, "
+        "\"isa\": \"{}\"}}\n",
+        path, map_name, inputs.size->level, inputs.size->nsamples, reps,
+        ns_per_sample, colormap::get_span_isa());
+    std::fflush(stdout);
+  }
+
+  template <typename Color>
+  void run_map(const char* map_name, colormap::ColorMap<Color> map,
+               Inputs* inputs) {
+    const std::vector<float>& samples = inputs->samples;
+    uint32_t* pixels = inputs->pixels.data();
+
+    measure("get", map_name, *inputs, [&]() {
+      for (float x : samples) {
+        accumulate(map.get(x));
+      }
+    });
+    measure("as<Color3b>", map_name, *inputs, [&]() {
+      for (float x : samples) {
+        accumulate(map.template as<colormap::Color3b>(x));
+      }
+    });
+    run_fixed(map_name, map, *inputs);
+
+    colormap::LookupTable<Color> table = map.bake(opts_.table_size);
+    measure("table.get", map_name, *inputs, [&]() {
+      for (float x : samples) {
+        accumulate(table.get(x));
+      }
+    });
+    measure("table.map_span", map_name, *inputs, [&]() {
+      table.map_span(samples.data(), samples.size(), pixels);
+      sink_ += pixels[0];
+    });
+    measure("table.map_span_lerp", map_name, *inputs, [&]() {
+      table.map_span_lerp(samples.data(), samples.size(), pixels);
+      sink_ += pixels[0];
+    });
+
+    colormap::LookupTable<Color> categories = map.categorical();
+    measure("categorical.map_labels", map_name, *inputs, [&]() {
+      categories.map_labels(inputs->labels.data(), inputs->labels.size(),
+                            pixels);
+      sink_ += pixels[0];
+    });
+  }
+
+  uint64_t get_sink() const {
+    return sink_;
+  }
+
+ private:
+  template <typename Color>
+  void accumulate(const Color& color) {
+    sink_ += static_cast<uint64_t>(color.r + color.g + color.b);
+  }
+
+  void run_fixed(const char* map_name, const colormap::Map3u& map,
+                 const Inputs& inputs) {
+    measure("get_fixed", map_name, inputs, [&]() {
+      for (float x : inputs.samples) {
+        accumulate(map.get_fixed(x));
+      }
+    });
+  }
+
+  // Fixed-point interpolation only applies to integral channels
+  void run_fixed(const char*, const colormap::Map3f&, const Inputs&) {}
+
+  const ProgramOpts& opts_;
+  uint64_t sink_;
+};
+
+/// Configure the command line parser
+void setup_parser(argue::Parser* parser, ProgramOpts* opts) {
+  using argue::keywords::default_;
+  using argue::keywords::dest;
+  using argue::keywords::help;
+
+  // clang-format off
+  parser->add_argument(
+      "-t", "--min-time", dest=&opts->min_time, default_=0.05,
+      help="Minimum number of seconds to spend on each measurement");
+
+  parser->add_argument(
+      "-f", "--filter", dest=&opts->filter,
+      help="Only run measurements whose path or map name contains this "
+           "string");
+
+  parser->add_argument(
+      "-n", "--table-size", dest=&opts->table_size,
+      default_=static_cast<int>(colormap::kDefaultTableSize),
+      help="Number of entries in baked tables");
+  // clang-format on
+}
+
+int main(int argc, char** argv) {
+  argue::Parser::Metadata parser_opts{};
+  parser_opts.add_help = true;
+  parser_opts.name = "gtkutil-colormap_bench";
+  parser_opts.author = "Josh Bialkowski";
+  parser_opts.copyright = "Copyright 2018";
+
+  argue::Parser parser{parser_opts};
+  ProgramOpts opts{};
+  setup_parser(&parser, &opts);
+  int parse_result = parser.parse_args(argc, argv);
+  switch (parse_result) {
+    case argue::PARSE_ABORTED:
+      exit(0);
+    case argue::PARSE_EXCEPTION:
+      exit(1);
+    case argue::PARSE_FINISHED:
+      break;
+  }
+
+  // Samples are drawn from slightly beyond the [0, 1] range of the maps so
+  // that clamping is exercised, with a sprinkling of NaN.
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> value_dist(-0.05f, 1.05f);
+  std::uniform_int_distribution<uint16_t> label_dist(0, 1000);
+
+  Bench bench(opts);
+  for (const InputSize& size : kInputSizes) {
+    Inputs inputs;
+    inputs.size = &size;
+    inputs.samples.resize(size.nsamples);
+    inputs.labels.resize(size.nsamples);
+    inputs.pixels.resize(size.nsamples);
+    for (size_t idx = 0; idx < size.nsamples; idx++) {
+      inputs.samples[idx] = (idx % 997 == 0) ? NAN : value_dist(rng);
+      inputs.labels[idx] = label_dist(rng);
+    }
+
+    for (const NamedMap3u& named : kMaps3u) {
+      bench.run_map(named.name, colormap::get_map(named.id).rescale(0, 1),
+                    &inputs);
+    }
+    for (const NamedMap3f& named : kMaps3f) {
+      bench.run_map(named.name, colormap::get_map(named.id).rescale(0, 1),
+                    &inputs);
+    }
+  }
+
+  // NOTE(josh): print the checksum so that none of the work is elided
+  fmt::print(stderr, "checksum: {}\n", bench.get_sink());
+  return 0;
+}
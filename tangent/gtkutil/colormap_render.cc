@@ -0,0 +1,105 @@
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/gtkutil/colormap_render.h"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "tangent/gtkutil/workerpool.h"
+
+namespace colormap {
+
+namespace {
+
+/// Number of field rows processed together. The field is column-major, so
+/// each column of a block is a short contiguous read.
+const size_t kRowBlock = 8;
+
+struct RenderJob {
+  const Eigen::Ref<const Eigen::MatrixXf>* field;
+  const MaskMatrix* mask;
+  Argb32Kernel kernel;
+  size_t rows;
+  size_t cols;
+  uint8_t* data;
+  size_t stride;
+  std::atomic<size_t> next_block;
+};
+
+// Transpose a block of rows into a row-major staging buffer, replacing masked
+// cells with NaN, and then colorize each staged row directly into the
+// surface.
+void render_worker(RenderJob* job) {
+  const Eigen::Ref<const Eigen::MatrixXf>& field = *job->field;
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> staging(kRowBlock * job->cols);
+
+  size_t nblocks = (job->rows + kRowBlock - 1) / kRowBlock;
+  for (size_t block = job->next_block++; block < nblocks;
+       block = job->next_block++) {
+    size_t row_begin = block * kRowBlock;
+    size_t nrows = std::min(kRowBlock, job->rows - row_begin);
+    for (size_t col = 0; col < job->cols; col++) {
+      for (size_t row = 0; row < nrows; row++) {
+        float value = field(row_begin + row, col);
+        if (job->mask && (*job->mask)(row_begin + row, col)) {
+          value = kNaN;
+        }
+        staging[row * job->cols + col] = value;
+      }
+    }
+    map_span_argb32(job->kernel, staging.data(), job->cols, job->cols, nrows,
+                    job->data + row_begin * job->stride, job->stride);
+  }
+}
+
+}  // namespace
+
+cairo_status_t render_field(const Eigen::Ref<const Eigen::MatrixXf>& field,
+                            const Argb32Kernel& kernel,
+                            cairo_surface_t* surface,
+                            const RenderOptions& opts) {
+  if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+    return CAIRO_STATUS_SURFACE_TYPE_MISMATCH;
+  }
+  cairo_format_t format = cairo_image_surface_get_format(surface);
+  if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24) {
+    return CAIRO_STATUS_INVALID_FORMAT;
+  }
+  if (opts.mask && (opts.mask->rows() != field.rows() ||
+                    opts.mask->cols() != field.cols())) {
+    return CAIRO_STATUS_INVALID_SIZE;
+  }
+
+  cairo_surface_flush(surface);
+  RenderJob job;
+  job.field = &field;
+  job.mask = opts.mask;
+  job.kernel = kernel;
+  job.rows = std::min<size_t>(field.rows(),
+                              cairo_image_surface_get_height(surface));
+  job.cols =
+      std::min<size_t>(field.cols(), cairo_image_surface_get_width(surface));
+  job.data = cairo_image_surface_get_data(surface);
+  job.stride = cairo_image_surface_get_stride(surface);
+  job.next_block = 0;
+  if (!job.data || !job.rows || !job.cols) {
+    return cairo_surface_status(surface);
+  }
+
+  size_t nthreads = opts.nthreads;
+  if (!nthreads) {
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  nthreads = std::min(nthreads, (job.rows + kRowBlock - 1) / kRowBlock);
+
+  // NOTE(josh): the calling thread is one of the workers
+  WorkerPool::get_default()->run(nthreads,
+                                 [&job](size_t) { render_worker(&job); });
+
+  cairo_surface_mark_dirty(surface);
+  return CAIRO_STATUS_SUCCESS;
+}
+
+}  // namespace colormap
@@ -0,0 +1,74 @@
+#pragma once
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <cstdint>
+
+#include <cairo/cairo.h>
+#include <Eigen/Dense>
+
+#include "tangent/gtkutil/colormap.h"
+
+namespace colormap {
+
+/// Per-cell mask for `render_field`. Nonzero cells are drawn with the "bad"
+/// color.
+typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic> MaskMatrix;
+
+/// Options for `render_field`
+struct RenderOptions {
+  RenderOptions()
+      : bad_color{0}, nthreads{0}, table_size{kDefaultTableSize}, mask{} {}
+
+  /// Packed (premultiplied) ARGB32 pixel used for NaN and masked cells. See
+  /// `pack_argb32()`. Default is fully transparent.
+  uint32_t bad_color;
+
+  /// Number of worker threads to split rows across. If zero, use the number
+  /// of hardware threads.
+  unsigned int nthreads;
+
+  /// Number of entries in the table baked from the colormap
+  size_t table_size;
+
+  /// If not null, must have the same dimensions as the field. Nonzero cells
+  /// are drawn with `bad_color`.
+  const MaskMatrix* mask;
+};
+
+/// Colorize a scalar field into an image surface. Row `i`, column `j` of the
+/// field is written to pixel `(x=j, y=i)` of the surface. If the surface is
+/// smaller than the field then the field is cropped; if it is larger then the
+/// remaining pixels are untouched. Rows are split across the threads of
+/// `WorkerPool::get_default()`, which persist between calls.
+///
+/// Returns CAIRO_STATUS_SURFACE_TYPE_MISMATCH if `surface` is not an image
+/// surface, CAIRO_STATUS_INVALID_FORMAT if it is not ARGB32 or RGB24, and
+/// CAIRO_STATUS_INVALID_SIZE if `opts.mask` does not have the same
+/// dimensions as `field`.
+cairo_status_t render_field(const Eigen::Ref<const Eigen::MatrixXf>& field,
+                            const Argb32Kernel& kernel,
+                            cairo_surface_t* surface,
+                            const RenderOptions& opts = RenderOptions());
+
+/// Colorize a scalar field into an image surface using a pre-baked table.
+template <typename Color>
+cairo_status_t render_field(const Eigen::Ref<const Eigen::MatrixXf>& field,
+                            const LookupTable<Color>& table,
+                            cairo_surface_t* surface,
+                            const RenderOptions& opts = RenderOptions()) {
+  Argb32Kernel kernel = table.get_kernel();
+  kernel.bad = opts.bad_color;
+  return render_field(field, kernel, surface, opts);
+}
+
+/// Colorize a scalar field into an image surface, such as one of the named
+/// maps from `get_map()` rescaled to the range of the data.
+template <typename Color>
+cairo_status_t render_field(const Eigen::Ref<const Eigen::MatrixXf>& field,
+                            const ColorMap<Color>& map,
+                            cairo_surface_t* surface,
+                            const RenderOptions& opts = RenderOptions()) {
+  return render_field(field, map.bake(opts.table_size), surface, opts);
+}
+
+}  // namespace colormap
@@ -0,0 +1,443 @@
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/gtkutil/colormap.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLORMAP_HAVE_X86 1
+#endif
+
+namespace colormap {
+
+namespace {
+
+typedef void (*SpanFn)(const Argb32Kernel&, const float*, size_t, uint32_t*);
+
+typedef void (*Label16Fn)(const uint32_t*, uint32_t, const uint16_t*, size_t,
+                          uint32_t*);
+typedef void (*Label32Fn)(const uint32_t*, uint32_t, const uint32_t*, size_t,
+                          uint32_t*);
+
+const uint32_t kMaxLerpTableSize = 32768;
+
+inline uint32_t lookup(const Argb32Kernel& kernel, float x) {
+  if (std::isnan(x)) {
+    return kernel.bad;
+  }
+  float float_index = (x - kernel.offset) * kernel.scale;
+  if (!(float_index > 0)) {
+    return kernel.lut[0];
+  }
+  float max_index = static_cast<float>(kernel.size - 1);
+  if (float_index > max_index) {
+    return kernel.lut[kernel.size - 1];
+  }
+  return kernel.lut[static_cast<uint32_t>(float_index)];
+}
+
+void map_span_scalar(const Argb32Kernel& kernel, const float* in, size_t n,
+                     uint32_t* out) {
+  for (size_t idx = 0; idx < n; idx++) {
+    out[idx] = lookup(kernel, in[idx]);
+  }
+}
+
+// Non-linear norms: transform and lookup in a single pass
+void map_span_normed(const Argb32Kernel& kernel, const float* in, size_t n,
+                     uint32_t* out) {
+  for (size_t idx = 0; idx < n; idx++) {
+    out[idx] = lookup(kernel, kernel.norm.transform(in[idx]));
+  }
+}
+
+// Blend each of the four 8-bit channels of two packed pixels with a 16.16
+// fixed-point weight on `a`.
+inline uint32_t blend_argb32(uint32_t a, uint32_t b, uint32_t interp) {
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    int channel = lerp_fixed((a >> shift) & 0xff, (b >> shift) & 0xff, interp);
+    out |= static_cast<uint32_t>(channel) << shift;
+  }
+  return out;
+}
+
+inline uint32_t lookup_lerp(const Argb32Kernel& kernel, float x) {
+  if (std::isnan(x)) {
+    return kernel.bad;
+  }
+  float float_index = (x - kernel.offset) * kernel.scale;
+  if (!(float_index > 0)) {
+    float_index = 0;
+  }
+  float_index = std::min(float_index, static_cast<float>(kernel.size - 1));
+  uint32_t fixed_index = static_cast<uint32_t>(float_index * 65536.0f);
+  uint32_t lower = fixed_index >> 16;
+  uint32_t upper = std::min(lower + 1, kernel.size - 1);
+  return blend_argb32(kernel.lut[upper], kernel.lut[lower],
+                      fixed_index & 0xffff);
+}
+
+void map_span_lerp_scalar(const Argb32Kernel& kernel, const float* in,
+                          size_t n, uint32_t* out) {
+  for (size_t idx = 0; idx < n; idx++) {
+    out[idx] = lookup_lerp(kernel, in[idx]);
+  }
+}
+
+void map_span_lerp_normed(const Argb32Kernel& kernel, const float* in,
+                          size_t n, uint32_t* out) {
+  for (size_t idx = 0; idx < n; idx++) {
+    out[idx] = lookup_lerp(kernel, kernel.norm.transform(in[idx]));
+  }
+}
+
+template <typename Label>
+void map_labels_scalar(const uint32_t* lut, uint32_t size, const Label* in,
+                       size_t n, uint32_t* out) {
+  for (size_t idx = 0; idx < n; idx++) {
+    out[idx] = lut[in[idx] % size];
+  }
+}
+
+#ifdef COLORMAP_HAVE_X86
+
+// NOTE(josh): _mm_max_ps(a, b) returns `b` if either operand is NaN, so
+// clamping with the sample as the first operand keeps the gather index in
+// bounds for NaN samples. Those lanes are then replaced by `bad`.
+__attribute__((target("sse4.1"))) void map_span_sse41(
+    const Argb32Kernel& kernel, const float* in, size_t n, uint32_t* out) {
+  const __m128 offset = _mm_set1_ps(kernel.offset);
+  const __m128 scale = _mm_set1_ps(kernel.scale);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 max_index = _mm_set1_ps(static_cast<float>(kernel.size - 1));
+  const __m128i bad = _mm_set1_epi32(static_cast<int>(kernel.bad));
+  const uint32_t* lut = kernel.lut;
+
+  size_t idx = 0;
+  for (; idx + 4 <= n; idx += 4) {
+    __m128 x = _mm_loadu_ps(in + idx);
+    __m128 float_index = _mm_mul_ps(_mm_sub_ps(x, offset), scale);
+    float_index = _mm_min_ps(_mm_max_ps(float_index, zero), max_index);
+    __m128i index = _mm_cvttps_epi32(float_index);
+    __m128i pixels = _mm_setr_epi32(lut[_mm_extract_epi32(index, 0)],
+                                    lut[_mm_extract_epi32(index, 1)],
+                                    lut[_mm_extract_epi32(index, 2)],
+                                    lut[_mm_extract_epi32(index, 3)]);
+    __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(x, x));
+    pixels = _mm_blendv_epi8(pixels, bad, is_nan);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + idx), pixels);
+  }
+  map_span_scalar(kernel, in + idx, n - idx, out + idx);
+}
+
+__attribute__((target("avx2"))) void map_span_avx2(const Argb32Kernel& kernel,
+                                                   const float* in, size_t n,
+                                                   uint32_t* out) {
+  const __m256 offset = _mm256_set1_ps(kernel.offset);
+  const __m256 scale = _mm256_set1_ps(kernel.scale);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 max_index =
+      _mm256_set1_ps(static_cast<float>(kernel.size - 1));
+  const __m256i bad = _mm256_set1_epi32(static_cast<int>(kernel.bad));
+  const int* lut = reinterpret_cast<const int*>(kernel.lut);
+
+  size_t idx = 0;
+  for (; idx + 8 <= n; idx += 8) {
+    __m256 x = _mm256_loadu_ps(in + idx);
+    __m256 float_index = _mm256_mul_ps(_mm256_sub_ps(x, offset), scale);
+    float_index = _mm256_min_ps(_mm256_max_ps(float_index, zero), max_index);
+    __m256i index = _mm256_cvttps_epi32(float_index);
+    __m256i pixels = _mm256_i32gather_epi32(lut, index, 4);
+    __m256i is_nan = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    pixels = _mm256_blendv_epi8(pixels, bad, is_nan);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + idx), pixels);
+  }
+  map_span_scalar(kernel, in + idx, n - idx, out + idx);
+}
+
+// NOTE(josh): The fixed-point kernels widen each pixel to 16 bits per
+// channel and compute `lower + mulhrs(upper - lower, weight >> 1)`, where
+// mulhrs is the rounding `(a * b + 0x4000) >> 15`. This is the same
+// arithmetic as `lerp_fixed()` so the scalar and SIMD paths agree exactly.
+// The unpack and pack instructions operate within 128-bit lanes, and the
+// weights are broadcast within the same lanes, so no cross-lane shuffle is
+// needed.
+__attribute__((target("sse4.1"))) void map_span_lerp_sse41(
+    const Argb32Kernel& kernel, const float* in, size_t n, uint32_t* out) {
+  const __m128 offset = _mm_set1_ps(kernel.offset);
+  const __m128 scale = _mm_set1_ps(kernel.scale);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 max_index = _mm_set1_ps(static_cast<float>(kernel.size - 1));
+  const __m128 one_fixed = _mm_set1_ps(65536.0f);
+  const __m128i max_entry = _mm_set1_epi32(static_cast<int>(kernel.size - 1));
+  const __m128i frac_mask = _mm_set1_epi32(0xffff);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i bad = _mm_set1_epi32(static_cast<int>(kernel.bad));
+  const __m128i zero_i = _mm_setzero_si128();
+  const uint32_t* lut = kernel.lut;
+
+  size_t idx = 0;
+  for (; idx + 4 <= n; idx += 4) {
+    __m128 x = _mm_loadu_ps(in + idx);
+    __m128 float_index = _mm_mul_ps(_mm_sub_ps(x, offset), scale);
+    float_index = _mm_min_ps(_mm_max_ps(float_index, zero), max_index);
+    __m128i fixed_index = _mm_cvttps_epi32(_mm_mul_ps(float_index, one_fixed));
+    __m128i lower = _mm_srli_epi32(fixed_index, 16);
+    __m128i upper = _mm_min_epi32(_mm_add_epi32(lower, one), max_entry);
+    __m128i weight =
+        _mm_srli_epi32(_mm_and_si128(fixed_index, frac_mask), 1);
+
+    __m128i lo = _mm_setr_epi32(lut[_mm_extract_epi32(lower, 0)],
+                                lut[_mm_extract_epi32(lower, 1)],
+                                lut[_mm_extract_epi32(lower, 2)],
+                                lut[_mm_extract_epi32(lower, 3)]);
+    __m128i hi = _mm_setr_epi32(lut[_mm_extract_epi32(upper, 0)],
+                                lut[_mm_extract_epi32(upper, 1)],
+                                lut[_mm_extract_epi32(upper, 2)],
+                                lut[_mm_extract_epi32(upper, 3)]);
+
+    // [w0 w1 w2 w3 ...] -> [w0 w0 w1 w1 w2 w2 w3 w3] -> [w0 x4, w1 x4], ...
+    __m128i weight16 = _mm_packus_epi32(weight, weight);
+    weight16 = _mm_unpacklo_epi16(weight16, weight16);
+    __m128i weight_01 = _mm_unpacklo_epi32(weight16, weight16);
+    __m128i weight_23 = _mm_unpackhi_epi32(weight16, weight16);
+
+    __m128i lo_01 = _mm_unpacklo_epi8(lo, zero_i);
+    __m128i lo_23 = _mm_unpackhi_epi8(lo, zero_i);
+    __m128i diff_01 = _mm_sub_epi16(_mm_unpacklo_epi8(hi, zero_i), lo_01);
+    __m128i diff_23 = _mm_sub_epi16(_mm_unpackhi_epi8(hi, zero_i), lo_23);
+    __m128i out_01 = _mm_add_epi16(lo_01, _mm_mulhrs_epi16(diff_01, weight_01));
+    __m128i out_23 = _mm_add_epi16(lo_23, _mm_mulhrs_epi16(diff_23, weight_23));
+    __m128i pixels = _mm_packus_epi16(out_01, out_23);
+
+    __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(x, x));
+    pixels = _mm_blendv_epi8(pixels, bad, is_nan);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + idx), pixels);
+  }
+  map_span_lerp_scalar(kernel, in + idx, n - idx, out + idx);
+}
+
+__attribute__((target("avx2"))) void map_span_lerp_avx2(
+    const Argb32Kernel& kernel, const float* in, size_t n, uint32_t* out) {
+  const __m256 offset = _mm256_set1_ps(kernel.offset);
+  const __m256 scale = _mm256_set1_ps(kernel.scale);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 max_index =
+      _mm256_set1_ps(static_cast<float>(kernel.size - 1));
+  const __m256 one_fixed = _mm256_set1_ps(65536.0f);
+  const __m256i max_entry =
+      _mm256_set1_epi32(static_cast<int>(kernel.size - 1));
+  const __m256i frac_mask = _mm256_set1_epi32(0xffff);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i bad = _mm256_set1_epi32(static_cast<int>(kernel.bad));
+  const __m256i zero_i = _mm256_setzero_si256();
+  const int* lut = reinterpret_cast<const int*>(kernel.lut);
+
+  size_t idx = 0;
+  for (; idx + 8 <= n; idx += 8) {
+    __m256 x = _mm256_loadu_ps(in + idx);
+    __m256 float_index = _mm256_mul_ps(_mm256_sub_ps(x, offset), scale);
+    float_index = _mm256_min_ps(_mm256_max_ps(float_index, zero), max_index);
+    __m256i fixed_index =
+        _mm256_cvttps_epi32(_mm256_mul_ps(float_index, one_fixed));
+    __m256i lower = _mm256_srli_epi32(fixed_index, 16);
+    __m256i upper =
+        _mm256_min_epi32(_mm256_add_epi32(lower, one), max_entry);
+    __m256i weight =
+        _mm256_srli_epi32(_mm256_and_si256(fixed_index, frac_mask), 1);
+    __m256i lo = _mm256_i32gather_epi32(lut, lower, 4);
+    __m256i hi = _mm256_i32gather_epi32(lut, upper, 4);
+
+    __m256i weight16 = _mm256_packus_epi32(weight, weight);
+    weight16 = _mm256_unpacklo_epi16(weight16, weight16);
+    __m256i weight_lo = _mm256_unpacklo_epi32(weight16, weight16);
+    __m256i weight_hi = _mm256_unpackhi_epi32(weight16, weight16);
+
+    __m256i lo_lo = _mm256_unpacklo_epi8(lo, zero_i);
+    __m256i lo_hi = _mm256_unpackhi_epi8(lo, zero_i);
+    __m256i diff_lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(hi, zero_i), lo_lo);
+    __m256i diff_hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(hi, zero_i), lo_hi);
+    __m256i out_lo =
+        _mm256_add_epi16(lo_lo, _mm256_mulhrs_epi16(diff_lo, weight_lo));
+    __m256i out_hi =
+        _mm256_add_epi16(lo_hi, _mm256_mulhrs_epi16(diff_hi, weight_hi));
+    __m256i pixels = _mm256_packus_epi16(out_lo, out_hi);
+
+    __m256i is_nan = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    pixels = _mm256_blendv_epi8(pixels, bad, is_nan);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + idx), pixels);
+  }
+  map_span_lerp_scalar(kernel, in + idx, n - idx, out + idx);
+}
+
+// NOTE(josh): The label kernels compute `q = trunc(label * (1 / size))` in
+// floating point, which may be off by one from the true quotient, and then
+// correct the remainder `label - q * size` back into [0, size). For 16-bit
+// labels single precision is sufficient; 32-bit labels are widened to double
+// precision, four at a time.
+__attribute__((target("avx2"))) void map_labels_u16_avx2(
+    const uint32_t* lut, uint32_t size, const uint16_t* in, size_t n,
+    uint32_t* out) {
+  const __m256 inverse = _mm256_set1_ps(1.0f / size);
+  const __m256i divisor = _mm256_set1_epi32(static_cast<int>(size));
+  const __m256i max_entry = _mm256_set1_epi32(static_cast<int>(size - 1));
+  const __m256i zero = _mm256_setzero_si256();
+  const int* table = reinterpret_cast<const int*>(lut);
+
+  size_t idx = 0;
+  for (; idx + 8 <= n; idx += 8) {
+    __m256i label = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + idx)));
+    __m256i quotient = _mm256_cvttps_epi32(
+        _mm256_mul_ps(_mm256_cvtepi32_ps(label), inverse));
+    __m256i rem =
+        _mm256_sub_epi32(label, _mm256_mullo_epi32(quotient, divisor));
+    rem = _mm256_sub_epi32(
+        rem, _mm256_and_si256(_mm256_cmpgt_epi32(rem, max_entry), divisor));
+    rem = _mm256_add_epi32(
+        rem, _mm256_and_si256(_mm256_cmpgt_epi32(zero, rem), divisor));
+    __m256i pixels = _mm256_i32gather_epi32(table, rem, 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + idx), pixels);
+  }
+  map_labels_scalar(lut, size, in + idx, n - idx, out + idx);
+}
+
+__attribute__((target("avx2"))) inline __m128i remainder_u32(
+    __m128i label, __m256d inverse, __m256d divisor) {
+  // NOTE(josh): there is no unsigned conversion, so flip the sign bit and
+  // add back 2^31 after converting.
+  const __m128i sign = _mm_set1_epi32(static_cast<int>(0x80000000u));
+  __m256d value = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(label, sign)),
+                                _mm256_set1_pd(2147483648.0));
+  __m256d quotient = _mm256_round_pd(_mm256_mul_pd(value, inverse),
+                                     _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  __m256d rem = _mm256_sub_pd(value, _mm256_mul_pd(quotient, divisor));
+  rem = _mm256_sub_pd(
+      rem, _mm256_and_pd(_mm256_cmp_pd(rem, divisor, _CMP_GE_OQ), divisor));
+  rem = _mm256_add_pd(
+      rem, _mm256_and_pd(_mm256_cmp_pd(rem, _mm256_setzero_pd(), _CMP_LT_OQ),
+                         divisor));
+  return _mm256_cvttpd_epi32(rem);
+}
+
+__attribute__((target("avx2"))) void map_labels_u32_avx2(
+    const uint32_t* lut, uint32_t size, const uint32_t* in, size_t n,
+    uint32_t* out) {
+  const __m256d inverse = _mm256_set1_pd(1.0 / size);
+  const __m256d divisor = _mm256_set1_pd(size);
+  const int* table = reinterpret_cast<const int*>(lut);
+
+  size_t idx = 0;
+  for (; idx + 8 <= n; idx += 8) {
+    __m256i label =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + idx));
+    __m128i rem_lo =
+        remainder_u32(_mm256_castsi256_si128(label), inverse, divisor);
+    __m128i rem_hi =
+        remainder_u32(_mm256_extracti128_si256(label, 1), inverse, divisor);
+    __m256i rem =
+        _mm256_inserti128_si256(_mm256_castsi128_si256(rem_lo), rem_hi, 1);
+    __m256i pixels = _mm256_i32gather_epi32(table, rem, 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + idx), pixels);
+  }
+  map_labels_scalar(lut, size, in + idx, n - idx, out + idx);
+}
+
+#endif  // COLORMAP_HAVE_X86
+
+struct SpanImpl {
+  SpanFn fn;
+  SpanFn lerp_fn;
+  Label16Fn label16_fn;
+  Label32Fn label32_fn;
+  const char* isa;
+};
+
+SpanImpl select_span_impl() {
+#ifdef COLORMAP_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SpanImpl{map_span_avx2, map_span_lerp_avx2, map_labels_u16_avx2,
+                    map_labels_u32_avx2, "avx2"};
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return SpanImpl{map_span_sse41, map_span_lerp_sse41,
+                    map_labels_scalar<uint16_t>, map_labels_scalar<uint32_t>,
+                    "sse4.1"};
+  }
+#endif
+  return SpanImpl{map_span_scalar, map_span_lerp_scalar,
+                  map_labels_scalar<uint16_t>, map_labels_scalar<uint32_t>,
+                  "scalar"};
+}
+
+const SpanImpl& get_span_impl() {
+  static const SpanImpl impl = select_span_impl();
+  return impl;
+}
+
+SpanFn get_span_fn(const Argb32Kernel& kernel) {
+  if (kernel.norm.kind != Norm::LINEAR) {
+    return map_span_normed;
+  }
+  return get_span_impl().fn;
+}
+
+}  // namespace
+
+void map_span_argb32(const Argb32Kernel& kernel, const float* in, size_t n,
+                     uint32_t* out) {
+  if (!kernel.lut || !kernel.size) {
+    return;
+  }
+  get_span_fn(kernel)(kernel, in, n, out);
+}
+
+void map_span_argb32(const Argb32Kernel& kernel, const float* in,
+                     size_t in_stride, size_t width, size_t height,
+                     uint8_t* out, size_t out_stride) {
+  if (!kernel.lut || !kernel.size) {
+    return;
+  }
+  SpanFn fn = get_span_fn(kernel);
+  for (size_t row = 0; row < height; row++) {
+    fn(kernel, in + row * in_stride, width,
+       reinterpret_cast<uint32_t*>(out + row * out_stride));
+  }
+}
+
+void map_span_argb32_lerp(const Argb32Kernel& kernel, const float* in,
+                          size_t n, uint32_t* out) {
+  if (!kernel.lut || !kernel.size) {
+    return;
+  }
+  // NOTE(josh): beyond this size the 16.16 position overflows
+  if (kernel.size > kMaxLerpTableSize) {
+    get_span_fn(kernel)(kernel, in, n, out);
+  } else if (kernel.norm.kind != Norm::LINEAR) {
+    map_span_lerp_normed(kernel, in, n, out);
+  } else {
+    get_span_impl().lerp_fn(kernel, in, n, out);
+  }
+}
+
+void map_labels_argb32(const uint32_t* lut, uint32_t size, const uint16_t* in,
+                       size_t n, uint32_t* out) {
+  if (!lut || !size) {
+    return;
+  }
+  get_span_impl().label16_fn(lut, size, in, n, out);
+}
+
+void map_labels_argb32(const uint32_t* lut, uint32_t size, const uint32_t* in,
+                       size_t n, uint32_t* out) {
+  if (!lut || !size) {
+    return;
+  }
+  get_span_impl().label32_fn(lut, size, in, n, out);
+}
+
+const char* get_span_isa() {
+  return get_span_impl().isa;
+}
+
+}  // namespace colormap
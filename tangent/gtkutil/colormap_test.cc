@@ -1,7 +1,17 @@
 // Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include "tangent/gtkutil/autorange.h"
 #include "tangent/gtkutil/colormap.h"
+#include "tangent/gtkutil/colormap_render.h"
+#include "tangent/gtkutil/colormap_tables.h"
+#include "tangent/gtkutil/workerpool.h"
 
 TEST(ColorMap, TestKnownColorMap) {
   colormap::Map3u map = colormap::get_map(colormap::ACCENT);
@@ -17,3 +27,541 @@ TEST(ColorMap, TestKnownColorMap) {
   EXPECT_EQ(color1.g, 0xae);
   EXPECT_EQ(color1.b, 0xd4);
 }
+
+TEST(ColorMap, BakedTableMatchesReference) {
+  colormap::Map3f map = colormap::get_map(colormap::VIRIDIS);
+  colormap::Table3f table = map.bake(1024);
+  ASSERT_EQ(table.size(), 1024);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(table.data()) %
+                colormap::kCacheLineSize,
+            0);
+
+  double span = map.get_range().max - map.get_range().min;
+  for (size_t idx = 0; idx < table.size(); idx++) {
+    double x = map.get_range().min + (idx + 0.5) * span / table.size();
+    EXPECT_EQ(table.index(x), idx);
+    colormap::Color3f expect = map(x);
+    colormap::Color3f actual = table(x);
+    EXPECT_FLOAT_EQ(actual.r, expect.r);
+    EXPECT_FLOAT_EQ(actual.g, expect.g);
+    EXPECT_FLOAT_EQ(actual.b, expect.b);
+  }
+}
+
+TEST(ColorMap, BakedTableClampsOutOfRange) {
+  colormap::Table3u table = colormap::get_map(colormap::ACCENT).bake(256);
+  EXPECT_EQ(table.index(-1e9), 0);
+  EXPECT_EQ(table.index(1e9), 255);
+  EXPECT_EQ(table.index(std::nan("")), 0);
+}
+
+TEST(ColorMap, PackArgb32) {
+  EXPECT_EQ(colormap::pack_argb32(colormap::Color3u{0x7f, 0xc9, 0x10}),
+            0xff7fc910u);
+  EXPECT_EQ(colormap::pack_argb32(colormap::Color3f{1.0, 0.0, 0.5}),
+            0xffff0080u);
+  // premultiplied
+  EXPECT_EQ(colormap::pack_argb32(colormap::Color3f{1.0, 1.0, 1.0}, 0.0),
+            0x00000000u);
+  EXPECT_EQ(colormap::pack_argb32(colormap::Color3u{0xff, 0x00, 0xff}, 0.5),
+            0x80800080u);
+}
+
+TEST(ColorMap, MapSpanMatchesTable) {
+  colormap::Table3f table = colormap::get_map(colormap::MAGMA).bake(256);
+  double span = table.get_range().max - table.get_range().min;
+
+  // Odd length so that every kernel also exercises its scalar tail
+  std::vector<float> samples;
+  for (size_t idx = 0; idx < 2 * table.size() + 3; idx++) {
+    samples.push_back(table.get_range().min +
+                      ((idx % table.size()) + 0.5) * span / table.size());
+  }
+  samples.push_back(-1e9);
+  samples.push_back(1e9);
+  samples.push_back(std::nanf(""));
+
+  std::vector<uint32_t> pixels(samples.size(), 0);
+  table.map_span(samples.data(), samples.size(), pixels.data());
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    EXPECT_EQ(pixels[idx], colormap::pack_argb32(table(samples[idx])))
+        << "at index " << idx << " using " << colormap::get_span_isa();
+  }
+}
+
+TEST(ColorMap, MapSpanStrided) {
+  colormap::Table3u table = colormap::get_map(colormap::BLUES).bake(64);
+  const size_t width = 5;
+  const size_t height = 3;
+  const size_t in_stride = 7;
+  const size_t out_stride = 32;
+
+  std::vector<float> samples(in_stride * height, 0);
+  for (size_t row = 0; row < height; row++) {
+    for (size_t col = 0; col < width; col++) {
+      samples[row * in_stride + col] = row * width + col;
+    }
+  }
+  std::vector<uint8_t> image(out_stride * height, 0);
+  table.map_span(samples.data(), in_stride, width, height, image.data(),
+                 out_stride);
+  for (size_t row = 0; row < height; row++) {
+    const uint32_t* pixels =
+        reinterpret_cast<const uint32_t*>(&image[row * out_stride]);
+    for (size_t col = 0; col < width; col++) {
+      EXPECT_EQ(pixels[col], table.argb32()[table.index(row * width + col)]);
+    }
+    // padding at the end of each row is untouched
+    EXPECT_EQ(pixels[width], 0);
+  }
+}
+
+TEST(ColorMap, RenderField) {
+  const int rows = 37;
+  const int cols = 19;
+  Eigen::MatrixXf field(rows, cols);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      field(row, col) = (row * cols + col) * 256.0f / (rows * cols);
+    }
+  }
+  field(3, 4) = std::nanf("");
+  colormap::MaskMatrix mask = colormap::MaskMatrix::Zero(rows, cols);
+  mask(5, 6) = 1;
+
+  colormap::Table3f table = colormap::get_map(colormap::VIRIDIS).bake(256);
+  colormap::RenderOptions opts;
+  opts.bad_color = 0x12345678;
+  opts.nthreads = 3;
+  opts.mask = &mask;
+
+  cairo_surface_t* surface =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, cols + 2, rows - 2);
+  ASSERT_EQ(colormap::render_field(field, table, surface, opts),
+            CAIRO_STATUS_SUCCESS);
+
+  uint8_t* data = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  for (int row = 0; row < rows - 2; row++) {
+    const uint32_t* pixels = reinterpret_cast<uint32_t*>(data + row * stride);
+    for (int col = 0; col < cols; col++) {
+      if ((row == 3 && col == 4) || (row == 5 && col == 6)) {
+        EXPECT_EQ(pixels[col], opts.bad_color);
+      } else {
+        EXPECT_EQ(pixels[col], table.argb32()[table.index(field(row, col))]);
+      }
+    }
+    EXPECT_EQ(pixels[cols], 0);
+  }
+  cairo_surface_destroy(surface);
+}
+
+TEST(ColorMap, RenderFieldRejectsMismatchedMask) {
+  Eigen::MatrixXf field = Eigen::MatrixXf::Zero(4, 5);
+  colormap::MaskMatrix mask = colormap::MaskMatrix::Zero(5, 4);
+  colormap::RenderOptions opts;
+  opts.mask = &mask;
+  cairo_surface_t* surface =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 5, 4);
+  EXPECT_EQ(colormap::render_field(
+                field, colormap::get_map(colormap::VIRIDIS).bake(16), surface,
+                opts),
+            CAIRO_STATUS_INVALID_SIZE);
+  cairo_surface_destroy(surface);
+}
+
+TEST(ColorMap, WorkerPoolRunsEachIndexOnce) {
+  colormap::WorkerPool pool;
+  for (size_t nworkers : {0, 1, 2, 7, 3}) {
+    std::vector<std::atomic<int>> calls(nworkers);
+    for (std::atomic<int>& count : calls) {
+      count = 0;
+    }
+    pool.run(nworkers, [&calls](size_t idx) { calls[idx]++; });
+    for (size_t idx = 0; idx < nworkers; idx++) {
+      EXPECT_EQ(calls[idx].load(), 1)
+          << "nworkers=" << nworkers << " idx=" << idx;
+    }
+  }
+  // Threads are re-used rather than started on every call
+  EXPECT_EQ(pool.get_nthreads(), 6u);
+
+  // Concurrent callers share the threads without waiting on each other
+  std::atomic<int> total{0};
+  std::vector<std::thread> callers;
+  for (int idx = 0; idx < 4; idx++) {
+    callers.emplace_back([&pool, &total]() {
+      for (int iter = 0; iter < 100; iter++) {
+        pool.run(5, [&total](size_t) { total++; });
+      }
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(total.load(), 4 * 100 * 5);
+  EXPECT_EQ(pool.get_nthreads(), 6u);
+}
+
+TEST(ColorMap, CompileTimeTable) {
+  static constexpr std::array<colormap::Color3f, 256> kViridis =
+      colormap::lut<colormap::VIRIDIS, 256>();
+  static constexpr std::array<colormap::Color3u, 1000> kRdBu =
+      colormap::lut<colormap::RDBU, 1000>();
+
+  colormap::Table3f viridis = colormap::get_map(colormap::VIRIDIS).bake(256);
+  for (size_t idx = 0; idx < kViridis.size(); idx++) {
+    EXPECT_NEAR(kViridis[idx].r, viridis.data()[idx].r, 1e-6);
+    EXPECT_NEAR(kViridis[idx].g, viridis.data()[idx].g, 1e-6);
+    EXPECT_NEAR(kViridis[idx].b, viridis.data()[idx].b, 1e-6);
+  }
+
+  colormap::Table3u rdbu = colormap::get_map(colormap::RDBU).bake(1000);
+  for (size_t idx = 0; idx < kRdBu.size(); idx++) {
+    EXPECT_NEAR(kRdBu[idx].r, rdbu.data()[idx].r, 1);
+    EXPECT_NEAR(kRdBu[idx].g, rdbu.data()[idx].g, 1);
+    EXPECT_NEAR(kRdBu[idx].b, rdbu.data()[idx].b, 1);
+  }
+}
+
+TEST(ColorMap, NamedMapsMatchTables) {
+  colormap::Map3u ylrd = colormap::get_map(colormap::YLRD);
+  typedef colormap::NamedMap3u<colormap::YLRD> NamedYlRd;
+  ASSERT_EQ(ylrd.get_nsupports(), NamedYlRd::nsupports());
+  for (size_t idx = 0; idx < ylrd.get_nsupports(); idx++) {
+    EXPECT_EQ(ylrd.get_supports()[idx].r, NamedYlRd::supports()[idx].r);
+    EXPECT_EQ(ylrd.get_supports()[idx].g, NamedYlRd::supports()[idx].g);
+    EXPECT_EQ(ylrd.get_supports()[idx].b, NamedYlRd::supports()[idx].b);
+  }
+
+  colormap::Map3f inferno = colormap::get_map(colormap::INFERNO);
+  typedef colormap::NamedMap3f<colormap::INFERNO> NamedInferno;
+  ASSERT_EQ(inferno.get_nsupports(), NamedInferno::nsupports());
+  for (size_t idx = 0; idx < inferno.get_nsupports(); idx++) {
+    EXPECT_EQ(inferno.get_supports()[idx].r, NamedInferno::supports()[idx].r);
+    EXPECT_EQ(inferno.get_supports()[idx].g, NamedInferno::supports()[idx].g);
+    EXPECT_EQ(inferno.get_supports()[idx].b, NamedInferno::supports()[idx].b);
+  }
+}
+
+TEST(ColorMap, OklabRoundTrip) {
+  colormap::Color3<double> white =
+      colormap::srgb_to_oklab(colormap::Color3<double>{1.0, 1.0, 1.0});
+  EXPECT_NEAR(white.r, 1.0, 1e-4);
+  EXPECT_NEAR(white.g, 0.0, 1e-4);
+  EXPECT_NEAR(white.b, 0.0, 1e-4);
+
+  colormap::Color3<double> color{0.2, 0.6, 0.9};
+  colormap::Color3<double> round_trip =
+      colormap::oklab_to_srgb(colormap::srgb_to_oklab(color));
+  EXPECT_NEAR(round_trip.r, color.r, 1e-6);
+  EXPECT_NEAR(round_trip.g, color.g, 1e-6);
+  EXPECT_NEAR(round_trip.b, color.b, 1e-6);
+}
+
+TEST(ColorMap, OklabTable) {
+  colormap::Map3u map = colormap::get_map(colormap::RDBU);
+  colormap::Table3u srgb = map.bake(map.get_nsupports() * 4);
+  colormap::Table3u oklab =
+      map.bake(map.get_nsupports() * 4, colormap::INTERP_OKLAB);
+  ASSERT_EQ(oklab.size(), srgb.size());
+
+  // Near a support both tables agree, in between the supports they are
+  // blended differently.
+  size_t ndiffer = 0;
+  for (size_t idx = 0; idx < oklab.size(); idx++) {
+    colormap::Color3u lhs = oklab.data()[idx];
+    colormap::Color3u rhs = srgb.data()[idx];
+    int max_diff = std::max({std::abs(int(lhs.r) - int(rhs.r)),
+                             std::abs(int(lhs.g) - int(rhs.g)),
+                             std::abs(int(lhs.b) - int(rhs.b))});
+    if (idx % 4 == 0) {
+      EXPECT_LE(max_diff, 16) << "at index " << idx;
+    }
+    if (max_diff > 1) {
+      ndiffer++;
+    }
+  }
+  EXPECT_GT(ndiffer, 0u);
+}
+
+TEST(ColorMap, Rescale) {
+  colormap::Map3u map = colormap::get_map(colormap::ACCENT).rescale(10, 18);
+  EXPECT_EQ(map.get_range().min, 10);
+  EXPECT_EQ(map.get_range().max, 18);
+  colormap::Color3u color1 = map(11);
+  EXPECT_EQ(color1.r, 0xbe);
+  EXPECT_EQ(color1.g, 0xae);
+  EXPECT_EQ(color1.b, 0xd4);
+
+  // Out of range values are clamped to the ends
+  colormap::Color3u first = map(-100);
+  colormap::Color3u last = map(100);
+  EXPECT_EQ(first.r, 0x7f);
+  EXPECT_EQ(last.r, 0x66);
+  EXPECT_EQ(map(18).r, 0x66);
+}
+
+TEST(ColorMap, NormIsFusedIntoTable) {
+  colormap::Map3f map = colormap::get_map(colormap::VIRIDIS)
+                            .rescale(1, 1e6)
+                            .with_norm(colormap::Norm::log());
+  colormap::Table3f table = map.bake(256);
+
+  // Each decade gets an equal share of the table
+  EXPECT_EQ(table.index(1), 0);
+  EXPECT_EQ(table.index(10), 42);
+  EXPECT_EQ(table.index(1e3 + 1), 128);
+  EXPECT_EQ(table.index(1e6), 255);
+  EXPECT_EQ(table.index(0), 0);
+  EXPECT_EQ(table.index(-5), 0);
+
+  std::vector<float> samples = {0.5f, 1.5f, 10.5f, 1001.0f, 3e4f, 1e7f,
+                                std::nanf("")};
+  std::vector<uint32_t> pixels(samples.size());
+  table.map_span(samples.data(), samples.size(), pixels.data());
+  for (size_t idx = 0; idx + 1 < samples.size(); idx++) {
+    EXPECT_EQ(pixels[idx], table.argb32()[table.index(samples[idx])]);
+    colormap::Color3f expect = map(samples[idx]);
+    colormap::Color3f actual = table(samples[idx]);
+    EXPECT_NEAR(actual.r, expect.r, 0.01);
+    EXPECT_NEAR(actual.g, expect.g, 0.01);
+    EXPECT_NEAR(actual.b, expect.b, 0.01);
+  }
+}
+
+TEST(ColorMap, SymlogAndPowerNorms) {
+  colormap::Range range{-100, 100};
+  colormap::Norm symlog = colormap::Norm::symlog(1.0);
+  EXPECT_NEAR(symlog.normalize(0, range), 0.5, 1e-12);
+  EXPECT_NEAR(symlog.normalize(-100, range), 0.0, 1e-12);
+  EXPECT_NEAR(symlog.normalize(9, range), 0.75, 0.01);
+
+  colormap::Norm power = colormap::Norm::power(2.0);
+  EXPECT_NEAR(power.normalize(5, colormap::Range{0, 10}), 0.25, 1e-12);
+}
+
+TEST(ColorMap, PercentileRange) {
+  std::vector<float> samples;
+  for (int idx = 1000; idx >= 0; idx--) {
+    samples.push_back(idx);
+  }
+  samples.push_back(std::nanf(""));
+  colormap::Range range =
+      colormap::get_percentile_range(samples.data(), samples.size(), 1, 99);
+  EXPECT_EQ(range.min, 10);
+  EXPECT_EQ(range.max, 990);
+}
+
+TEST(ColorMap, MinMaxSkipsNonFinite) {
+  std::vector<float> samples = {std::nanf(""), 3, -2, 7, INFINITY,
+                                -INFINITY,     5, 1,  -1};
+  colormap::Range range = colormap::get_minmax(samples.data(), samples.size());
+  EXPECT_EQ(range.min, -2);
+  EXPECT_EQ(range.max, 7);
+
+  std::vector<double> doubles(samples.begin(), samples.end());
+  range = colormap::get_minmax(doubles.data(), doubles.size());
+  EXPECT_EQ(range.min, -2);
+  EXPECT_EQ(range.max, 7);
+
+  range = colormap::get_minmax(samples.data(), 1);
+  EXPECT_GT(range.min, range.max);
+}
+
+TEST(ColorMap, RangeEstimator) {
+  // Samples span [0, 1000) but arrive in chunks that grow the range in both
+  // directions.
+  std::vector<float> samples;
+  for (int idx = 0; idx < 100000; idx++) {
+    samples.push_back((idx * 7919) % 100000 / 100.0f);
+  }
+  std::vector<float> sorted = samples;
+  std::sort(sorted.begin(), sorted.end());
+
+  colormap::RangeEstimator incremental;
+  colormap::RangeEstimator single;
+  const size_t kChunk = 1000;
+  for (size_t begin = 0; begin < samples.size(); begin += kChunk) {
+    incremental.update(samples.data() + begin, kChunk);
+  }
+  single.update(samples.data(), samples.size());
+  EXPECT_EQ(incremental.get_count(), samples.size());
+  EXPECT_EQ(incremental.get_minmax().min, sorted.front());
+  EXPECT_EQ(incremental.get_minmax().max, sorted.back());
+
+  for (double pct : {0.0, 1.0, 25.0, 50.0, 99.0, 100.0}) {
+    size_t rank = std::min(sorted.size() - 1,
+                           static_cast<size_t>(pct / 100 * sorted.size()));
+    double tolerance = 2 * 1000.0 / 4096;
+    EXPECT_NEAR(incremental.get_percentile(pct), sorted[rank], tolerance);
+    EXPECT_NEAR(single.get_percentile(pct), sorted[rank], tolerance);
+  }
+
+  colormap::Range range = incremental.get_range(1, 99);
+  colormap::Map3f map = colormap::get_map(colormap::VIRIDIS).rescale(range);
+  EXPECT_EQ(map.get_range().min, range.min);
+  EXPECT_EQ(map.get_range().max, range.max);
+}
+
+TEST(ColorMap, RangeEstimatorParallel) {
+  std::vector<double> samples(3 * 1024 * 1024);
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    samples[idx] = static_cast<double>(idx % 10007) - 5000;
+  }
+  samples[12345] = std::nan("");
+
+  colormap::RangeEstimator serial;
+  colormap::RangeEstimator parallel;
+  serial.update(samples.data(), samples.size());
+  parallel.update(samples.data(), samples.size(), 4);
+  EXPECT_EQ(parallel.get_count(), samples.size() - 1);
+  EXPECT_EQ(parallel.get_minmax().min, -5000);
+  EXPECT_EQ(parallel.get_minmax().max, 5006);
+  EXPECT_NEAR(parallel.get_percentile(50), serial.get_percentile(50), 5.0);
+
+  // The partials share the bins of the estimator, so merging them is exact
+  colormap::RangeEstimator seeded;
+  seeded.update(samples.data(), samples.size(), 3);
+  EXPECT_EQ(seeded.get_bin_range().min, parallel.get_bin_range().min);
+  EXPECT_EQ(seeded.get_bin_range().max, parallel.get_bin_range().max);
+  EXPECT_EQ(seeded.get_bins(), parallel.get_bins());
+  EXPECT_EQ(parallel.get_bin_range().min, serial.get_bin_range().min);
+  EXPECT_EQ(parallel.get_bin_range().max, serial.get_bin_range().max);
+  EXPECT_EQ(parallel.get_bins(), serial.get_bins());
+
+  // Samples added in parallel to a non-empty estimator grow its bins first
+  colormap::RangeEstimator grown;
+  std::vector<double> narrow = {-1.0, 1.0};
+  grown.update(narrow.data(), narrow.size());
+  grown.update(samples.data(), samples.size(), 4);
+  EXPECT_EQ(grown.get_count(), samples.size() + 1);
+  EXPECT_EQ(grown.get_minmax().min, -5000);
+  EXPECT_LE(grown.get_bin_range().min, -5000);
+  EXPECT_GE(grown.get_bin_range().max, 5006);
+
+  samples.erase(samples.begin() + 12345);
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  EXPECT_NEAR(parallel.get_percentile(50), samples[samples.size() / 2], 5.0);
+}
+
+TEST(ColorMap, PackedColors) {
+  EXPECT_EQ(sizeof(colormap::Color3b), 3);
+  EXPECT_EQ(sizeof(colormap::Color4b), 4);
+
+  colormap::Map3u map = colormap::get_map(colormap::PARULA).rescale(0, 1);
+  colormap::Table3u wide = map.bake(256);
+  colormap::Table3b packed = map.bake<colormap::Color3b>(256);
+  for (size_t idx = 0; idx < 256; idx++) {
+    EXPECT_EQ(packed.data()[idx].r, wide.data()[idx].r);
+    EXPECT_EQ(packed.data()[idx].g, wide.data()[idx].g);
+    EXPECT_EQ(packed.data()[idx].b, wide.data()[idx].b);
+    EXPECT_EQ(packed.argb32()[idx], wide.argb32()[idx]);
+  }
+
+  colormap::Color4b half_red{255, 0, 0, 128};
+  EXPECT_EQ(colormap::pack_argb32(half_red), 0x80800000u);
+}
+
+TEST(ColorMap, FixedPointLerp) {
+  EXPECT_EQ(colormap::lerp_fixed(200, 100, 0), 100);
+  EXPECT_EQ(colormap::lerp_fixed(200, 100, 65536), 200);
+  EXPECT_EQ(colormap::lerp_fixed(200, 100, 32768), 150);
+  EXPECT_EQ(colormap::lerp_fixed(100, 200, 16384), 175);
+
+  colormap::Map3u map = colormap::get_map(colormap::SPECTRAL).rescale(0, 1);
+  for (int idx = -10; idx <= 1010; idx++) {
+    double x = idx / 1000.0;
+    colormap::Color3u expect = map.get(x);
+    colormap::Color3u actual = map.get_fixed(x);
+    EXPECT_NEAR(actual.r, expect.r, 1);
+    EXPECT_NEAR(actual.g, expect.g, 1);
+    EXPECT_NEAR(actual.b, expect.b, 1);
+  }
+}
+
+TEST(ColorMap, MapSpanLerp) {
+  colormap::Table3b table = colormap::get_map(colormap::VIRIDIS)
+                                .rescale(-1, 1)
+                                .bake<colormap::Color3b>(16);
+  colormap::Argb32Kernel kernel = table.get_lerp_kernel();
+  kernel.bad = 0x12345678;
+
+  std::vector<float> samples;
+  for (int idx = 0; idx < 1037; idx++) {
+    samples.push_back(-1.2f + idx * 2.4f / 1036);
+  }
+  samples[17] = std::nanf("");
+  std::vector<uint32_t> pixels(samples.size());
+  colormap::map_span_argb32_lerp(kernel, samples.data(), samples.size(),
+                                 pixels.data());
+
+  const uint32_t* lut = table.argb32();
+  for (size_t idx = 0; idx < samples.size(); idx++) {
+    if (idx == 17) {
+      EXPECT_EQ(pixels[idx], kernel.bad);
+      continue;
+    }
+    float float_index = (samples[idx] - kernel.offset) * kernel.scale;
+    float_index = std::min(std::max(float_index, 0.0f), 15.0f);
+    uint32_t fixed_index = static_cast<uint32_t>(float_index * 65536.0f);
+    uint32_t lower = fixed_index >> 16;
+    uint32_t upper = std::min(lower + 1, 15u);
+    for (int shift = 0; shift < 32; shift += 8) {
+      int expect =
+          colormap::lerp_fixed((lut[upper] >> shift) & 0xff,
+                               (lut[lower] >> shift) & 0xff,
+                               fixed_index & 0xffff);
+      EXPECT_EQ((pixels[idx] >> shift) & 0xff, expect) << idx;
+    }
+  }
+
+  // Entries are at the centers of their bins
+  float center = -1 + 2.0f * 5.5f / 16;
+  uint32_t pixel = 0;
+  table.map_span_lerp(&center, 1, &pixel);
+  EXPECT_EQ(pixel, lut[5]);
+}
+
+TEST(ColorMap, CategoricalLabels) {
+  colormap::Map3u map = colormap::get_map(colormap::SET3);
+  colormap::Table3b table = map.categorical<colormap::Color3b>();
+  ASSERT_EQ(table.size(), map.get_nsupports());
+  for (size_t label = 0; label < 3 * table.size(); label++) {
+    colormap::Color3u expect = map.get_supports()[label % table.size()];
+    EXPECT_EQ(map.get_category(label).r, expect.r);
+    EXPECT_EQ(map.get_category(label).g, expect.g);
+    EXPECT_EQ(table.argb32()[label % table.size()],
+              colormap::pack_argb32(expect));
+  }
+
+  std::vector<uint16_t> labels16;
+  std::vector<uint32_t> labels32;
+  for (uint32_t idx = 0; idx < 1000; idx++) {
+    labels16.push_back(static_cast<uint16_t>(idx * 9973));
+    labels32.push_back(idx * 2654435761u);
+  }
+  labels16[3] = 0xffff;
+  labels32[3] = 0xffffffff;
+  labels32[4] = 0x80000000;
+
+  for (uint32_t size : {1u, 3u, 8u, 12u, 255u}) {
+    const uint32_t* lut = table.argb32();
+    std::vector<uint32_t> ramp(size);
+    for (uint32_t idx = 0; idx < size; idx++) {
+      ramp[idx] = lut[idx % table.size()] ^ (idx << 24);
+    }
+    std::vector<uint32_t> pixels(labels16.size());
+    colormap::map_labels_argb32(ramp.data(), size, labels16.data(),
+                                labels16.size(), pixels.data());
+    for (size_t idx = 0; idx < labels16.size(); idx++) {
+      EXPECT_EQ(pixels[idx], ramp[labels16[idx] % size]) << size;
+    }
+    colormap::map_labels_argb32(ramp.data(), size, labels32.data(),
+                                labels32.size(), pixels.data());
+    for (size_t idx = 0; idx < labels32.size(); idx++) {
+      EXPECT_EQ(pixels[idx], ramp[labels32[idx] % size]) << size;
+    }
+  }
+}
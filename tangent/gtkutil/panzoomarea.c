@@ -3,8 +3,12 @@
 
 #include <cairo/cairo-gobject.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "tangent/gtkutil/gdkcairo.h"
+#include "tangent/gtkutil/pngwriter.h"
+#include "tangent/gtkutil/tilecache.h"
 
 // =============================================================================
 //  Stolen from GTK internals
@@ -37,6 +41,65 @@ static gboolean boolean_handled_accumulator(GSignalInvocationHint* ihint,
 // =============================================================================
 //  Private members
 // =============================================================================
+
+// Reference counted render callback. Each in-flight frame holds a reference
+// so that the user data outlives any worker thread which is still using it.
+typedef struct _RenderClosure {
+  gint refcount;
+  GtkPanZoomRenderFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+} RenderClosure;
+
+static RenderClosure* render_closure_ref(RenderClosure* closure) {
+  g_atomic_int_inc(&closure->refcount);
+  return closure;
+}
+
+static void render_closure_unref(RenderClosure* closure) {
+  if (closure && g_atomic_int_dec_and_test(&closure->refcount)) {
+    if (closure->destroy) {
+      closure->destroy(closure->user_data);
+    }
+    g_free(closure);
+  }
+}
+
+// A layer composited on top of the area content
+typedef struct _PanZoomLayer {
+  guint id;
+  GtkPanZoomLayerFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+  gboolean cached;               ///< if true, the layer is retained in
+                                 ///< `surface[0]`
+  gboolean visible;              ///< if false, the layer is not drawn
+  cairo_surface_t* surface[2];   ///< ping-pong surfaces of a cached layer,
+                                 ///< [0] holds the last rendering
+  GtkPanZoomViewport viewport;   ///< viewport of `surface[0]`
+  gint scale_factor;             ///< widget scale factor of `surface[0]`
+  gboolean dirty;                ///< true if `surface[0]` must be redrawn
+} PanZoomLayer;
+
+// Release the surfaces of a cached layer
+static void release_layer_surfaces(PanZoomLayer* layer) {
+  for (size_t idx = 0; idx < 2; idx++) {
+    if (layer->surface[idx]) {
+      cairo_surface_destroy(layer->surface[idx]);
+      layer->surface[idx] = NULL;
+    }
+  }
+}
+
+static void panzoom_layer_free(gpointer data) {
+  PanZoomLayer* layer = data;
+  if (layer->destroy) {
+    layer->destroy(layer->user_data);
+  }
+  release_layer_surfaces(layer);
+  g_free(layer);
+}
+
 typedef struct _GtkPanZoomAreaPrivate {
   GtkAdjustment* offset_x;  ///< offset of the viewport
   GtkAdjustment* offset_y;  ///< offset of the viewport
@@ -51,8 +114,78 @@ typedef struct _GtkPanZoomAreaPrivate {
   guint pan_button_mask;
   gboolean demo_draw_enabled;
   GdkRGBA bg_color;
+  gboolean tile_cache_enabled;  ///< if true, area-draw is rendered into tiles
+                                ///< which are cached and re-used
+  guint64 tile_cache_budget;    ///< maximum bytes of cached tiles
+  GtkPanZoomTileCache* tile_cache;  ///< created on first use
+  gint tile_scale_factor;       ///< widget scale factor of the cached tiles
+  gboolean scroll_blit_enabled;  ///< if true, the last frame is retained and
+                                 ///< shifted when the viewport is panned
+  cairo_surface_t* backing[2];   ///< ping-pong backing surfaces, [0] holds
+                                 ///< the last frame
+  GtkPanZoomViewport backing_viewport;  ///< viewport of the last frame
+  gint backing_scale_factor;     ///< widget scale factor of the last frame
+  gboolean backing_valid;        ///< false if the last frame must be redrawn
+  cairo_region_t* backing_damage;  ///< pixels of the last frame which must be
+                                   ///< redrawn, or NULL if there are none
+  RenderClosure* render_closure;  ///< if not null, content is rendered on a
+                                  ///< worker thread by this callback
+  GCancellable* render_cancellable;     ///< cancels the in-flight frame
+  GtkPanZoomViewport pending_viewport;  ///< viewport of the in-flight frame
+  gint pending_scale_factor;  ///< widget scale factor of the in-flight frame
+  cairo_surface_t* frame;         ///< last frame completed by a worker thread
+  GtkPanZoomViewport frame_viewport;  ///< viewport of `frame`
+  gint frame_scale_factor;    ///< widget scale factor of `frame`
+  gboolean frame_stale;  ///< true if the content has changed since `frame`
+  gboolean coalesce_events;  ///< if true, pan/zoom from input events is
+                             ///< accumulated and applied once per frame
+  gboolean motion_hint;      ///< if true, request motion events one at a time
+  gboolean has_pending;      ///< true if a pan/zoom has not yet been applied
+  double pending_offset[2];  ///< offset once the pending pan/zoom is applied
+  double pending_scale;      ///< scale once the pending pan/zoom is applied
+  guint pending_tick_id;     ///< tick callback which applies the pan/zoom
+  GtkPanZoomScene* scene;    ///< retained primitives, drawn before area-draw
+  double pick_tolerance;     ///< tolerance (in pixels) for hover picking
+  GtkPanZoomSceneId hover_id;  ///< scene primitive under the pointer
+  gboolean pointer_inside;     ///< true if the pointer is over the area
+  double pointer_pos[2];       ///< last pointer position, in widget pixels
+  GPtrArray* layers;           ///< PanZoomLayer, in drawing order
+  gboolean recording_enabled;  ///< if true, area-draw is recorded once and
+                               ///< replayed for each viewport
+  cairo_surface_t* recording;  ///< last recording of area-draw
+  GtkPanZoomViewport recording_viewport;  ///< viewport of `recording`
+  guint next_layer_id;         ///< id of the next layer to be added
 } GtkPanZoomAreaPrivate;
 
+/// Edge length (in pixels) of the tiles in the tile cache
+static const int kTileSize = 256;
+
+/// Default value of the tile-cache-budget property
+static const guint64 kDefaultTileCacheBudget = 64 * 1024 * 1024;
+
+/// A pan is blitted only if the shift is within this many pixels of an
+/// integer, so that the retained frame is not resampled.
+static const double kBlitTolerance = 1e-3;
+
+/// Damaged rectangles are grown by this many pixels on each side so that
+/// antialiased edges are redrawn along with the content.
+static const double kDamageMargin = 1.0;
+
+/// A recording of area-draw is replayed only while the zoom is within this
+/// factor of the zoom at which it was recorded. NOTE(josh): cairo stores
+/// recorded paths in 24.8 fixed point device coordinates, so precision is
+/// lost if a recording is magnified too far.
+static const double kMaxReplayZoom = 16.0;
+
+/// A recording of area-draw is replayed only while the visible rectangle is
+/// within this many pixels (at the recorded zoom) of the recorded origin,
+/// well within the range of 24.8 fixed point.
+static const double kMaxReplayExtent = 1 << 20;
+
+/// Edge length (in pixels) of the tiles of an export, which is also the
+/// height of each band of rows handed to the PNG encoder.
+static const int kExportTileSize = 512;
+
 // =============================================================================
 //  Type definition
 // =============================================================================
@@ -72,6 +205,13 @@ enum {
   PROP_ACTIVE,
   PROP_PAN_BUTTON,
   PROP_DEMO_DRAW_ENABLED,
+  PROP_TILE_CACHE_ENABLED,
+  PROP_TILE_CACHE_BUDGET,
+  PROP_SCROLL_BLIT_ENABLED,
+  PROP_COALESCE_EVENTS,
+  PROP_MOTION_HINT,
+  PROP_PICK_TOLERANCE,
+  PROP_RECORDING_ENABLED,
   N_PROPERTIES
 };
 
@@ -85,6 +225,8 @@ enum {
   SIGNO_AREA_MOTION,
   SIGNO_AREA_BUTTON,
   SIGNO_AREA_DRAW,
+  SIGNO_AREA_DRAW_VIEWPORT,
+  SIGNO_AREA_HOVER,
   N_SIGNALS,
 };
 
@@ -112,9 +254,13 @@ static gboolean gtk_panzoom_area_button_release_event(GtkWidget* widget,
                                                       GdkEventButton* event);
 static gboolean gtk_panzoom_area_scroll_event(GtkWidget* widget,
                                               GdkEventScroll* event);
+static gboolean gtk_panzoom_area_leave_notify_event(GtkWidget* widget,
+                                                    GdkEventCrossing* event);
 static gboolean gtk_panzoom_area_draw(GtkWidget* widget, cairo_t* cr);
 static void gtk_panzoom_area_destroy(GtkWidget* widget);
 
+static void update_hover(GtkPanZoomArea* this);
+
 gboolean gtk_panzoom_area_sig_motion(GtkPanZoomArea* area,
                                      GdkEventMotion* event) {
   return FALSE;
@@ -195,6 +341,7 @@ static void gtk_panzoom_area_class_init(GtkPanZoomAreaClass* klass) {
   widget_class->button_press_event = gtk_panzoom_area_button_press_event;
   widget_class->button_release_event = gtk_panzoom_area_button_release_event;
   widget_class->scroll_event = gtk_panzoom_area_scroll_event;
+  widget_class->leave_notify_event = gtk_panzoom_area_leave_notify_event;
   widget_class->draw = gtk_panzoom_area_draw;
   widget_class->destroy = gtk_panzoom_area_destroy;
 
@@ -236,6 +383,56 @@ static void gtk_panzoom_area_class_init(GtkPanZoomAreaClass* klass) {
       "shapes so that there is a point of reference for pan/zoom actions.",
       FALSE, G_PARAM_READWRITE);
 
+  obj_properties[PROP_TILE_CACHE_ENABLED] = g_param_spec_boolean(
+      "tile-cache-enabled", "Enable Tile Cache",
+      "If true, then the output of area-draw is rendered into fixed-size "
+      "tiles which are cached and re-used when the viewport is panned. Only "
+      "tiles which are not in the cache invoke the area-draw handlers. Call "
+      "gtk_panzoom_area_invalidate_cache() when the content changes.",
+      FALSE, G_PARAM_READWRITE);
+  obj_properties[PROP_TILE_CACHE_BUDGET] = g_param_spec_uint64(
+      "tile-cache-budget", "Tile Cache Budget",
+      "Maximum number of bytes of rendered tiles to retain in the tile "
+      "cache. The least recently used tiles are released first.",
+      0, G_MAXUINT64, kDefaultTileCacheBudget, G_PARAM_READWRITE);
+
+  obj_properties[PROP_SCROLL_BLIT_ENABLED] = g_param_spec_boolean(
+      "scroll-blit-enabled", "Enable Scroll Blit",
+      "If true, then the last frame is retained in a backing surface. When "
+      "the viewport is panned by a whole number of pixels the frame is "
+      "shifted and area-draw is only invoked for the newly exposed strips. "
+      "Call gtk_panzoom_area_invalidate_cache() when the content changes.",
+      FALSE, G_PARAM_READWRITE);
+
+  obj_properties[PROP_COALESCE_EVENTS] = g_param_spec_boolean(
+      "coalesce-events", "Coalesce Events",
+      "If true, then pan and zoom from mouse events are accumulated and "
+      "applied to the adjustments once per frame, during the update phase of "
+      "the frame clock. If false, they are applied on every event. Setting "
+      "the offset or scale in the meantime drops the accumulated change.",
+      TRUE, G_PARAM_READWRITE);
+  obj_properties[PROP_MOTION_HINT] = g_param_spec_boolean(
+      "motion-hint", "Motion Hint",
+      "If true, then the area selects GDK_POINTER_MOTION_HINT_MASK and "
+      "requests the next motion event only after the previous one has been "
+      "handled, so that at most one motion event is queued at a time.",
+      FALSE, G_PARAM_READWRITE);
+
+  obj_properties[PROP_PICK_TOLERANCE] = g_param_spec_double(
+      "pick-tolerance", "Pick Tolerance",
+      "Distance (in pixels) from the pointer within which a scene primitive "
+      "is considered to be under the pointer for area-hover.",
+      0, G_MAXDOUBLE, 3.0, G_PARAM_READWRITE);
+
+  obj_properties[PROP_RECORDING_ENABLED] = g_param_spec_boolean(
+      "recording-enabled", "Enable Recording",
+      "If true, then area-draw is emitted once into a cairo recording "
+      "surface which is replayed, with full vector quality, whenever the "
+      "viewport is panned or zoomed. Handlers must draw all of their content "
+      "regardless of the viewport. Call gtk_panzoom_area_invalidate_cache() "
+      "when the content changes.",
+      FALSE, G_PARAM_READWRITE);
+
   g_object_class_install_properties(object_class, N_PROPERTIES, obj_properties);
 
   // ------------------------
@@ -266,6 +463,77 @@ static void gtk_panzoom_area_class_init(GtkPanZoomAreaClass* klass) {
       G_STRUCT_OFFSET(GtkPanZoomAreaClass, area_draw),
       boolean_handled_accumulator, NULL, NULL, G_TYPE_BOOLEAN, 1,
       CAIRO_GOBJECT_TYPE_CONTEXT);
+
+  // NOTE(josh): the viewport is a `const GtkPanZoomViewport*` which is only
+  // valid for the duration of the emission. It describes the surface being
+  // drawn, which is not necessarily the whole widget (e.g. a single tile).
+  widget_signals[SIGNO_AREA_DRAW_VIEWPORT] =
+      g_signal_new(I_("area-draw-viewport"), G_TYPE_FROM_CLASS(gobject_class),
+                   G_SIGNAL_RUN_LAST,
+                   G_STRUCT_OFFSET(GtkPanZoomAreaClass, area_draw_viewport),
+                   boolean_handled_accumulator, NULL, NULL, G_TYPE_BOOLEAN, 2,
+                   CAIRO_GOBJECT_TYPE_CONTEXT, G_TYPE_POINTER);
+
+  // NOTE(josh): emitted with the id of the scene primitive under the pointer,
+  // only when it changes, whether because the pointer moved or because the
+  // view changed under it. Zero means that there is no primitive under the
+  // pointer, or that the pointer has left the area.
+  widget_signals[SIGNO_AREA_HOVER] = g_signal_new(
+      I_("area-hover"), G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST,
+      0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_UINT64);
+}
+
+// Drop any pan/zoom from input which has not yet been applied
+static void discard_pending_view(GtkPanZoomArea* this) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (priv->pending_tick_id) {
+    gtk_widget_remove_tick_callback(GTK_WIDGET(this), priv->pending_tick_id);
+    priv->pending_tick_id = 0;
+  }
+  priv->has_pending = FALSE;
+}
+
+// Executed when the offset or scale adjustment changes. A value set by the
+// application replaces any pan/zoom which is waiting for the next frame, so
+// that the next frame doesn't overwrite it.
+static void on_view_adjustment_changed(GtkAdjustment* adjustment,
+                                       gpointer user_data) {
+  discard_pending_view(GTK_PANZOOM_AREA(user_data));
+  update_hover(GTK_PANZOOM_AREA(user_data));
+}
+
+// Block or unblock on_view_adjustment_changed() while the area applies a
+// pan/zoom to several adjustments at once
+static void block_view_adjustments(GtkPanZoomArea* this, gboolean block) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GtkAdjustment* adjustments[3] = {priv->offset_x, priv->offset_y,
+                                   priv->scale};
+  for (size_t idx = 0; idx < 3; idx++) {
+    if (!adjustments[idx]) {
+      continue;
+    }
+    if (block) {
+      g_signal_handlers_block_by_func(
+          adjustments[idx], G_CALLBACK(on_view_adjustment_changed), this);
+    } else {
+      g_signal_handlers_unblock_by_func(
+          adjustments[idx], G_CALLBACK(on_view_adjustment_changed), this);
+    }
+  }
+}
+
+static void connect_view_adjustment(GtkPanZoomArea* this,
+                                    GtkAdjustment* adjustment) {
+  g_signal_connect(adjustment, "value-changed",
+                   G_CALLBACK(on_view_adjustment_changed), this);
+}
+
+static void disconnect_view_adjustment(GtkPanZoomArea* this,
+                                       GtkAdjustment* adjustment) {
+  if (adjustment) {
+    g_signal_handlers_disconnect_by_func(
+        adjustment, G_CALLBACK(on_view_adjustment_changed), this);
+  }
 }
 
 static void gtk_panzoom_area_init(GtkPanZoomArea* area) {
@@ -275,17 +543,50 @@ static void gtk_panzoom_area_init(GtkPanZoomArea* area) {
   priv->offset_y = gtk_adjustment_new(0, -1e6, 1e6, 1, 10, 10);
   priv->scale = gtk_adjustment_new(1.0, 0.01, 1e6, 1, 10, 10);
   priv->scale_rate = gtk_adjustment_new(2.0, 0.01, 1e4, 1, 10, 10);
+  connect_view_adjustment(area, priv->offset_x);
+  connect_view_adjustment(area, priv->offset_y);
+  connect_view_adjustment(area, priv->scale);
   priv->active = TRUE;
   priv->pan_button = 3;
   priv->pan_button_mask = GDK_BUTTON3_MASK;
   priv->demo_draw_enabled = FALSE;
   gdk_rgba_parse(&priv->bg_color, "#FFFFFF");
+  priv->tile_cache_enabled = FALSE;
+  priv->tile_cache_budget = kDefaultTileCacheBudget;
+  priv->tile_cache = NULL;
+  priv->tile_scale_factor = 0;
+  priv->scroll_blit_enabled = FALSE;
+  priv->backing[0] = NULL;
+  priv->backing[1] = NULL;
+  priv->backing_scale_factor = 0;
+  priv->backing_valid = FALSE;
+  priv->backing_damage = NULL;
+  priv->render_closure = NULL;
+  priv->render_cancellable = NULL;
+  priv->pending_scale_factor = 0;
+  priv->frame = NULL;
+  priv->frame_scale_factor = 0;
+  priv->frame_stale = FALSE;
+  priv->coalesce_events = TRUE;
+  priv->motion_hint = FALSE;
+  priv->has_pending = FALSE;
+  priv->pending_tick_id = 0;
+  priv->scene = NULL;
+  priv->pick_tolerance = 3.0;
+  priv->hover_id = 0;
+  priv->pointer_inside = FALSE;
+  priv->pointer_pos[0] = 0;
+  priv->pointer_pos[1] = 0;
+  priv->layers = g_ptr_array_new_with_free_func(panzoom_layer_free);
+  priv->next_layer_id = 1;
+  priv->recording_enabled = FALSE;
+  priv->recording = NULL;
 
   GtkWidget* widget = GTK_WIDGET(area);
 
   gint events = GDK_POINTER_MOTION_MASK | GDK_BUTTON_MOTION_MASK |
                 GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
-                GDK_SCROLL_MASK;
+                GDK_SCROLL_MASK | GDK_LEAVE_NOTIFY_MASK;
   gtk_widget_add_events(widget, events);
 }
 
@@ -308,6 +609,9 @@ void gtk_panzoom_area_get_offset(GtkPanZoomArea* this, double out[2]) {
 }
 void gtk_panzoom_area_set_offset(GtkPanZoomArea* this, double offset[2]) {
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  // NOTE(josh): value-changed is not emitted if the value is unchanged, but
+  // the pending pan/zoom must still be dropped
+  discard_pending_view(this);
   if (priv->offset_x) {
     gtk_adjustment_set_value(priv->offset_x, offset[0]);
   }
@@ -325,6 +629,7 @@ double gtk_panzoom_area_get_scale(GtkPanZoomArea* this) {
 }
 void gtk_panzoom_area_set_scale(GtkPanZoomArea* this, double scale) {
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  discard_pending_view(this);
   if (priv->scale) {
     gtk_adjustment_set_value(priv->scale, scale);
   }
@@ -381,15 +686,398 @@ void gtk_panzoom_area_transform_point(GtkPanZoomArea* this, const double in[2],
   }
 }
 
+void gtk_panzoom_area_transform_points(GtkPanZoomArea* this, const double* in,
+                                       double* out, size_t n) {
+  GtkPanZoomViewport viewport;
+  gtk_panzoom_area_get_viewport(this, &viewport);
+  gtk_panzoom_viewport_transform_points(&viewport, in, out, n);
+}
+
+void gtk_panzoom_area_inverse_transform_points(GtkPanZoomArea* this,
+                                               const double* in, double* out,
+                                               size_t n) {
+  GtkPanZoomViewport viewport;
+  gtk_panzoom_area_get_viewport(this, &viewport);
+  gtk_panzoom_viewport_inverse_transform_points(&viewport, in, out, n);
+}
+
+double gtk_panzoom_area_get_pixel_size(GtkPanZoomArea* this) {
+  GtkPanZoomViewport viewport;
+  gtk_panzoom_area_get_viewport(this, &viewport);
+  return gtk_panzoom_viewport_get_pixel_size(&viewport);
+}
+
+void gtk_panzoom_area_get_visible_rect(GtkPanZoomArea* this, double rect[4]) {
+  GtkPanZoomViewport viewport;
+  gtk_panzoom_area_get_viewport(this, &viewport);
+  gtk_panzoom_viewport_get_visible_rect(&viewport, rect);
+}
+
+void gtk_panzoom_area_get_viewport(GtkPanZoomArea* this,
+                                   GtkPanZoomViewport* viewport) {
+  GtkWidget* widget = GTK_WIDGET(this);
+  gtk_panzoom_area_get_offset(this, viewport->offset);
+  viewport->scale = gtk_panzoom_area_get_scale(this);
+  viewport->width = gtk_widget_get_allocated_width(widget);
+  viewport->height = gtk_widget_get_allocated_height(widget);
+}
+
+// Release the scroll-blit backing surfaces
+static void release_backing(GtkPanZoomAreaPrivate* priv) {
+  for (size_t idx = 0; idx < 2; idx++) {
+    if (priv->backing[idx]) {
+      cairo_surface_destroy(priv->backing[idx]);
+      priv->backing[idx] = NULL;
+    }
+  }
+  priv->backing_valid = FALSE;
+  if (priv->backing_damage) {
+    cairo_region_destroy(priv->backing_damage);
+    priv->backing_damage = NULL;
+  }
+}
+
+// Release the recording of area-draw
+static void release_recording(GtkPanZoomAreaPrivate* priv) {
+  if (priv->recording) {
+    cairo_surface_destroy(priv->recording);
+    priv->recording = NULL;
+  }
+}
+
+// Cancel the frame in flight on a worker thread, if there is one
+static void cancel_render_job(GtkPanZoomAreaPrivate* priv) {
+  if (priv->render_cancellable) {
+    g_cancellable_cancel(priv->render_cancellable);
+    g_clear_object(&priv->render_cancellable);
+  }
+}
+
+void gtk_panzoom_area_set_render_func(GtkPanZoomArea* this,
+                                      GtkPanZoomRenderFunc func,
+                                      gpointer user_data,
+                                      GDestroyNotify destroy) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  cancel_render_job(priv);
+  render_closure_unref(priv->render_closure);
+  priv->render_closure = NULL;
+  if (func) {
+    priv->render_closure = g_new0(RenderClosure, 1);
+    priv->render_closure->refcount = 1;
+    priv->render_closure->func = func;
+    priv->render_closure->user_data = user_data;
+    priv->render_closure->destroy = destroy;
+  }
+  if (priv->frame) {
+    cairo_surface_destroy(priv->frame);
+    priv->frame = NULL;
+  }
+  gtk_widget_queue_draw(GTK_WIDGET(this));
+}
+
+// Emit area-hover if the primitive under the pointer has changed
+static void set_hover_id(GtkPanZoomArea* this, GtkPanZoomSceneId id) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (id != priv->hover_id) {
+    priv->hover_id = id;
+    g_signal_emit(this, widget_signals[SIGNO_AREA_HOVER], 0, id);
+  }
+}
+
+// Pick the scene primitive under the last pointer position. This is done on
+// every motion event and again whenever the view changes, since the
+// primitive under a stationary pointer changes with it.
+static void update_hover(GtkPanZoomArea* this) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GtkPanZoomSceneId id = 0;
+  if (priv->scene && priv->pointer_inside) {
+    double point[2] = {0, 0};
+    gtk_panzoom_area_transform_point(this, priv->pointer_pos, point);
+    id = gtk_panzoom_area_pick(this, point[0], point[1], priv->pick_tolerance);
+  }
+  set_hover_id(this, id);
+}
+
+void gtk_panzoom_area_set_scene(GtkPanZoomArea* this, GtkPanZoomScene* scene) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  priv->scene = scene;
+  update_hover(this);
+  gtk_panzoom_area_invalidate_cache(this);
+}
+
+GtkPanZoomSceneId gtk_panzoom_area_pick(GtkPanZoomArea* this, double x,
+                                        double y, double tolerance_px) {
+  GtkPanZoomSceneId id = 0;
+  gtk_panzoom_area_pick_all(this, x, y, tolerance_px, &id, 1);
+  return id;
+}
+
+size_t gtk_panzoom_area_pick_all(GtkPanZoomArea* this, double x, double y,
+                                 double tolerance_px, GtkPanZoomSceneId* ids,
+                                 size_t capacity) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (!priv->scene) {
+    return 0;
+  }
+  double point[2] = {x, y};
+  double tolerance = tolerance_px * gtk_panzoom_area_get_pixel_size(this);
+  return gtk_panzoom_scene_pick(priv->scene, point, tolerance, ids, capacity);
+}
+
+GtkPanZoomScene* gtk_panzoom_area_get_scene(GtkPanZoomArea* this) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  return priv->scene;
+}
+
+// Return the layer with the given id, or NULL if there is none
+static PanZoomLayer* find_layer(GtkPanZoomAreaPrivate* priv, guint layer_id,
+                                guint* index) {
+  if (!priv->layers) {
+    return NULL;
+  }
+  for (guint idx = 0; idx < priv->layers->len; idx++) {
+    PanZoomLayer* layer = g_ptr_array_index(priv->layers, idx);
+    if (layer->id == layer_id) {
+      if (index) {
+        *index = idx;
+      }
+      return layer;
+    }
+  }
+  return NULL;
+}
+
+guint gtk_panzoom_area_add_layer(GtkPanZoomArea* this,
+                                 GtkPanZoomLayerFunc func, gpointer user_data,
+                                 GDestroyNotify destroy, gboolean cached) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  g_return_val_if_fail(func != NULL, 0);
+  g_return_val_if_fail(priv->layers != NULL, 0);
+  PanZoomLayer* layer = g_new0(PanZoomLayer, 1);
+  layer->id = priv->next_layer_id++;
+  layer->func = func;
+  layer->user_data = user_data;
+  layer->destroy = destroy;
+  layer->cached = cached;
+  layer->visible = TRUE;
+  layer->dirty = TRUE;
+  g_ptr_array_add(priv->layers, layer);
+  gtk_widget_queue_draw(GTK_WIDGET(this));
+  return layer->id;
+}
+
+gboolean gtk_panzoom_area_remove_layer(GtkPanZoomArea* this, guint layer_id) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  guint index = 0;
+  if (!find_layer(priv, layer_id, &index)) {
+    return FALSE;
+  }
+  g_ptr_array_remove_index(priv->layers, index);
+  gtk_widget_queue_draw(GTK_WIDGET(this));
+  return TRUE;
+}
+
+void gtk_panzoom_area_set_layer_visible(GtkPanZoomArea* this, guint layer_id,
+                                        gboolean visible) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  PanZoomLayer* layer = find_layer(priv, layer_id, NULL);
+  if (layer && layer->visible != visible) {
+    layer->visible = visible;
+    gtk_widget_queue_draw(GTK_WIDGET(this));
+  }
+}
+
+void gtk_panzoom_area_invalidate_layer(GtkPanZoomArea* this, guint layer_id) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  PanZoomLayer* layer = find_layer(priv, layer_id, NULL);
+  if (layer) {
+    layer->dirty = TRUE;
+    gtk_widget_queue_draw(GTK_WIDGET(this));
+  }
+}
+
+static void draw_raster_layer(GtkPanZoomArea* this, cairo_t* cr,
+                              const GtkPanZoomViewport* viewport,
+                              gpointer user_data) {
+  gtk_panzoom_raster_draw(user_data, cr, viewport);
+}
+
+guint gtk_panzoom_area_add_raster_layer(GtkPanZoomArea* this,
+                                        GtkPanZoomRaster* raster) {
+  g_return_val_if_fail(raster != NULL, 0);
+  return gtk_panzoom_area_add_layer(this, draw_raster_layer, raster, NULL,
+                                    TRUE);
+}
+
+void gtk_panzoom_area_invalidate_cache(GtkPanZoomArea* this) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (priv->tile_cache) {
+    gtk_panzoom_tile_cache_clear(priv->tile_cache);
+  }
+  priv->backing_valid = FALSE;
+  release_recording(priv);
+  // NOTE(josh): the last frame is kept as a preview until its replacement is
+  // ready.
+  priv->frame_stale = TRUE;
+  cancel_render_job(priv);
+  gtk_widget_queue_draw(GTK_WIDGET(this));
+}
+
+void gtk_panzoom_area_invalidate_virtual_rect(GtkPanZoomArea* this, double x0,
+                                              double y0, double x1,
+                                              double y1) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  double rect[4] = {fmin(x0, x1), fmin(y0, y1), fmax(x0, x1), fmax(y0, y1)};
+  if (priv->tile_cache) {
+    gtk_panzoom_tile_cache_remove_rect(priv->tile_cache, rect, kTileSize,
+                                       kDamageMargin);
+  }
+  if (priv->backing_valid) {
+    cairo_rectangle_int_t damage;
+    gtk_panzoom_viewport_get_device_rect(&priv->backing_viewport, rect,
+                                         kDamageMargin, &damage);
+    if (damage.width > 0 && damage.height > 0) {
+      if (!priv->backing_damage) {
+        priv->backing_damage = cairo_region_create();
+      }
+      cairo_region_union_rectangle(priv->backing_damage, &damage);
+    }
+  }
+  // NOTE(josh): a recording, or a frame rendered on a worker thread, can only
+  // be replaced as a whole
+  release_recording(priv);
+  if (priv->render_closure) {
+    priv->frame_stale = TRUE;
+    cancel_render_job(priv);
+  }
+
+  GtkPanZoomViewport viewport;
+  gtk_panzoom_area_get_viewport(this, &viewport);
+  cairo_rectangle_int_t damage;
+  gtk_panzoom_viewport_get_device_rect(&viewport, rect, kDamageMargin,
+                                       &damage);
+  if (damage.width > 0 && damage.height > 0) {
+    gtk_widget_queue_draw_area(GTK_WIDGET(this), damage.x, damage.y,
+                               damage.width, damage.height);
+  }
+}
+
 void gtk_panzoom_area_set_demodraw(GtkPanZoomArea* this, gboolean enabled) {
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
   priv->demo_draw_enabled = enabled;
+  gtk_panzoom_area_invalidate_cache(this);
 }
 
 void gtk_panzoom_area_set_background_color(GtkPanZoomArea* this,
                                            GdkRGBA* color) {
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
   priv->bg_color = *color;
+  gtk_panzoom_area_invalidate_cache(this);
+}
+
+// Return `value` clamped to the range which `adjustment` would accept
+static double clamp_adjustment_value(GtkAdjustment* adjustment, double value) {
+  if (!adjustment) {
+    return value;
+  }
+  double lower = gtk_adjustment_get_lower(adjustment);
+  double upper = gtk_adjustment_get_upper(adjustment) -
+                 gtk_adjustment_get_page_size(adjustment);
+  return fmin(fmax(value, lower), fmax(lower, upper));
+}
+
+// Get the offset and scale that the viewport will have once any pending
+// pan/zoom has been applied.
+static void get_target_view(GtkPanZoomArea* this, double offset[2],
+                            double* scale) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (priv->has_pending) {
+    offset[0] = priv->pending_offset[0];
+    offset[1] = priv->pending_offset[1];
+    *scale = priv->pending_scale;
+  } else {
+    gtk_panzoom_area_get_offset(this, offset);
+    *scale = gtk_panzoom_area_get_scale(this);
+  }
+}
+
+// Apply any pending pan/zoom to the adjustments
+static void flush_pending_view(GtkPanZoomArea* this) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (!priv->has_pending) {
+    return;
+  }
+  priv->has_pending = FALSE;
+  // NOTE(josh): the handlers are blocked so that the pointer is not picked
+  // against a view with the new scale but the old offset
+  block_view_adjustments(this, TRUE);
+  if (priv->scale) {
+    gtk_adjustment_set_value(priv->scale, priv->pending_scale);
+  }
+  gtk_panzoom_area_set_offset(this, priv->pending_offset);
+  block_view_adjustments(this, FALSE);
+  update_hover(this);
+  gtk_widget_queue_draw(GTK_WIDGET(this));
+}
+
+// Tick callback, executed during the update phase of the frame clock
+static gboolean flush_pending_view_tick(GtkWidget* widget,
+                                        GdkFrameClock* frame_clock,
+                                        gpointer user_data) {
+  GtkPanZoomArea* this = GTK_PANZOOM_AREA(widget);
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  priv->pending_tick_id = 0;
+  flush_pending_view(this);
+  return G_SOURCE_REMOVE;
+}
+
+// Set the offset and scale of the viewport in response to an input event.
+// If events are coalesced then this is deferred until the next frame, and
+// any further changes before then are merged.
+static void set_target_view(GtkPanZoomArea* this, const double offset[2],
+                            double scale) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GtkWidget* widget = GTK_WIDGET(this);
+  priv->has_pending = TRUE;
+  priv->pending_offset[0] = clamp_adjustment_value(priv->offset_x, offset[0]);
+  priv->pending_offset[1] = clamp_adjustment_value(priv->offset_y, offset[1]);
+  priv->pending_scale = clamp_adjustment_value(priv->scale, scale);
+  if (!priv->coalesce_events || !gtk_widget_get_realized(widget)) {
+    flush_pending_view(this);
+    return;
+  }
+  if (!priv->pending_tick_id) {
+    priv->pending_tick_id = gtk_widget_add_tick_callback(
+        widget, flush_pending_view_tick, NULL, NULL);
+  }
+}
+
+// Select or deselect GDK_POINTER_MOTION_HINT_MASK on the widget and, if it
+// is realized, its window.
+static void update_motion_hint(GtkPanZoomArea* this) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GtkWidget* widget = GTK_WIDGET(this);
+  gint events = gtk_widget_get_events(widget);
+  if (priv->motion_hint) {
+    events |= GDK_POINTER_MOTION_HINT_MASK;
+  } else {
+    events &= ~GDK_POINTER_MOTION_HINT_MASK;
+  }
+
+  GdkWindow* window = gtk_widget_get_window(widget);
+  if (gtk_widget_get_realized(widget) && window) {
+    // NOTE(josh): gtk_widget_set_events() may only be called on an
+    // unrealized widget.
+    GdkEventMask window_events = gdk_window_get_events(window);
+    if (priv->motion_hint) {
+      window_events |= GDK_POINTER_MOTION_HINT_MASK;
+    } else {
+      window_events &= ~GDK_POINTER_MOTION_HINT_MASK;
+    }
+    gdk_window_set_events(window, window_events);
+  } else {
+    gtk_widget_set_events(widget, events);
+  }
 }
 
 GtkWidget* gtk_panzoom_area_new() {
@@ -434,16 +1122,22 @@ static void gtk_panzoom_area_set_property(GObject* object, guint property_id,
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
   switch (property_id) {
     case PROP_OFFSET_X_ADJUSTMENT: {
+      disconnect_view_adjustment(this, priv->offset_x);
       set_adjustment(&(priv->offset_x), value);
+      connect_view_adjustment(this, priv->offset_x);
       break;
     }
 
     case PROP_OFFSET_Y_ADJUSTMENT: {
+      disconnect_view_adjustment(this, priv->offset_y);
       set_adjustment(&(priv->offset_y), value);
+      connect_view_adjustment(this, priv->offset_y);
       break;
     }
     case PROP_SCALE_ADJUSTMENT: {
+      disconnect_view_adjustment(this, priv->scale);
       set_adjustment(&(priv->scale), value);
+      connect_view_adjustment(this, priv->scale);
       break;
     }
     case PROP_SCALE_RATE_ADJUSTMENT: {
@@ -463,6 +1157,60 @@ static void gtk_panzoom_area_set_property(GObject* object, guint property_id,
 
     case PROP_DEMO_DRAW_ENABLED: {
       priv->demo_draw_enabled = g_value_get_boolean(value);
+      gtk_panzoom_area_invalidate_cache(this);
+      break;
+    }
+
+    case PROP_TILE_CACHE_ENABLED: {
+      priv->tile_cache_enabled = g_value_get_boolean(value);
+      if (!priv->tile_cache_enabled && priv->tile_cache) {
+        gtk_panzoom_tile_cache_free(priv->tile_cache);
+        priv->tile_cache = NULL;
+      }
+      gtk_widget_queue_draw(GTK_WIDGET(this));
+      break;
+    }
+
+    case PROP_TILE_CACHE_BUDGET: {
+      priv->tile_cache_budget = g_value_get_uint64(value);
+      if (priv->tile_cache) {
+        gtk_panzoom_tile_cache_set_budget(priv->tile_cache,
+                                          priv->tile_cache_budget);
+      }
+      break;
+    }
+
+    case PROP_SCROLL_BLIT_ENABLED: {
+      priv->scroll_blit_enabled = g_value_get_boolean(value);
+      if (!priv->scroll_blit_enabled) {
+        release_backing(priv);
+      }
+      gtk_widget_queue_draw(GTK_WIDGET(this));
+      break;
+    }
+
+    case PROP_COALESCE_EVENTS: {
+      priv->coalesce_events = g_value_get_boolean(value);
+      if (!priv->coalesce_events) {
+        flush_pending_view(this);
+      }
+      break;
+    }
+
+    case PROP_MOTION_HINT: {
+      priv->motion_hint = g_value_get_boolean(value);
+      update_motion_hint(this);
+      break;
+    }
+
+    case PROP_PICK_TOLERANCE: {
+      priv->pick_tolerance = g_value_get_double(value);
+      break;
+    }
+
+    case PROP_RECORDING_ENABLED: {
+      priv->recording_enabled = g_value_get_boolean(value);
+      gtk_panzoom_area_invalidate_cache(this);
       break;
     }
 
@@ -507,6 +1255,41 @@ static void gtk_panzoom_area_get_property(GObject* object, guint property_id,
       break;
     }
 
+    case PROP_TILE_CACHE_ENABLED: {
+      g_value_set_boolean(value, priv->tile_cache_enabled);
+      break;
+    }
+
+    case PROP_TILE_CACHE_BUDGET: {
+      g_value_set_uint64(value, priv->tile_cache_budget);
+      break;
+    }
+
+    case PROP_SCROLL_BLIT_ENABLED: {
+      g_value_set_boolean(value, priv->scroll_blit_enabled);
+      break;
+    }
+
+    case PROP_COALESCE_EVENTS: {
+      g_value_set_boolean(value, priv->coalesce_events);
+      break;
+    }
+
+    case PROP_MOTION_HINT: {
+      g_value_set_boolean(value, priv->motion_hint);
+      break;
+    }
+
+    case PROP_PICK_TOLERANCE: {
+      g_value_set_double(value, priv->pick_tolerance);
+      break;
+    }
+
+    case PROP_RECORDING_ENABLED: {
+      g_value_set_boolean(value, priv->recording_enabled);
+      break;
+    }
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
       break;
@@ -515,6 +1298,18 @@ static void gtk_panzoom_area_get_property(GObject* object, guint property_id,
 
 static void gtk_panzoom_area_finalize(GObject* gobject) {
   // Free any non-reference counted stuff here
+  GtkPanZoomArea* this = GTK_PANZOOM_AREA(gobject);
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  gtk_panzoom_tile_cache_free(priv->tile_cache);
+  priv->tile_cache = NULL;
+  release_backing(priv);
+  render_closure_unref(priv->render_closure);
+  priv->render_closure = NULL;
+  if (priv->frame) {
+    cairo_surface_destroy(priv->frame);
+    priv->frame = NULL;
+  }
+  release_recording(priv);
   G_OBJECT_CLASS(gtk_panzoom_area_parent_class)->finalize(gobject);
 }
 
@@ -530,11 +1325,24 @@ static gboolean gtk_panzoom_area_motion_notify_event(GtkWidget* widget,
   GtkPanZoomArea* this = GTK_PANZOOM_AREA(widget);
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
 
+  if (event->is_hint) {
+    // Ask for the next motion event now that we are handling this one
+    gdk_event_request_motions(event);
+  }
+
   // Re-emit the event via the transformed signal.
   GTK_WIDGET_CLASS(gtk_panzoom_area_parent_class)
       ->motion_notify_event(widget, event);
   GdkEventMotion transformed = *event;
   gtk_panzoom_area_transform_point(this, &event->x, &transformed.x);
+  // NOTE(josh): motion is still reported outside of the area while a button
+  // is held
+  priv->pointer_pos[0] = event->x;
+  priv->pointer_pos[1] = event->y;
+  priv->pointer_inside = event->x >= 0 && event->y >= 0 &&
+                         event->x < gtk_widget_get_allocated_width(widget) &&
+                         event->y < gtk_widget_get_allocated_height(widget);
+  update_hover(this);
   gboolean handled_by_transformed = FALSE;
   g_signal_emit(widget, widget_signals[SIGNO_AREA_MOTION], 0, &transformed,
                 &handled_by_transformed);
@@ -550,11 +1358,11 @@ static gboolean gtk_panzoom_area_motion_notify_event(GtkWidget* widget,
                              // coordinates with origin in the bottom left
 
     double new_offset[2] = {0, 0};  //< new offset of the viewport
-    double scale = gtk_panzoom_area_get_scale(this);
+    double scale = 1.0;
     double maxdim = gtk_panzoom_area_get_max_dim(this);
 
     gtk_panzoom_area_get_rawpoint(this, &event->x, loc);
-    gtk_panzoom_area_get_offset(this, offset);
+    get_target_view(this, offset, &scale);
 
     for (size_t idx = 0; idx < 2; idx++) {
       // The (x or y) relative change in mouse pointer coordinate
@@ -564,8 +1372,7 @@ static gboolean gtk_panzoom_area_motion_notify_event(GtkWidget* widget,
       // Update the last observed mouse position
       priv->last_pos[idx] = loc[idx];
     }
-    gtk_panzoom_area_set_offset(this, new_offset);
-    gtk_widget_queue_draw(widget);
+    set_target_view(this, new_offset, scale);
     return TRUE;
   }
 
@@ -620,20 +1427,24 @@ static gboolean gtk_panzoom_area_scroll_event(GtkWidget* widget,
   // the same location in the scaled view
   double rawpoint[2] = {0, 0};
   double centerpoint[2] = {0, 0};
+  double offset[2] = {0, 0};
+  double scale = 1.0;
+  double maxdim = gtk_panzoom_area_get_max_dim(this);
   gtk_panzoom_area_get_rawpoint(this, &event->x, rawpoint);
-  gtk_panzoom_area_transform_point(this, &event->x, centerpoint);
+  get_target_view(this, offset, &scale);
+  for (size_t idx = 0; idx < 2; idx++) {
+    centerpoint[idx] = offset[idx] + (rawpoint[idx] * (scale / maxdim));
+  }
 
   if (event->direction == GDK_SCROLL_UP) {
     if (priv->scale) {
-      double current_value = gtk_adjustment_get_value(priv->scale);
       double scale_rate = gtk_panzoom_area_get_scale_rate(this);
-      gtk_adjustment_set_value(priv->scale, current_value * scale_rate);
+      scale = clamp_adjustment_value(priv->scale, scale * scale_rate);
     }
   } else if (event->direction == GDK_SCROLL_DOWN) {
     if (priv->scale) {
-      double current_value = gtk_adjustment_get_value(priv->scale);
       double scale_rate = gtk_panzoom_area_get_scale_rate(this);
-      gtk_adjustment_set_value(priv->scale, current_value / scale_rate);
+      scale = clamp_adjustment_value(priv->scale, scale / scale_rate);
     }
   } else {
     GtkWidgetClass* widget_class =
@@ -647,49 +1458,798 @@ static gboolean gtk_panzoom_area_scroll_event(GtkWidget* widget,
 
   // Compute the viewpoint delta that will keep the current viewport
   // center.
-  double scale = gtk_panzoom_area_get_scale(this);
-  double maxdim = gtk_panzoom_area_get_max_dim(this);
-  double offset[2] = {0, 0};
   for (size_t idx = 0; idx < 2; idx++) {
     offset[idx] = centerpoint[idx] - (rawpoint[idx] * (scale / maxdim));
   }
-  gtk_panzoom_area_set_offset(this, offset);
-
-  gtk_widget_queue_draw(widget);
+  set_target_view(this, offset, scale);
   return TRUE;
 }
 
-static gboolean gtk_panzoom_area_draw(GtkWidget* widget, cairo_t* cr) {
+static gboolean gtk_panzoom_area_leave_notify_event(GtkWidget* widget,
+                                                    GdkEventCrossing* event) {
   GtkPanZoomArea* this = GTK_PANZOOM_AREA(widget);
-  GtkPanZoomAreaPrivate* priv =
-      gtk_panzoom_area_get_instance_private(GTK_PANZOOM_AREA(widget));
-  // draw a white rectangle with black border for the background
-  double allocated_width = gtk_widget_get_allocated_width(widget);
-  double allocated_height = gtk_widget_get_allocated_height(widget);
-  cairo_rectangle(cr, 0, 0, allocated_width, allocated_height);
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  priv->pointer_inside = FALSE;
+  set_hover_id(this, 0);
+
+  GtkWidgetClass* widget_class =
+      GTK_WIDGET_CLASS(gtk_panzoom_area_parent_class);
+  if (widget_class->leave_notify_event) {
+    return widget_class->leave_notify_event(widget, event);
+  }
+  return FALSE;
+}
+
+// Emit area-draw, and then area-draw-viewport if area-draw was not handled.
+// The transformation of `cr` must already map the virtual plane to device
+// pixels of `viewport`.
+static void emit_area_draw(GtkPanZoomArea* this, cairo_t* cr,
+                           const GtkPanZoomViewport* viewport) {
+  gboolean result = FALSE;
+  cairo_save(cr);
+  g_signal_emit(this, widget_signals[SIGNO_AREA_DRAW], 0, cr, &result);
+  cairo_restore(cr);
+  if (!result) {
+    cairo_save(cr);
+    g_signal_emit(this, widget_signals[SIGNO_AREA_DRAW_VIEWPORT], 0, cr,
+                  viewport, &result);
+    cairo_restore(cr);
+  }
+}
+
+// Return true if the recording of area-draw can be replayed for `viewport`
+// without loss of precision.
+static gboolean is_recording_usable(GtkPanZoomAreaPrivate* priv,
+                                    const GtkPanZoomViewport* viewport) {
+  if (!priv->recording) {
+    return FALSE;
+  }
+  double ratio =
+      gtk_panzoom_viewport_get_pixel_size(&priv->recording_viewport) /
+      gtk_panzoom_viewport_get_pixel_size(viewport);
+  if (ratio > kMaxReplayZoom || ratio < 1.0 / kMaxReplayZoom) {
+    return FALSE;
+  }
+  double corners[4] = {0, 0, 0, 0};
+  gtk_panzoom_viewport_get_visible_rect(viewport, corners);
+  gtk_panzoom_viewport_inverse_transform_points(&priv->recording_viewport,
+                                                corners, corners, 2);
+  for (size_t idx = 0; idx < 4; idx++) {
+    if (fabs(corners[idx]) > kMaxReplayExtent) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// Record area-draw at the resolution of `viewport`
+static void record_content(GtkPanZoomArea* this,
+                           const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  release_recording(priv);
+  priv->recording =
+      cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, NULL);
+  priv->recording_viewport = *viewport;
+
+  cairo_t* cr = cairo_create(priv->recording);
+  gtk_panzoom_viewport_apply(viewport, cr);
+  cairo_set_line_width(cr, gtk_panzoom_viewport_get_pixel_size(viewport));
+  emit_area_draw(this, cr, viewport);
+  cairo_destroy(cr);
+}
+
+// Replay the recording of area-draw, which must be usable for `viewport`.
+// The transformation of `cr` must already map the virtual plane to device
+// pixels of `viewport`.
+static void replay_content(GtkPanZoomArea* this, cairo_t* cr,
+                           const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  // Map pixels of the recording to the virtual plane
+  cairo_matrix_t matrix;
+  gtk_panzoom_viewport_get_matrix(&priv->recording_viewport, &matrix);
+  cairo_save(cr);
+  cairo_transform(cr, &matrix);
+  cairo_set_source_surface(cr, priv->recording, 0, 0);
+  cairo_paint(cr);
+  cairo_restore(cr);
+}
+
+// Draw the scene (if any) and emit area-draw, and then area-draw-viewport if
+// area-draw was not handled (or replay the recording of them), with the
+// transformation of `cr` multiplied such that drawing commands in the virtual
+// plane map to device pixels of `viewport`. If `may_record` is false then the
+// recording is replayed only if it is already usable for `viewport`, and it is
+// never replaced.
+static void render_content(GtkPanZoomArea* this, cairo_t* cr,
+                           const GtkPanZoomViewport* viewport,
+                           gboolean may_record) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  cairo_save(cr);
+  gtk_panzoom_viewport_apply(viewport, cr);
+  cairo_set_line_width(cr, gtk_panzoom_viewport_get_pixel_size(viewport));
+  if (priv->scene) {
+    gtk_panzoom_scene_draw(priv->scene, cr, viewport);
+  }
+  if (priv->recording_enabled && may_record &&
+      !is_recording_usable(priv, viewport)) {
+    record_content(this, viewport);
+  }
+  if (priv->recording_enabled && is_recording_usable(priv, viewport)) {
+    replay_content(this, cr, viewport);
+  } else {
+    emit_area_draw(this, cr, viewport);
+  }
+  cairo_restore(cr);
+}
+
+// Fill the background and render the content of the whole viewport directly
+// into `cr`.
+static void render_viewport(GtkPanZoomArea* this, cairo_t* cr,
+                            const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  // draw a white rectangle for the background
+  cairo_rectangle(cr, 0, 0, viewport->width, viewport->height);
   cairo_set_source_rgba_gdk(cr, &priv->bg_color);
   cairo_fill_preserve(cr);
-  cairo_set_source_rgb(cr, 0, 0, 0);
-  cairo_stroke_preserve(cr);
 
   // scale and translate so that we can draw in cartesian coordinates
   cairo_save(cr);
   cairo_clip(cr);
-  // make it so that drawing commands in the virtual space map to pixel
-  // coordinates
-  double max_dim = gtk_panzoom_area_get_max_dim(this);
-  double scale = gtk_panzoom_area_get_scale(this);
-  double offset[2] = {0, 0};
-  gtk_panzoom_area_get_offset(this, offset);
+  render_content(this, cr, viewport, TRUE);
+  cairo_restore(cr);
+}
+
+// Draw the black border of the viewport. This is done once per frame, on top
+// of the content and all layers.
+static void render_border(cairo_t* cr, const GtkPanZoomViewport* viewport) {
+  cairo_rectangle(cr, 0, 0, viewport->width, viewport->height);
+  cairo_set_source_rgb(cr, 0, 0, 0);
+  cairo_stroke(cr);
+}
+
+// Fill the background and render the content within the current clip of
+// `cr` (see render_content() for `may_record`).
+static void render_background_and_content(GtkPanZoomArea* this, cairo_t* cr,
+                                          const GtkPanZoomViewport* viewport,
+                                          gboolean may_record) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  cairo_save(cr);
+  cairo_set_source_rgba_gdk(cr, &priv->bg_color);
+  cairo_paint(cr);
+  cairo_restore(cr);
+  render_content(this, cr, viewport, may_record);
+}
 
-  cairo_scale(cr, max_dim / scale, -max_dim / scale);
-  cairo_translate(cr, 0, -scale * allocated_height / max_dim);
-  cairo_translate(cr, -offset[0], -offset[1]);
+// Create an offscreen image surface of the given size (in logical pixels)
+// into which content may be rendered and later composited onto the widget.
+static cairo_surface_t* create_offscreen_surface(GtkPanZoomArea* this,
+                                                 int width, int height) {
+  GtkWidget* widget = GTK_WIDGET(this);
+  GdkWindow* window = gtk_widget_get_window(widget);
+  if (window) {
+    // NOTE(josh): similar to the window so that the surface matches the
+    // device scale
+    return gdk_window_create_similar_image_surface(
+        window, CAIRO_FORMAT_ARGB32, width, height,
+        gtk_widget_get_scale_factor(widget));
+  }
+  return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+}
 
-  cairo_set_line_width(cr, 1.0 * scale / max_dim);
-  gboolean result = FALSE;
-  g_signal_emit(widget, widget_signals[SIGNO_AREA_DRAW], 0, cr, &result);
+// Render the content of tile (tile_x, tile_y) at the given pixel size into a
+// new surface. Tile (i, j) spans the virtual rectangle with bottom left
+// corner at (i, j) * kTileSize * pixel_size.
+static cairo_surface_t* render_tile(GtkPanZoomArea* this, double pixel_size,
+                                    int64_t tile_x, int64_t tile_y) {
+  cairo_surface_t* tile = create_offscreen_surface(this, kTileSize, kTileSize);
+
+  GtkPanZoomViewport tile_viewport = {
+      .offset = {tile_x * kTileSize * pixel_size,
+                 tile_y * kTileSize * pixel_size},
+      .scale = kTileSize * pixel_size,
+      .width = kTileSize,
+      .height = kTileSize};
+
+  cairo_t* cr = cairo_create(tile);
+  render_background_and_content(this, cr, &tile_viewport, TRUE);
+  cairo_destroy(cr);
+  return tile;
+}
+
+// Composite the tiles covering `viewport`, rendering only those which are not
+// already in the cache.
+static void render_viewport_tiled(GtkPanZoomArea* this, cairo_t* cr,
+                                  const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (!priv->tile_cache) {
+    priv->tile_cache = gtk_panzoom_tile_cache_new(priv->tile_cache_budget);
+  }
+  // Tiles are keyed only by their pixel size, so tiles rendered at another
+  // device scale (e.g. before the window moved to another monitor) are
+  // discarded rather than composited at the wrong resolution
+  gint scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(this));
+  if (priv->tile_scale_factor != scale_factor) {
+    gtk_panzoom_tile_cache_clear(priv->tile_cache);
+    priv->tile_scale_factor = scale_factor;
+  }
+
+  double pixel_size = gtk_panzoom_viewport_get_pixel_size(viewport);
+  double tile_extent = kTileSize * pixel_size;
+  int64_t tile_x_begin = (int64_t)floor(viewport->offset[0] / tile_extent);
+  int64_t tile_x_end = (int64_t)floor(
+      (viewport->offset[0] + viewport->width * pixel_size) / tile_extent);
+  int64_t tile_y_begin = (int64_t)floor(viewport->offset[1] / tile_extent);
+  int64_t tile_y_end = (int64_t)floor(
+      (viewport->offset[1] + viewport->height * pixel_size) / tile_extent);
+
+  // Only tiles which intersect the region being redrawn are needed
+  double clip[4] = {0, 0, 0, 0};
+  cairo_clip_extents(cr, &clip[0], &clip[1], &clip[2], &clip[3]);
+
+  for (int64_t tile_y = tile_y_begin; tile_y <= tile_y_end; tile_y++) {
+    for (int64_t tile_x = tile_x_begin; tile_x <= tile_x_end; tile_x++) {
+      // NOTE(josh): The device position of the tile is rounded so that tiles
+      // are composited without resampling. All tiles share the same
+      // fractional offset, so they remain seamless.
+      double x = round(tile_x * kTileSize - viewport->offset[0] / pixel_size);
+      double y = round(viewport->height - (tile_y + 1) * kTileSize +
+                       viewport->offset[1] / pixel_size);
+      if (x + kTileSize <= clip[0] || x >= clip[2] ||
+          y + kTileSize <= clip[1] || y >= clip[3]) {
+        continue;
+      }
+
+      cairo_surface_t* tile = gtk_panzoom_tile_cache_lookup(
+          priv->tile_cache, pixel_size, tile_x, tile_y);
+      if (!tile) {
+        tile = render_tile(this, pixel_size, tile_x, tile_y);
+        gtk_panzoom_tile_cache_insert(priv->tile_cache, pixel_size, tile_x,
+                                      tile_y, tile);
+      }
+      cairo_set_source_surface(cr, tile, x, y);
+      cairo_rectangle(cr, x, y, kTileSize, kTileSize);
+      cairo_fill(cr);
+      cairo_surface_destroy(tile);
+    }
+  }
+}
+
+// If the frame rendered for `prev` can be re-used for `next` by shifting it
+// a whole number of pixels, then store that shift in `delta` and return
+// true.
+static gboolean get_blit_delta(const GtkPanZoomViewport* prev,
+                               const GtkPanZoomViewport* next, int delta[2]) {
+  if (prev->width != next->width || prev->height != next->height ||
+      prev->scale != next->scale) {
+    return FALSE;
+  }
+
+  double pixel_size = gtk_panzoom_viewport_get_pixel_size(next);
+  double shift[2] = {(prev->offset[0] - next->offset[0]) / pixel_size,
+                     (next->offset[1] - prev->offset[1]) / pixel_size};
+  int dims[2] = {next->width, next->height};
+  for (size_t idx = 0; idx < 2; idx++) {
+    double rounded = round(shift[idx]);
+    if (fabs(shift[idx] - rounded) > kBlitTolerance ||
+        fabs(rounded) >= dims[idx]) {
+      return FALSE;
+    }
+    delta[idx] = (int)rounded;
+  }
+  return TRUE;
+}
+
+// Add to the path of `cr` the strips of `viewport` which are exposed when
+// the previous frame is shifted by `delta` pixels.
+static void add_exposed_strips(cairo_t* cr, const GtkPanZoomViewport* viewport,
+                               const int delta[2]) {
+  int width = viewport->width;
+  int height = viewport->height;
+  if (delta[0] > 0) {
+    cairo_rectangle(cr, 0, 0, delta[0], height);
+  } else if (delta[0] < 0) {
+    cairo_rectangle(cr, width + delta[0], 0, -delta[0], height);
+  }
+  if (delta[1] > 0) {
+    cairo_rectangle(cr, 0, 0, width, delta[1]);
+  } else if (delta[1] < 0) {
+    cairo_rectangle(cr, 0, height + delta[1], width, -delta[1]);
+  }
+}
+
+// Bring the backing store up to date with `viewport`. If the viewport has
+// only been panned by a whole number of pixels then the last frame is
+// shifted and only the newly exposed strips are rendered. Otherwise the whole
+// frame is rendered.
+static void update_backing(GtkPanZoomArea* this,
+                           const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  gint scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(this));
+  if (priv->backing_scale_factor != scale_factor ||
+      priv->backing_viewport.width != viewport->width ||
+      priv->backing_viewport.height != viewport->height) {
+    release_backing(priv);
+  }
+
+  int delta[2] = {0, 0};
+  gboolean blit = priv->backing_valid &&
+                  get_blit_delta(&priv->backing_viewport, viewport, delta);
+  if (blit && delta[0] == 0 && delta[1] == 0 && !priv->backing_damage) {
+    return;
+  }
+
+  for (size_t idx = 0; idx < 2; idx++) {
+    if (!priv->backing[idx]) {
+      priv->backing[idx] =
+          create_offscreen_surface(this, viewport->width, viewport->height);
+    }
+  }
+
+  // NOTE(josh): cairo does not support overlapping copies within a single
+  // surface so we render into the second surface and then swap.
+  cairo_t* cr = cairo_create(priv->backing[1]);
+  if (blit) {
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, priv->backing[0], delta[0], delta[1]);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    // Restrict drawing to the strips exposed by the shift
+    add_exposed_strips(cr, viewport, delta);
+    // as well as regions damaged since the last frame
+    if (priv->backing_damage) {
+      cairo_region_translate(priv->backing_damage, delta[0], delta[1]);
+      int count = cairo_region_num_rectangles(priv->backing_damage);
+      for (int idx = 0; idx < count; idx++) {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(priv->backing_damage, idx, &rect);
+        cairo_rectangle(cr, rect.x, rect.y, rect.width, rect.height);
+      }
+    }
+    cairo_clip(cr);
+  }
+  render_background_and_content(this, cr, viewport, TRUE);
+  cairo_destroy(cr);
+  if (priv->backing_damage) {
+    cairo_region_destroy(priv->backing_damage);
+    priv->backing_damage = NULL;
+  }
+
+  cairo_surface_t* swap = priv->backing[0];
+  priv->backing[0] = priv->backing[1];
+  priv->backing[1] = swap;
+  priv->backing_viewport = *viewport;
+  priv->backing_scale_factor = scale_factor;
+  priv->backing_valid = TRUE;
+}
+
+// Composite the retained frame, updating it first if necessary.
+static void render_viewport_blit(GtkPanZoomArea* this, cairo_t* cr,
+                                 const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  update_backing(this, viewport);
+  cairo_set_source_surface(cr, priv->backing[0], 0, 0);
+  cairo_paint(cr);
+}
+
+// Data for one frame rendered on a worker thread
+typedef struct _RenderJob {
+  RenderClosure* closure;
+  GtkPanZoomViewport viewport;
+  gint scale_factor;  ///< widget scale factor of `surface`
+  GdkRGBA bg_color;
+  cairo_surface_t* surface;
+} RenderJob;
+
+static void render_job_free(gpointer data) {
+  RenderJob* job = data;
+  render_closure_unref(job->closure);
+  cairo_surface_destroy(job->surface);
+  g_free(job);
+}
+
+// Fill the background and invoke the render func for `viewport`. This does
+// not touch the widget, so it may be called from any thread.
+static void run_render_closure(RenderClosure* closure,
+                               const GdkRGBA* bg_color,
+                               const GtkPanZoomViewport* viewport, cairo_t* cr,
+                               GCancellable* cancellable) {
+  cairo_save(cr);
+  cairo_set_source_rgba_gdk(cr, bg_color);
+  cairo_paint(cr);
+  gtk_panzoom_viewport_apply(viewport, cr);
+  cairo_set_line_width(cr, gtk_panzoom_viewport_get_pixel_size(viewport));
+  closure->func(viewport, cr, cancellable, closure->user_data);
+  cairo_restore(cr);
+}
+
+// Executed on a worker thread
+static void render_job_run(GTask* task, gpointer source_object,
+                           gpointer task_data, GCancellable* cancellable) {
+  RenderJob* job = task_data;
+  cairo_t* cr = cairo_create(job->surface);
+  run_render_closure(job->closure, &job->bg_color, &job->viewport, cr,
+                     cancellable);
+  cairo_destroy(cr);
+
+  if (g_task_return_error_if_cancelled(task)) {
+    return;
+  }
+  cairo_surface_flush(job->surface);
+  g_task_return_pointer(task, cairo_surface_reference(job->surface),
+                        (GDestroyNotify)cairo_surface_destroy);
+}
+
+// Executed on the main thread when a worker thread has finished a frame
+static void render_job_done(GObject* source_object, GAsyncResult* result,
+                            gpointer user_data) {
+  GtkPanZoomArea* this = GTK_PANZOOM_AREA(source_object);
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GTask* task = G_TASK(result);
+  GError* error = NULL;
+  cairo_surface_t* frame = g_task_propagate_pointer(task, &error);
+  if (!frame) {
+    // NOTE(josh): the only error is cancellation, which is expected
+    g_clear_error(&error);
+    return;
+  }
+  if (g_task_get_cancellable(task) != priv->render_cancellable) {
+    // A newer frame has been requested since this one was started
+    cairo_surface_destroy(frame);
+    return;
+  }
+
+  RenderJob* job = g_task_get_task_data(task);
+  if (priv->frame) {
+    cairo_surface_destroy(priv->frame);
+  }
+  priv->frame = frame;
+  priv->frame_viewport = job->viewport;
+  priv->frame_scale_factor = job->scale_factor;
+  priv->frame_stale = FALSE;
+  g_clear_object(&priv->render_cancellable);
+  gtk_widget_queue_draw(GTK_WIDGET(this));
+}
+
+// Cancel any frame in flight and start rendering `viewport` on a worker
+// thread.
+static void start_render_job(GtkPanZoomArea* this,
+                             const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  cancel_render_job(priv);
+
+  RenderJob* job = g_new0(RenderJob, 1);
+  job->closure = render_closure_ref(priv->render_closure);
+  job->viewport = *viewport;
+  job->scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(this));
+  job->bg_color = priv->bg_color;
+  job->surface =
+      create_offscreen_surface(this, viewport->width, viewport->height);
+
+  priv->render_cancellable = g_cancellable_new();
+  priv->pending_viewport = *viewport;
+  priv->pending_scale_factor = job->scale_factor;
+  GTask* task =
+      g_task_new(this, priv->render_cancellable, render_job_done, NULL);
+  g_task_set_task_data(task, job, render_job_free);
+  g_task_run_in_thread(task, render_job_run);
+  g_object_unref(task);
+}
+
+// Draw the scene (if any) over content which has already been rendered into
+// `cr`, e.g. a frame from the render func. This is always done on the main
+// thread since the application may modify the scene.
+static void render_scene_over(GtkPanZoomArea* this, cairo_t* cr,
+                              const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (!priv->scene) {
+    return;
+  }
+  cairo_save(cr);
+  gtk_panzoom_viewport_apply(viewport, cr);
+  cairo_set_line_width(cr, gtk_panzoom_viewport_get_pixel_size(viewport));
+  gtk_panzoom_scene_draw(priv->scene, cr, viewport);
+  cairo_restore(cr);
+}
+
+// Composite the last frame completed by a worker thread, scaled and
+// translated to the current viewport, and start a new frame if it is out of
+// date. The scene is drawn over it at the current viewport.
+static void render_viewport_async(GtkPanZoomArea* this, cairo_t* cr,
+                                  const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  // A frame rendered at another device scale is out of date even if the
+  // viewport is unchanged
+  gint scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(this));
+  gboolean current =
+      priv->frame && !priv->frame_stale &&
+      priv->frame_scale_factor == scale_factor &&
+      gtk_panzoom_viewport_equal(&priv->frame_viewport, viewport);
+  gboolean pending =
+      priv->render_cancellable &&
+      priv->pending_scale_factor == scale_factor &&
+      gtk_panzoom_viewport_equal(&priv->pending_viewport, viewport);
+  if (current) {
+    cancel_render_job(priv);
+  } else if (!pending) {
+    start_render_job(this, viewport);
+  }
+
+  cairo_save(cr);
+  cairo_rectangle(cr, 0, 0, viewport->width, viewport->height);
+  cairo_clip(cr);
+  if (!current) {
+    cairo_set_source_rgba_gdk(cr, &priv->bg_color);
+    cairo_paint(cr);
+  }
+  if (priv->frame) {
+    // Map pixels of the last frame to pixels of the current viewport
+    const GtkPanZoomViewport* prev = &priv->frame_viewport;
+    double pixel_size = gtk_panzoom_viewport_get_pixel_size(viewport);
+    double ratio = gtk_panzoom_viewport_get_pixel_size(prev) / pixel_size;
+    cairo_translate(cr, (prev->offset[0] - viewport->offset[0]) / pixel_size,
+                    viewport->height -
+                        (prev->offset[1] - viewport->offset[1]) / pixel_size -
+                        prev->height * ratio);
+    cairo_scale(cr, ratio, ratio);
+    cairo_set_source_surface(cr, priv->frame, 0, 0);
+    cairo_paint(cr);
+  }
+  cairo_restore(cr);
+  render_scene_over(this, cr, viewport);
+}
+
+// Invoke the draw callback of `layer` with `cr` transformed to the virtual
+// plane
+static void render_layer(GtkPanZoomArea* this, PanZoomLayer* layer,
+                         cairo_t* cr, const GtkPanZoomViewport* viewport) {
+  cairo_save(cr);
+  gtk_panzoom_viewport_apply(viewport, cr);
+  cairo_set_line_width(cr, gtk_panzoom_viewport_get_pixel_size(viewport));
+  layer->func(this, cr, viewport, layer->user_data);
+  cairo_restore(cr);
+}
+
+// Bring the surfaces of a cached layer up to date with `viewport`. As with
+// update_backing(), if the viewport has only been panned by a whole number of
+// pixels then the last rendering is shifted and only the newly exposed strips
+// are redrawn.
+static void update_layer_surface(GtkPanZoomArea* this, PanZoomLayer* layer,
+                                 const GtkPanZoomViewport* viewport) {
+  gint scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(this));
+  if (layer->surface[0] && (layer->scale_factor != scale_factor ||
+                            layer->viewport.width != viewport->width ||
+                            layer->viewport.height != viewport->height)) {
+    release_layer_surfaces(layer);
+  }
+
+  int delta[2] = {0, 0};
+  gboolean blit = layer->surface[0] && !layer->dirty &&
+                  get_blit_delta(&layer->viewport, viewport, delta);
+  if (blit && delta[0] == 0 && delta[1] == 0) {
+    return;
+  }
+
+  for (size_t idx = 0; idx < 2; idx++) {
+    if (!layer->surface[idx]) {
+      layer->surface[idx] =
+          create_offscreen_surface(this, viewport->width, viewport->height);
+    }
+  }
+
+  cairo_t* cr = cairo_create(layer->surface[1]);
+  if (blit) {
+    // NOTE(josh): the pixels not covered by the shifted surface are cleared
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, layer->surface[0], delta[0], delta[1]);
+    cairo_paint(cr);
+    add_exposed_strips(cr, viewport, delta);
+    cairo_clip(cr);
+  } else {
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+  }
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+  render_layer(this, layer, cr, viewport);
+  cairo_destroy(cr);
+
+  cairo_surface_t* swap = layer->surface[0];
+  layer->surface[0] = layer->surface[1];
+  layer->surface[1] = swap;
+  layer->viewport = *viewport;
+  layer->scale_factor = scale_factor;
+  layer->dirty = FALSE;
+}
+
+// Composite all visible layers, in order, on top of the area content.
+static void render_layers(GtkPanZoomArea* this, cairo_t* cr,
+                          const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  cairo_save(cr);
+  cairo_rectangle(cr, 0, 0, viewport->width, viewport->height);
+  cairo_clip(cr);
+  for (guint idx = 0; idx < priv->layers->len; idx++) {
+    PanZoomLayer* layer = g_ptr_array_index(priv->layers, idx);
+    if (!layer->visible) {
+      continue;
+    }
+    if (layer->cached) {
+      update_layer_surface(this, layer, viewport);
+      cairo_set_source_surface(cr, layer->surface[0], 0, 0);
+      cairo_paint(cr);
+    } else {
+      render_layer(this, layer, cr, viewport);
+    }
+  }
   cairo_restore(cr);
+}
+
+// Draw all visible layers directly into `cr`, bypassing their caches
+static void render_layers_uncached(GtkPanZoomArea* this, cairo_t* cr,
+                                   const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  if (!priv->layers) {
+    return;
+  }
+  for (guint idx = 0; idx < priv->layers->len; idx++) {
+    PanZoomLayer* layer = g_ptr_array_index(priv->layers, idx);
+    if (layer->visible) {
+      render_layer(this, layer, cr, viewport);
+    }
+  }
+}
+
+void gtk_panzoom_area_render_to_surface(GtkPanZoomArea* this,
+                                        cairo_surface_t* surface, int width,
+                                        int height,
+                                        const GtkPanZoomViewport* viewport) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GtkPanZoomViewport render_viewport;
+  if (viewport) {
+    render_viewport = *viewport;
+  } else {
+    gtk_panzoom_area_get_viewport(this, &render_viewport);
+  }
+  render_viewport.width = width;
+  render_viewport.height = height;
+
+  cairo_t* cr = cairo_create(surface);
+  cairo_rectangle(cr, 0, 0, width, height);
+  cairo_clip(cr);
+  if (priv->render_closure) {
+    // NOTE(josh): the render func is invoked synchronously
+    run_render_closure(priv->render_closure, &priv->bg_color,
+                       &render_viewport, cr, NULL);
+    render_scene_over(this, cr, &render_viewport);
+  } else {
+    // NOTE(josh): an export must not replace the recording which the widget
+    // replays, so area-draw is emitted directly unless the recording already
+    // covers this viewport.
+    render_background_and_content(this, cr, &render_viewport, FALSE);
+  }
+  render_layers_uncached(this, cr, &render_viewport);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+}
+
+// State shared by the tiles of an export
+typedef struct _ExportState {
+  GtkPanZoomArea* area;
+  GThreadPool* pool;  ///< renders tiles of a render func, or NULL
+  RenderClosure* closure;
+  GdkRGBA bg_color;
+  GMutex mutex;
+  GCond cond;
+  guint remaining;  ///< tiles of the current band still being rendered
+} ExportState;
+
+// Executed on a worker thread of the export pool
+static void export_tile_run(gpointer data, gpointer user_data) {
+  GtkPanZoomExportTile* tile = data;
+  ExportState* state = user_data;
+  cairo_t* cr = cairo_create(tile->surface);
+  run_render_closure(state->closure, &state->bg_color, &tile->viewport, cr,
+                     NULL);
+  cairo_destroy(cr);
+  cairo_surface_flush(tile->surface);
+
+  g_mutex_lock(&state->mutex);
+  state->remaining--;
+  g_cond_signal(&state->cond);
+  g_mutex_unlock(&state->mutex);
+}
+
+// Render the tiles of one band of an export
+static void export_band(GtkPanZoomExportTile* tiles, size_t ntiles,
+                        void* user_data) {
+  ExportState* state = user_data;
+  if (!state->pool) {
+    for (size_t idx = 0; idx < ntiles; idx++) {
+      gtk_panzoom_area_render_to_surface(
+          state->area, tiles[idx].surface, tiles[idx].viewport.width,
+          tiles[idx].viewport.height, &tiles[idx].viewport);
+    }
+    return;
+  }
+
+  state->remaining = ntiles;
+  for (size_t idx = 0; idx < ntiles; idx++) {
+    g_thread_pool_push(state->pool, &tiles[idx], NULL);
+  }
+  g_mutex_lock(&state->mutex);
+  while (state->remaining > 0) {
+    g_cond_wait(&state->cond, &state->mutex);
+  }
+  g_mutex_unlock(&state->mutex);
+  // The scene and layers are drawn on this thread
+  for (size_t idx = 0; idx < ntiles; idx++) {
+    cairo_t* cr = cairo_create(tiles[idx].surface);
+    render_scene_over(state->area, cr, &tiles[idx].viewport);
+    render_layers_uncached(state->area, cr, &tiles[idx].viewport);
+    cairo_destroy(cr);
+  }
+}
+
+gboolean gtk_panzoom_area_export_png(GtkPanZoomArea* this, const char* path,
+                                     const double rect[4], double pixel_size,
+                                     GError** error) {
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  ExportState state;
+  state.area = this;
+  state.pool = NULL;
+  state.closure = priv->render_closure;
+  state.bg_color = priv->bg_color;
+  g_mutex_init(&state.mutex);
+  g_cond_init(&state.cond);
+  state.remaining = 0;
+
+  // Content from a render func is thread-safe, so tiles are rendered by a
+  // pool of worker threads. Otherwise they are rendered here.
+  if (priv->render_closure) {
+    state.pool = g_thread_pool_new(export_tile_run, &state,
+                                   g_get_num_processors(), FALSE, NULL);
+  }
+
+  char* message = NULL;
+  gboolean ok = gtk_panzoom_png_export(path, rect, pixel_size, kExportTileSize,
+                                       export_band, &state, &message);
+  if (!ok) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", message);
+    free(message);
+  }
+
+  if (state.pool) {
+    g_thread_pool_free(state.pool, FALSE, TRUE);
+  }
+  g_mutex_clear(&state.mutex);
+  g_cond_clear(&state.cond);
+  return ok;
+}
+
+static gboolean gtk_panzoom_area_draw(GtkWidget* widget, cairo_t* cr) {
+  GtkPanZoomArea* this = GTK_PANZOOM_AREA(widget);
+  GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
+  GtkPanZoomViewport viewport;
+  gtk_panzoom_area_get_viewport(this, &viewport);
+  if (viewport.width < 1 || viewport.height < 1) {
+    render_viewport(this, cr, &viewport);
+    render_border(cr, &viewport);
+    return TRUE;
+  }
+
+  if (priv->render_closure) {
+    render_viewport_async(this, cr, &viewport);
+  } else if (priv->tile_cache_enabled) {
+    render_viewport_tiled(this, cr, &viewport);
+  } else if (priv->scroll_blit_enabled) {
+    render_viewport_blit(this, cr, &viewport);
+  } else {
+    render_viewport(this, cr, &viewport);
+  }
+  if (priv->layers && priv->layers->len > 0) {
+    render_layers(this, cr, &viewport);
+  }
+  render_border(cr, &viewport);
   return TRUE;
 }
 
@@ -697,6 +2257,17 @@ static void gtk_panzoom_area_destroy(GtkWidget* widget) {
   GtkPanZoomArea* this = GTK_PANZOOM_AREA(widget);
   GtkPanZoomAreaPrivate* priv = gtk_panzoom_area_get_instance_private(this);
 
+  cancel_render_job(priv);
+  discard_pending_view(this);
+  disconnect_view_adjustment(this, priv->offset_x);
+  disconnect_view_adjustment(this, priv->offset_y);
+  disconnect_view_adjustment(this, priv->scale);
+  // NOTE(josh): layer user data may refer to other widgets, so it is released
+  // here rather than in finalize.
+  if (priv->layers) {
+    g_ptr_array_unref(priv->layers);
+    priv->layers = NULL;
+  }
   g_object_unref(G_OBJECT(priv->offset_x));
   priv->offset_x = NULL;
   g_object_unref(G_OBJECT(priv->offset_y));
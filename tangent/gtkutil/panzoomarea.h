@@ -2,6 +2,10 @@
 // Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
 #include <gtk/gtk.h>
 
+#include "tangent/gtkutil/panzoomraster.h"
+#include "tangent/gtkutil/panzoomscene.h"
+#include "tangent/gtkutil/panzoomviewport.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,9 +28,12 @@ struct _GtkPanZoomAreaClass {
   gboolean (*area_button)(GtkPanZoomArea* area, GdkEventButton* event);
   /// default signal handler for draw event
   gboolean (*area_draw)(GtkPanZoomArea* area, cairo_t* cr);
+  /// default signal handler for draw event with viewport
+  gboolean (*area_draw_viewport)(GtkPanZoomArea* area, cairo_t* cr,
+                                 const GtkPanZoomViewport* viewport);
 
-  /// padding to add up to 4 new virtual functions without breaking API.
-  gpointer padding[4];
+  /// padding to add up to 3 new virtual functions without breaking API.
+  gpointer padding[3];
 };
 
 GtkWidget* gtk_panzoom_area_new();
@@ -64,6 +71,163 @@ void gtk_panzoom_area_set_demodraw(GtkPanZoomArea* area, gboolean enabled);
 void gtk_panzoom_area_set_background_color(GtkPanZoomArea* area,
                                            GdkRGBA* color);
 
+/// Map `n` points, stored as interleaved (x, y) pairs, from GTK coordinates
+/// to the virtual plane. This is equivalent to calling
+/// gtk_panzoom_area_transform_point() on each point, but the viewport is
+/// read only once. `in` and `out` may be the same buffer.
+void gtk_panzoom_area_transform_points(GtkPanZoomArea* area, const double* in,
+                                       double* out, size_t n);
+
+/// Map `n` points, stored as interleaved (x, y) pairs, from the virtual plane
+/// to GTK coordinates. `in` and `out` may be the same buffer.
+void gtk_panzoom_area_inverse_transform_points(GtkPanZoomArea* area,
+                                               const double* in, double* out,
+                                               size_t n);
+
+/// Return the length (in virtual units) of one device pixel. Handlers may use
+/// this to choose a level of detail.
+double gtk_panzoom_area_get_pixel_size(GtkPanZoomArea* area);
+
+/// Get the rectangle of the virtual plane which is currently visible, as
+/// (x_min, y_min, x_max, y_max). Handlers may use this to cull content.
+void gtk_panzoom_area_get_visible_rect(GtkPanZoomArea* area, double rect[4]);
+
+/// Fill `viewport` with a snapshot of the current offset, scale, and
+/// allocation of the area.
+void gtk_panzoom_area_get_viewport(GtkPanZoomArea* area,
+                                   GtkPanZoomViewport* viewport);
+
+/// Thread-safe draw callback. It is invoked on a worker thread with an
+/// immutable snapshot of the viewport and a context for an offscreen image
+/// surface which has already been filled with the background color and
+/// transformed such that drawing commands in the virtual plane map to pixels
+/// of the viewport. The callback must not touch any GTK objects. It should
+/// check `cancellable` periodically and return early if it is cancelled;
+/// the partial frame is then discarded.
+typedef void (*GtkPanZoomRenderFunc)(const GtkPanZoomViewport* viewport,
+                                     cairo_t* cr, GCancellable* cancellable,
+                                     gpointer user_data);
+
+/// Render the content on a worker thread using `func` instead of emitting
+/// area-draw on the main thread. While a frame is in flight, the last
+/// completed frame is shown, scaled and translated to the current viewport.
+/// When the viewport changes, the in-flight frame is cancelled and a new one
+/// is started. The scene, if any, is drawn over the frame on the main thread.
+/// Pass NULL for `func` to return to area-draw. `destroy` is called on
+/// `user_data` once no worker thread is using it anymore.
+void gtk_panzoom_area_set_render_func(GtkPanZoomArea* area,
+                                      GtkPanZoomRenderFunc func,
+                                      gpointer user_data,
+                                      GDestroyNotify destroy);
+
+/// Draw the primitives of `scene` which intersect the visible rectangle
+/// before emitting area-draw or, if a render func is set, over the frame it
+/// renders (on the main thread). The area does not take ownership of the scene,
+/// which must remain valid until it is replaced or the area is destroyed.
+/// Pass NULL to remove the scene. Call gtk_panzoom_area_invalidate_cache()
+/// after modifying the scene, or gtk_panzoom_area_invalidate_virtual_rect()
+/// with the bounds of the modified primitives.
+void gtk_panzoom_area_set_scene(GtkPanZoomArea* area, GtkPanZoomScene* scene);
+GtkPanZoomScene* gtk_panzoom_area_get_scene(GtkPanZoomArea* area);
+
+/// Return the id of the scene primitive nearest to (x, y), a point in the
+/// virtual plane such as the coordinates of an area-motion event, if it is
+/// within `tolerance_px` device pixels. Returns zero if there is no scene or
+/// no primitive within tolerance.
+GtkPanZoomSceneId gtk_panzoom_area_pick(GtkPanZoomArea* area, double x,
+                                        double y, double tolerance_px);
+
+/// Store the ids of all scene primitives within `tolerance_px` device pixels
+/// of (x, y) into `ids`, nearest first (see gtk_panzoom_scene_pick()).
+/// Returns the total number of primitives within tolerance.
+size_t gtk_panzoom_area_pick_all(GtkPanZoomArea* area, double x, double y,
+                                 double tolerance_px, GtkPanZoomSceneId* ids,
+                                 size_t capacity);
+
+/// Draw callback for a layer. It is invoked on the main thread with `cr`
+/// transformed such that drawing commands in the virtual plane map to pixels
+/// of `viewport`.
+typedef void (*GtkPanZoomLayerFunc)(GtkPanZoomArea* area, cairo_t* cr,
+                                    const GtkPanZoomViewport* viewport,
+                                    gpointer user_data);
+
+/// Add a layer which is drawn by `func` on top of the area content (scene,
+/// area-draw, or render func) and all previously added layers. If `cached`
+/// is true, the layer is rendered into its own surface which is re-used
+/// until the layer is invalidated or the viewport is zoomed or resized. When
+/// the viewport is panned by whole pixels, the surface is shifted and `func`
+/// only draws the newly exposed strips. If `cached` is false, `func` is
+/// called on every draw, which suits cheap overlays such as a cursor.
+/// Adding a layer does not change how the area content is drawn. Enable
+/// scroll-blit-enabled or tile-cache-enabled (or use a render func) to retain
+/// the content as well, so that invalidating a layer does not re-emit
+/// area-draw. `destroy` is called on `user_data` when the layer is
+/// removed or the area is destroyed. Returns the id of the layer, which is
+/// never zero.
+guint gtk_panzoom_area_add_layer(GtkPanZoomArea* area,
+                                 GtkPanZoomLayerFunc func, gpointer user_data,
+                                 GDestroyNotify destroy, gboolean cached);
+
+/// Remove a layer. Returns false if there is no layer with the given id.
+gboolean gtk_panzoom_area_remove_layer(GtkPanZoomArea* area, guint layer_id);
+
+/// Show or hide a layer without discarding its cached surface
+void gtk_panzoom_area_set_layer_visible(GtkPanZoomArea* area, guint layer_id,
+                                        gboolean visible);
+
+/// Mark a layer as changed and queue a redraw. Only that layer is redrawn;
+/// other cached layers are composited from their surfaces, and the area
+/// content is composited from its cache if it is retained (see
+/// gtk_panzoom_area_add_layer()).
+void gtk_panzoom_area_invalidate_layer(GtkPanZoomArea* area, guint layer_id);
+
+/// Add a cached layer which draws the tiles of `raster` at the level of the
+/// pyramid matching the current zoom. The area does not take ownership of
+/// the raster, which must remain valid until the layer is removed or the area
+/// is destroyed. Returns the id of the layer.
+guint gtk_panzoom_area_add_raster_layer(GtkPanZoomArea* area,
+                                        GtkPanZoomRaster* raster);
+
+/// Render the content of the area (background, scene, area-draw or render
+/// func, and layers) into `surface`, which is `width` x `height` pixels,
+/// without a window or display. The offset and scale are taken from
+/// `viewport` (whose width and height are ignored) or, if it is NULL, from
+/// the area. The scale still spans the larger of `width` and `height`, so
+/// the same view may be rendered at any resolution. No caches are updated
+/// (the recording of area-draw is replayed only if it already covers the
+/// view), and the area need not be realized.
+void gtk_panzoom_area_render_to_surface(GtkPanZoomArea* area,
+                                        cairo_surface_t* surface, int width,
+                                        int height,
+                                        const GtkPanZoomViewport* viewport);
+
+/// Render the virtual rectangle `rect` (x_min, y_min, x_max, y_max) at
+/// `pixel_size` virtual units per pixel to a PNG file at `path`, e.g. for a
+/// poster-sized print. The image is rendered in tiles through the same path
+/// as gtk_panzoom_area_render_to_surface() and encoded one band of rows at a
+/// time, so the whole image is never held in memory. If a render func is set
+/// then the tiles of each band are rendered concurrently on worker threads,
+/// and the scene and layers are drawn over them on the calling thread.
+/// Returns FALSE and sets `error` on failure.
+gboolean gtk_panzoom_area_export_png(GtkPanZoomArea* area, const char* path,
+                                     const double rect[4], double pixel_size,
+                                     GError** error);
+
+/// Discard any cached renderings of the area-draw content (e.g. the tile
+/// cache) and queue a redraw. Call this whenever the content changes.
+void gtk_panzoom_area_invalidate_cache(GtkPanZoomArea* area);
+
+/// Notify the area that the content within the virtual rectangle with
+/// corners (x0, y0) and (x1, y1) has changed. Only the cached tiles and
+/// retained pixels which cover the rectangle (plus a margin of one pixel for
+/// antialiasing) are discarded, and only the device rectangle which covers it
+/// is queued for redraw. Draw handlers may query the damaged region with
+/// gtk_panzoom_viewport_get_clip_rect(). A frame rendered by a render func
+/// is always replaced as a whole.
+void gtk_panzoom_area_invalidate_virtual_rect(GtkPanZoomArea* area, double x0,
+                                              double y0, double x1,
+                                              double y1);
+
 G_END_DECLS
 
 #ifdef __cplusplus
@@ -0,0 +1,184 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <cstdio>
+
+#include <gtest/gtest.h>
+#include <gtk/gtk.h>
+
+#include "tangent/gtkutil/panzoomarea.h"
+
+namespace {
+
+// Return false if there is no display on which to realize widgets, in which
+// case the calling test does nothing.
+bool init_gtk() {
+  static bool initialized = gtk_init_check(nullptr, nullptr);
+  if (!initialized) {
+    fprintf(stderr, "No display, skipping\n");
+  }
+  return initialized;
+}
+
+// Tick callback which counts down the frames remaining in run_frames()
+gboolean count_frame(GtkWidget* widget, GdkFrameClock* frame_clock,
+                     gpointer user_data) {
+  int* nframes = static_cast<int*>(user_data);
+  (*nframes)--;
+  return *nframes > 0 ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+gboolean set_timed_out(gpointer user_data) {
+  *static_cast<bool*>(user_data) = true;
+  return G_SOURCE_REMOVE;
+}
+
+// Iterate the main loop until `nframes` frames of the frame clock of `widget`
+// have been processed, or for at most two seconds.
+void run_frames(GtkWidget* widget, int nframes) {
+  bool timed_out = false;
+  guint timeout_id = g_timeout_add(2000, set_timed_out, &timed_out);
+  gtk_widget_add_tick_callback(widget, count_frame, &nframes, nullptr);
+  while (nframes > 0 && !timed_out) {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+  if (!timed_out) {
+    g_source_remove(timeout_id);
+  }
+  ASSERT_EQ(nframes, 0) << "timed out waiting for frames";
+}
+
+// Show an area of 200 x 100 pixels in a new toplevel window, and wait for it
+// to be drawn
+GtkWidget* show_area(GtkWidget** window) {
+  *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  GtkWidget* area = gtk_panzoom_area_new();
+  gtk_widget_set_size_request(area, 200, 100);
+  gtk_container_add(GTK_CONTAINER(*window), area);
+  gtk_widget_show_all(*window);
+  run_frames(area, 2);
+  return area;
+}
+
+// Deliver `event`, which targets the window of `area`, and free it
+void send_event(GtkWidget* area, GdkEvent* event) {
+  event->any.window =
+      static_cast<GdkWindow*>(g_object_ref(gtk_widget_get_window(area)));
+  GdkSeat* seat = gdk_display_get_default_seat(gdk_display_get_default());
+  gdk_event_set_device(event, gdk_seat_get_pointer(seat));
+  gtk_widget_event(area, event);
+  gdk_event_free(event);
+}
+
+void send_scroll(GtkWidget* area, GdkScrollDirection direction, double x,
+                 double y) {
+  GdkEvent* event = gdk_event_new(GDK_SCROLL);
+  event->scroll.direction = direction;
+  event->scroll.x = x;
+  event->scroll.y = y;
+  send_event(area, event);
+}
+
+void send_motion(GtkWidget* area, double x, double y) {
+  GdkEvent* event = gdk_event_new(GDK_MOTION_NOTIFY);
+  event->motion.x = x;
+  event->motion.y = y;
+  send_event(area, event);
+}
+
+void send_leave(GtkWidget* area) {
+  GdkEvent* event = gdk_event_new(GDK_LEAVE_NOTIFY);
+  event->crossing.mode = GDK_CROSSING_NORMAL;
+  event->crossing.detail = GDK_NOTIFY_ANCESTOR;
+  event->crossing.x = -1;
+  event->crossing.y = -1;
+  send_event(area, event);
+}
+
+void on_area_hover(GtkPanZoomArea* area, guint64 id, gpointer user_data) {
+  *static_cast<GtkPanZoomSceneId*>(user_data) = id;
+}
+
+}  // namespace
+
+TEST(PanZoomArea, SetViewReplacesQueuedInput) {
+  if (!init_gtk()) {
+    return;
+  }
+  GtkWidget* window = nullptr;
+  GtkWidget* widget = show_area(&window);
+  GtkPanZoomArea* area = GTK_PANZOOM_AREA(widget);
+
+  // Input is coalesced and applied at the next frame
+  send_scroll(widget, GDK_SCROLL_UP, 50, 50);
+  EXPECT_EQ(gtk_panzoom_area_get_scale(area), 1.0);
+  run_frames(widget, 2);
+  EXPECT_EQ(gtk_panzoom_area_get_scale(area), 2.0);
+
+  // An offset set after a queued scroll is kept, and the scroll is dropped
+  send_scroll(widget, GDK_SCROLL_UP, 50, 50);
+  double offset[2] = {5.0, 7.0};
+  gtk_panzoom_area_set_offset(area, offset);
+  run_frames(widget, 2);
+  double actual[2] = {0, 0};
+  gtk_panzoom_area_get_offset(area, actual);
+  EXPECT_EQ(actual[0], 5.0);
+  EXPECT_EQ(actual[1], 7.0);
+  EXPECT_EQ(gtk_panzoom_area_get_scale(area), 2.0);
+
+  // As is a value set on the adjustment by the application, or a value which
+  // is unchanged
+  send_scroll(widget, GDK_SCROLL_DOWN, 50, 50);
+  GtkAdjustment* scale = nullptr;
+  g_object_get(widget, "scale-adjustment", &scale, nullptr);
+  gtk_adjustment_set_value(scale, 3.0);
+  g_object_unref(scale);
+  send_scroll(widget, GDK_SCROLL_DOWN, 50, 50);
+  gtk_panzoom_area_set_offset(area, offset);
+  run_frames(widget, 2);
+  gtk_panzoom_area_get_offset(area, actual);
+  EXPECT_EQ(actual[0], 5.0);
+  EXPECT_EQ(actual[1], 7.0);
+  EXPECT_EQ(gtk_panzoom_area_get_scale(area), 3.0);
+
+  gtk_widget_destroy(window);
+}
+
+TEST(PanZoomArea, HoverFollowsViewAndPointer) {
+  if (!init_gtk()) {
+    return;
+  }
+  GtkWidget* window = nullptr;
+  GtkWidget* widget = show_area(&window);
+  GtkPanZoomArea* area = GTK_PANZOOM_AREA(widget);
+  GtkPanZoomSceneId hover_id = 0;
+  g_signal_connect(widget, "area-hover", G_CALLBACK(on_area_hover), &hover_id);
+
+  // One virtual unit spans 200 pixels, so the point is at pixel (50, 50)
+  GtkPanZoomScene* scene = gtk_panzoom_scene_new();
+  GtkPanZoomSceneId point = gtk_panzoom_scene_add_point(scene, 0, 0.25, 0.25);
+  gtk_panzoom_area_set_scene(area, scene);
+  EXPECT_EQ(hover_id, 0u);
+  send_motion(widget, 50, 50);
+  EXPECT_EQ(hover_id, point);
+
+  // The view moves under a stationary pointer
+  double offset[2] = {0.1, 0.0};
+  gtk_panzoom_area_set_offset(area, offset);
+  EXPECT_EQ(hover_id, 0u);
+  offset[0] = 0.0;
+  gtk_panzoom_area_set_offset(area, offset);
+  EXPECT_EQ(hover_id, point);
+
+  // Zooming out about (60, 50) moves the point to (55, 50), away from the
+  // pointer, once the zoom is applied
+  send_scroll(widget, GDK_SCROLL_UP, 60, 50);
+  EXPECT_EQ(hover_id, point);
+  run_frames(widget, 2);
+  EXPECT_EQ(gtk_panzoom_area_get_scale(area), 2.0);
+  EXPECT_EQ(hover_id, 0u);
+
+  send_leave(widget);
+  EXPECT_EQ(hover_id, 0u);
+
+  gtk_widget_destroy(window);
+  gtk_panzoom_scene_free(scene);
+}
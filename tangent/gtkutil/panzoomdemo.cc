@@ -30,6 +30,8 @@ struct ProgramOpts {
   bool draw_with_signal;
   bool use_gtkapplication;
   double threshold;
+  int width;
+  int height;
 };
 
 // Context for automatic mode.
@@ -207,6 +209,116 @@ gboolean main_window_draw(GtkWidget* widget, cairo_t* ignored,
   return FALSE;
 }
 
+/// Render only the pan-zoom area, without realizing the main window, and
+/// write it to `opts.outfile_path`. Returns the exit code for the program.
+int write_thumbnail(GtkPanZoomArea* panzoom, const ProgramOpts& opts) {
+  const std::string& outpath = opts.outfile_path;
+  cairo_surface_t* cairo_surf = nullptr;
+  if (endswith(outpath, ".svg")) {
+    cairo_surf =
+        cairo_svg_surface_create(outpath.c_str(), opts.width, opts.height);
+  } else if (endswith(outpath, ".png")) {
+    cairo_surf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, opts.width,
+                                            opts.height);
+  } else {
+    fmt::print(stderr, "WARNING: Unrecognized file extension: {}\n", outpath);
+    return 1;
+  }
+
+  gtk_panzoom_area_render_to_surface(panzoom, cairo_surf, opts.width,
+                                     opts.height, nullptr);
+
+  int exitcode = 0;
+  if (endswith(outpath, ".png")) {
+    cairo_status_t status =
+        cairo_surface_write_to_png(cairo_surf, outpath.c_str());
+    if (status != CAIRO_STATUS_SUCCESS) {
+      fmt::print(stderr, "WARNING: Failed to write to: {}\n", outpath);
+      exitcode = 2;
+    }
+  }
+  cairo_surface_destroy(cairo_surf);
+  return exitcode;
+}
+
+/// If an input file is given, read the initial state of the models in
+/// `builder` from it. Exits on failure.
+void load_input(const ProgramOpts& opts, GtkBuilder* builder) {
+  if (opts.input_filepath.empty()) {
+    return;
+  }
+
+  std::istream* infile = nullptr;
+  std::ifstream infile_stream;
+  if (opts.input_filepath == "-") {
+    infile = &std::cin;
+  } else {
+    struct stat statbuf {};
+    int err = stat(opts.input_filepath.c_str(), &statbuf);
+    if (err) {
+      fmt::print(stderr, "ERROR: Can't status iput file {}\n",
+                 opts.input_filepath);
+      exit(1);
+    }
+    infile_stream.open(opts.input_filepath);
+    infile = &infile_stream;
+  }
+
+  std::string content;
+  content.reserve(1024 * 1024);
+  content.assign((std::istreambuf_iterator<char>(*infile)),
+                 std::istreambuf_iterator<char>());
+  deserialize_models(content, builder);
+}
+
+/// Draw the demo content in `panzoom`, either from the signal handler of
+/// the demo or from the handler embedded in the widget
+void setup_drawing(GtkWidget* panzoom, const ProgramOpts& opts) {
+  if (opts.draw_with_signal) {
+    g_object_connect(G_OBJECT(panzoom), "signal::area-draw",
+                     G_CALLBACK(sig_draw), NULL);
+  } else {
+    g_object_set(G_OBJECT(panzoom), "demo-draw-enabled", TRUE, NULL);
+  }
+}
+
+/// Render only the pan-zoom area to the output file. Only the adjustments
+/// are loaded from the user-interface file and no window is created, so this
+/// works without a display.
+int run_thumbnail(const ProgramOpts& opts) {
+  GtkBuilder* builder = gtk_builder_new();
+  const char* adjustment_ids[] = {"offset_x_adjustment", "offset_y_adjustment",
+                                  "scale_adjustment", "scale_rate_adjustment",
+                                  nullptr};
+  GError* error = nullptr;
+  if (!gtk_builder_add_objects_from_file(
+          builder, opts.glade_filepath.c_str(),
+          const_cast<gchar**>(adjustment_ids), &error)) {
+    fmt::print(stderr, "ERROR: Failed to load adjustments from {}: {}\n",
+               opts.glade_filepath, error->message);
+    g_error_free(error);
+    return 1;
+  }
+  load_input(opts, builder);
+
+  GtkWidget* panzoom = gtk_panzoom_area_new();
+  g_object_ref_sink(panzoom);
+  g_object_set(G_OBJECT(panzoom), "offset-x-adjustment",
+               gtk_builder_get_object(builder, "offset_x_adjustment"),
+               "offset-y-adjustment",
+               gtk_builder_get_object(builder, "offset_y_adjustment"),
+               "scale-adjustment",
+               gtk_builder_get_object(builder, "scale_adjustment"),
+               "scale-rate-adjustment",
+               gtk_builder_get_object(builder, "scale_rate_adjustment"), NULL);
+  setup_drawing(panzoom, opts);
+
+  int exitcode = write_thumbnail(GTK_PANZOOM_AREA(panzoom), opts);
+  g_object_unref(panzoom);
+  g_object_unref(builder);
+  return exitcode;
+}
+
 /// Configure the command line parser
 void setup_parser(argue::Parser* parser, ProgramOpts* opts) {
   using argue::keywords::action;
@@ -247,6 +359,24 @@ void setup_parser(argue::Parser* parser, ProgramOpts* opts) {
     help="Path to the image file to write. Valid extensions are .png or "
          ".svg.");
 
+  auto thumbnail_parser = subparsers->add_parser(
+      "thumbnail", {.help = "Render only the pan-zoom area to an image file, "
+                            "without creating a window. Does not require a "
+                            "display."});
+
+  thumbnail_parser->add_argument(
+    "outfile", dest=&opts->outfile_path,
+    help="Path to the image file to write. Valid extensions are .png or "
+         ".svg.");
+
+  thumbnail_parser->add_argument(
+      "--width", dest=&opts->width, default_=800,
+      help="Width of the image in pixels");
+
+  thumbnail_parser->add_argument(
+      "--height", dest=&opts->height, default_=600,
+      help="Height of the image in pixels");
+
   auto hash_parser = subparsers->add_parser(
       "hash", {.help = "Render the main window to an image file and compute "
                        "the perceptual hash of it ."});
@@ -285,7 +415,9 @@ int main(int argc, char** argv) {
   ProgramOpts opts{};
   setup_parser(&parser, &opts);
 
-  gtk_init(&argc, &argv);
+  // NOTE(josh): the thumbnail is rendered without a window, so a missing
+  // display is only an error for the other commands
+  gboolean have_display = gtk_init_check(&argc, &argv);
   int parse_result = parser.parse_args(argc, argv);
   switch (parse_result) {
     case argue::PARSE_ABORTED:
@@ -296,6 +428,14 @@ int main(int argc, char** argv) {
       break;
   }
 
+  if (opts.command == "thumbnail") {
+    exit(run_thumbnail(opts));
+  }
+  if (!have_display) {
+    fmt::print(stderr, "ERROR: Cannot open display\n");
+    exit(1);
+  }
+
   GtkWidget* panzoom = gtk_panzoom_area_new();
   GtkBuilder* builder = gtk_builder_new_from_file(opts.glade_filepath.c_str());
   if (!builder) {
@@ -304,29 +444,7 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
-  if (!opts.input_filepath.empty()) {
-    std::istream* infile = nullptr;
-    std::ifstream infile_stream;
-    if (opts.input_filepath == "-") {
-      infile = &std::cin;
-    } else {
-      struct stat statbuf {};
-      int err = stat(opts.input_filepath.c_str(), &statbuf);
-      if (err) {
-        fmt::print(stderr, "ERROR: Can't status iput file {}\n",
-                   opts.input_filepath);
-        exit(1);
-      }
-      infile_stream.open(opts.input_filepath);
-      infile = &infile_stream;
-    }
-
-    std::string content;
-    content.reserve(1024 * 1024);
-    content.assign((std::istreambuf_iterator<char>(*infile)),
-                   std::istreambuf_iterator<char>());
-    deserialize_models(content, builder);
-  }
+  load_input(opts, builder);
 
   GObject* main_window_obj = gtk_builder_get_object(builder, "main");
   if (!main_window_obj) {
@@ -358,12 +476,7 @@ int main(int argc, char** argv) {
                  NULL);
   }
 
-  if (opts.draw_with_signal) {
-    g_object_connect(G_OBJECT(panzoom), "signal::area-draw",
-                     G_CALLBACK(sig_draw), NULL);
-  } else {
-    g_object_set(G_OBJECT(panzoom), "demo-draw-enabled", TRUE, NULL);
-  }
+  setup_drawing(panzoom, opts);
 
   AutoContext context{};
   context.opts = &opts;
@@ -0,0 +1,656 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/gtkutil/panzoomraster.h"
+
+#include <fcntl.h>
+#include <png.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tangent/gtkutil/tilecache.h"
+
+namespace {
+
+const char kMagic[8] = {'P', 'Z', 'R', 'A', 'S', 'T', 'E', 'R'};
+const uint32_t kVersion = 1;
+
+/// Level data starts on a page boundary so that tiles of different levels
+/// never share a page
+const uint64_t kLevelAlignment = 4096;
+
+// NOTE(josh): All fields are stored in native byte order, like the pixels,
+// so a pyramid is only readable on a machine of the same endianness as the
+// one which built it.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t tile_size;  ///< edge length of a tile, in pixels
+  uint64_t width;      ///< width of level zero, in pixels
+  uint64_t height;     ///< height of level zero, in pixels
+  uint32_t nlevels;    ///< number of level headers which follow
+  uint32_t reserved;
+};
+
+struct LevelHeader {
+  uint64_t width;   ///< width of the level, in pixels
+  uint64_t height;  ///< height of the level, in pixels
+  uint64_t offset;  ///< offset of the first tile from the start of the file
+};
+
+// Geometry of one level of the pyramid
+struct Level {
+  uint64_t width;
+  uint64_t height;
+  uint64_t ntiles_x;
+  uint64_t ntiles_y;
+  uint64_t offset;
+};
+
+uint64_t divide_up(uint64_t num, uint64_t den) {
+  return num / den + (num % den != 0);
+}
+
+// Store a * b in `out` and return true, or return false if it overflows
+bool checked_multiply(uint64_t a, uint64_t b, uint64_t* out) {
+  if (b != 0 && a > UINT64_MAX / b) {
+    return false;
+  }
+  *out = a * b;
+  return true;
+}
+
+// Store a + b in `out` and return true, or return false if it overflows
+bool checked_add(uint64_t a, uint64_t b, uint64_t* out) {
+  if (a > UINT64_MAX - b) {
+    return false;
+  }
+  *out = a + b;
+  return true;
+}
+
+// Compute the geometry of every level of a pyramid, along with the total
+// size of the file. Returns false if the size of the file does not fit in 64
+// bits.
+bool layout_levels(uint64_t width, uint64_t height, uint32_t tile_size,
+                   std::vector<Level>* levels, uint64_t* file_size) {
+  levels->clear();
+  while (true) {
+    levels->push_back(Level{width, height, divide_up(width, tile_size),
+                            divide_up(height, tile_size), 0});
+    if (width <= tile_size && height <= tile_size) {
+      break;
+    }
+    width = divide_up(width, 2);
+    height = divide_up(height, 2);
+  }
+
+  uint64_t tile_bytes = 4ULL * tile_size * tile_size;
+  uint64_t offset = sizeof(FileHeader) + levels->size() * sizeof(LevelHeader);
+  for (Level& level : *levels) {
+    uint64_t ntiles = 0;
+    uint64_t level_bytes = 0;
+    if (!checked_multiply(divide_up(offset, kLevelAlignment), kLevelAlignment,
+                          &offset) ||
+        !checked_multiply(level.ntiles_x, level.ntiles_y, &ntiles) ||
+        !checked_multiply(ntiles, tile_bytes, &level_bytes)) {
+      return false;
+    }
+    level.offset = offset;
+    if (!checked_add(offset, level_bytes, &offset)) {
+      return false;
+    }
+  }
+  *file_size = offset;
+  return true;
+}
+
+// Store a copy of `message` in `error`, if it is not NULL, for the caller to
+// free()
+void set_error(char** error, const std::string& message) {
+  if (!error) {
+    return;
+  }
+  *error = static_cast<char*>(malloc(message.size() + 1));
+  memcpy(*error, message.c_str(), message.size() + 1);
+}
+
+std::string describe_errno(const std::string& what, const char* path) {
+  return what + " " + path + ": " + strerror(errno);
+}
+
+// A memory mapping of an entire file
+struct Mapping {
+  ~Mapping() {
+    if (data != MAP_FAILED) {
+      munmap(data, size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  int fd = -1;
+  void* data = MAP_FAILED;
+  size_t size = 0;
+};
+
+// Pack straight alpha RGBA bytes into a premultiplied ARGB32 pixel
+uint32_t premultiply(const uint8_t* rgba) {
+  uint32_t alpha = rgba[3];
+  uint32_t pixel = alpha << 24;
+  for (int channel = 0; channel < 3; channel++) {
+    uint32_t value = (rgba[channel] * alpha + 127) / 255;
+    pixel |= value << (8 * (2 - channel));
+  }
+  return pixel;
+}
+
+// Return the average of four premultiplied ARGB32 pixels
+uint32_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  uint32_t pixel = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) +
+                   ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+    pixel |= ((sum + 2) / 4) << shift;
+  }
+  return pixel;
+}
+
+// Streams the rows of a PNG file as straight alpha RGBA bytes
+struct PngReader {
+  ~PngReader() {
+    if (png) {
+      png_destroy_read_struct(&png, info ? &info : nullptr, nullptr);
+    }
+    if (file) {
+      fclose(file);
+    }
+  }
+
+  static void on_error(png_structp png, png_const_charp message) {
+    PngReader* reader = static_cast<PngReader*>(png_get_error_ptr(png));
+    reader->error = std::string("libpng: ") + message;
+    longjmp(png_jmpbuf(png), 1);
+  }
+
+  static void on_warning(png_structp png, png_const_charp message) {}
+
+  // NOTE(josh): No objects with destructors may be constructed between the
+  // setjmp() and the libpng calls which may longjmp() to it.
+  bool open(const char* path) {
+    file = fopen(path, "rb");
+    if (!file) {
+      error = describe_errno("Failed to open", path);
+      return false;
+    }
+    png = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, on_error,
+                                 on_warning);
+    if (png) {
+      info = png_create_info_struct(png);
+    }
+    if (!info) {
+      error = "Failed to initialize libpng";
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+      return false;
+    }
+    png_set_user_limits(png, PNG_UINT_31_MAX, PNG_UINT_31_MAX);
+    png_init_io(png, file);
+    png_read_info(png, info);
+    if (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE) {
+      error = "Interlaced images can't be read one row at a time";
+      return false;
+    }
+    png_byte color_type = png_get_color_type(png, info);
+    png_set_expand(png);
+    png_set_strip_16(png);
+    if (color_type == PNG_COLOR_TYPE_GRAY ||
+        color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+      png_set_gray_to_rgb(png);
+    }
+    if (!(color_type & PNG_COLOR_MASK_ALPHA) &&
+        !png_get_valid(png, info, PNG_INFO_tRNS)) {
+      png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+    }
+    png_read_update_info(png, info);
+    width = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    return true;
+  }
+
+  bool read_row(uint8_t* rgba) {
+    if (setjmp(png_jmpbuf(png))) {
+      return false;
+    }
+    png_read_row(png, rgba, nullptr);
+    return true;
+  }
+
+  FILE* file = nullptr;
+  png_structp png = nullptr;
+  png_infop info = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::string error;
+};
+
+// Writes the levels of a pyramid into a mapping of the output file
+struct Builder {
+  uint32_t* get_tile(size_t level_idx, uint64_t tile_x, uint64_t tile_y) {
+    const Level& level = levels[level_idx];
+    uint64_t tile_bytes = 4ULL * tile_size * tile_size;
+    uint8_t* base = static_cast<uint8_t*>(out.data) + level.offset;
+    return reinterpret_cast<uint32_t*>(
+        base + (tile_y * level.ntiles_x + tile_x) * tile_bytes);
+  }
+
+  // Decode the source one band of tile rows at a time and scatter each band
+  // into the tiles of level zero. Pixels beyond the edge of the image are
+  // left as the zeros of the freshly truncated file, i.e. transparent.
+  bool write_base(PngReader* reader) {
+    const Level& level = levels[0];
+    std::vector<uint8_t> rgba(4 * static_cast<size_t>(level.width));
+    std::vector<uint32_t> band(static_cast<size_t>(level.width) * tile_size);
+    for (uint64_t tile_y = 0; tile_y < level.ntiles_y; tile_y++) {
+      uint64_t nrows =
+          std::min<uint64_t>(tile_size, level.height - tile_y * tile_size);
+      for (uint64_t row = 0; row < nrows; row++) {
+        if (!reader->read_row(rgba.data())) {
+          error = reader->error;
+          return false;
+        }
+        uint32_t* out_row = &band[row * level.width];
+        for (uint64_t col = 0; col < level.width; col++) {
+          out_row[col] = premultiply(&rgba[4 * col]);
+        }
+      }
+      for (uint64_t tile_x = 0; tile_x < level.ntiles_x; tile_x++) {
+        uint64_t col_begin = tile_x * tile_size;
+        uint64_t ncols = std::min<uint64_t>(tile_size, level.width - col_begin);
+        uint32_t* tile = get_tile(0, tile_x, tile_y);
+        for (uint64_t row = 0; row < nrows; row++) {
+          memcpy(tile + row * tile_size, &band[row * level.width + col_begin],
+                 4 * ncols);
+        }
+      }
+    }
+    return true;
+  }
+
+  // Compute each pixel of a level as the average of the 2x2 block of pixels
+  // of the previous level which it covers. The edge pixels of an odd sized
+  // level are repeated rather than averaged with the transparent padding.
+  void write_reduced(size_t level_idx) {
+    const Level& level = levels[level_idx];
+    const Level& prev = levels[level_idx - 1];
+    for (uint64_t tile_y = 0; tile_y < level.ntiles_y; tile_y++) {
+      for (uint64_t tile_x = 0; tile_x < level.ntiles_x; tile_x++) {
+        uint32_t* tile = get_tile(level_idx, tile_x, tile_y);
+        uint64_t nrows =
+            std::min<uint64_t>(tile_size, level.height - tile_y * tile_size);
+        uint64_t ncols =
+            std::min<uint64_t>(tile_size, level.width - tile_x * tile_size);
+        for (uint64_t row = 0; row < nrows; row++) {
+          // NOTE(josh): tile_size is even, so the two source rows (and the
+          // two source columns) of each pixel are always in the same tile
+          uint64_t src_y0 = 2 * (tile_y * tile_size + row);
+          uint64_t src_y1 = std::min(src_y0 + 1, prev.height - 1);
+          uint64_t src_tile_y = src_y0 / tile_size;
+          uint32_t* out_row = tile + row * tile_size;
+          for (uint64_t col = 0; col < ncols; col++) {
+            uint64_t src_x0 = 2 * (tile_x * tile_size + col);
+            uint64_t src_x1 = std::min(src_x0 + 1, prev.width - 1);
+            const uint32_t* src =
+                get_tile(level_idx - 1, src_x0 / tile_size, src_tile_y);
+            const uint32_t* row0 = src + (src_y0 % tile_size) * tile_size;
+            const uint32_t* row1 = src + (src_y1 % tile_size) * tile_size;
+            out_row[col] =
+                average(row0[src_x0 % tile_size], row0[src_x1 % tile_size],
+                        row1[src_x0 % tile_size], row1[src_x1 % tile_size]);
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t tile_size;
+  std::vector<Level> levels;
+  Mapping out;
+  std::string error;
+};
+
+}  // namespace
+
+struct _GtkPanZoomRaster {
+  // Return a new reference to the decoded surface of a tile, or NULL if the
+  // surface can't be allocated
+  cairo_surface_t* get_tile(uint32_t level_idx, uint64_t tile_x,
+                            uint64_t tile_y) {
+    cairo_surface_t* surface =
+        gtk_panzoom_tile_cache_lookup(cache, level_idx, tile_x, tile_y);
+    if (surface) {
+      return surface;
+    }
+    surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, tile_size, tile_size);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+      cairo_surface_destroy(surface);
+      return nullptr;
+    }
+    const Level& level = levels[level_idx];
+    size_t row_bytes = 4 * static_cast<size_t>(tile_size);
+    const uint8_t* src = static_cast<const uint8_t*>(map.data) +
+                         level.offset +
+                         (tile_y * level.ntiles_x + tile_x) * row_bytes *
+                             tile_size;
+    cairo_surface_flush(surface);
+    uint8_t* dst = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    for (uint32_t row = 0; row < tile_size; row++) {
+      memcpy(dst + static_cast<size_t>(row) * stride, src + row * row_bytes,
+             row_bytes);
+    }
+    cairo_surface_mark_dirty(surface);
+    gtk_panzoom_tile_cache_insert(cache, level_idx, tile_x, tile_y, surface);
+    return surface;
+  }
+
+  Mapping map;
+  uint32_t tile_size;
+  uint64_t width;
+  uint64_t height;
+  std::vector<Level> levels;
+  double origin[2];   ///< virtual coordinates of the bottom left corner
+  double pixel_size;  ///< virtual size of a pixel of level zero
+  GtkPanZoomTileCache* cache;
+};
+
+int gtk_panzoom_raster_build(const char* png_path, const char* out_path,
+                             uint32_t tile_size, char** error) {
+  if (tile_size < 2 || tile_size % 2 || tile_size > 8192) {
+    set_error(error, "Tile size must be even and within [2, 8192], got " +
+                         std::to_string(tile_size));
+    return 0;
+  }
+  PngReader reader;
+  if (!reader.open(png_path)) {
+    set_error(error, reader.error);
+    return 0;
+  }
+
+  Builder builder;
+  builder.tile_size = tile_size;
+  uint64_t file_size = 0;
+  if (!layout_levels(reader.width, reader.height, tile_size, &builder.levels,
+                     &file_size)) {
+    set_error(error, std::string(png_path) + " is too large to tile");
+    return 0;
+  }
+
+  Mapping& out = builder.out;
+  out.fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (out.fd < 0) {
+    set_error(error, describe_errno("Failed to create", out_path));
+    return 0;
+  }
+  if (ftruncate(out.fd, file_size) != 0) {
+    set_error(error, describe_errno("Failed to resize", out_path));
+    unlink(out_path);
+    return 0;
+  }
+  out.size = file_size;
+  out.data =
+      mmap(nullptr, out.size, PROT_READ | PROT_WRITE, MAP_SHARED, out.fd, 0);
+  if (out.data == MAP_FAILED) {
+    set_error(error, describe_errno("Failed to map", out_path));
+    unlink(out_path);
+    return 0;
+  }
+
+  FileHeader* header = static_cast<FileHeader*>(out.data);
+  memcpy(header->magic, kMagic, sizeof(kMagic));
+  header->version = kVersion;
+  header->tile_size = tile_size;
+  header->width = reader.width;
+  header->height = reader.height;
+  header->nlevels = static_cast<uint32_t>(builder.levels.size());
+  LevelHeader* level_headers = reinterpret_cast<LevelHeader*>(header + 1);
+  for (size_t idx = 0; idx < builder.levels.size(); idx++) {
+    const Level& level = builder.levels[idx];
+    level_headers[idx] = LevelHeader{level.width, level.height, level.offset};
+  }
+
+  if (!builder.write_base(&reader)) {
+    set_error(error, builder.error);
+    unlink(out_path);
+    return 0;
+  }
+  for (size_t idx = 1; idx < builder.levels.size(); idx++) {
+    builder.write_reduced(idx);
+  }
+  if (msync(out.data, out.size, MS_SYNC) != 0) {
+    set_error(error, describe_errno("Failed to write", out_path));
+    unlink(out_path);
+    return 0;
+  }
+  return 1;
+}
+
+GtkPanZoomRaster* gtk_panzoom_raster_open(const char* path, char** error) {
+  GtkPanZoomRaster* raster = new GtkPanZoomRaster{};
+  Mapping& map = raster->map;
+  std::string message;
+
+  struct stat info {};
+  map.fd = ::open(path, O_RDONLY);
+  if (map.fd < 0 || fstat(map.fd, &info) != 0) {
+    message = describe_errno("Failed to open", path);
+    goto fail;
+  }
+  if (static_cast<uint64_t>(info.st_size) < sizeof(FileHeader)) {
+    message = std::string(path) + " is too small to be a raster pyramid";
+    goto fail;
+  }
+  map.size = info.st_size;
+  map.data = mmap(nullptr, map.size, PROT_READ, MAP_SHARED, map.fd, 0);
+  if (map.data == MAP_FAILED) {
+    message = describe_errno("Failed to map", path);
+    goto fail;
+  }
+  // NOTE(josh): Tiles are visited in the order they are panned into view,
+  // which has little to do with their order in the file, so read-ahead would
+  // mostly fetch pages which are never drawn.
+  madvise(map.data, map.size, MADV_RANDOM);
+
+  {
+    const FileHeader* header = static_cast<const FileHeader*>(map.data);
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) {
+      message = std::string(path) + " is not a raster pyramid";
+      goto fail;
+    }
+    if (header->version != kVersion) {
+      message = std::string(path) + " has unsupported version " +
+                std::to_string(header->version);
+      goto fail;
+    }
+    if (header->tile_size < 2 || header->tile_size % 2 ||
+        header->tile_size > 8192 || header->width == 0 ||
+        header->height == 0 || header->width >= (1ULL << 40) ||
+        header->height >= (1ULL << 40)) {
+      message = std::string(path) + " has an invalid header";
+      goto fail;
+    }
+    // NOTE(josh): the layout is recomputed from the header, rather than
+    // trusted, so that every tile lies within the mapping. A layout whose
+    // size overflows is rejected, since it cannot be checked against the
+    // size of the file.
+    uint64_t file_size = 0;
+    std::vector<Level> levels;
+    bool valid = layout_levels(header->width, header->height,
+                               header->tile_size, &levels, &file_size) &&
+                 header->nlevels == levels.size() && file_size <= map.size;
+    const LevelHeader* level_headers =
+        reinterpret_cast<const LevelHeader*>(header + 1);
+    for (size_t idx = 0; valid && idx < levels.size(); idx++) {
+      valid = level_headers[idx].width == levels[idx].width &&
+              level_headers[idx].height == levels[idx].height &&
+              level_headers[idx].offset == levels[idx].offset;
+    }
+    if (!valid) {
+      message = std::string(path) + " is truncated or has invalid levels";
+      goto fail;
+    }
+    raster->tile_size = header->tile_size;
+    raster->width = header->width;
+    raster->height = header->height;
+    raster->levels = std::move(levels);
+  }
+
+  raster->origin[0] = 0;
+  raster->origin[1] = 0;
+  raster->pixel_size = 1.0;
+  raster->cache =
+      gtk_panzoom_tile_cache_new(GTK_PANZOOM_RASTER_DEFAULT_CACHE_BUDGET);
+  return raster;
+
+fail:
+  set_error(error, message);
+  gtk_panzoom_raster_free(raster);
+  return nullptr;
+}
+
+void gtk_panzoom_raster_free(GtkPanZoomRaster* raster) {
+  if (!raster) {
+    return;
+  }
+  if (raster->cache) {
+    gtk_panzoom_tile_cache_free(raster->cache);
+  }
+  delete raster;
+}
+
+uint64_t gtk_panzoom_raster_get_width(const GtkPanZoomRaster* raster) {
+  return raster->width;
+}
+
+uint64_t gtk_panzoom_raster_get_height(const GtkPanZoomRaster* raster) {
+  return raster->height;
+}
+
+uint32_t gtk_panzoom_raster_get_level_count(const GtkPanZoomRaster* raster) {
+  return static_cast<uint32_t>(raster->levels.size());
+}
+
+void gtk_panzoom_raster_set_placement(GtkPanZoomRaster* raster, double x,
+                                      double y, double pixel_size) {
+  raster->origin[0] = x;
+  raster->origin[1] = y;
+  raster->pixel_size = pixel_size;
+}
+
+void gtk_panzoom_raster_get_bounds(const GtkPanZoomRaster* raster,
+                                   double rect[4]) {
+  rect[0] = raster->origin[0];
+  rect[1] = raster->origin[1];
+  rect[2] = raster->origin[0] + raster->width * raster->pixel_size;
+  rect[3] = raster->origin[1] + raster->height * raster->pixel_size;
+}
+
+uint32_t gtk_panzoom_raster_get_level(const GtkPanZoomRaster* raster,
+                                      double pixel_size) {
+  double ratio = pixel_size / raster->pixel_size;
+  if (!(ratio >= 2.0)) {
+    return 0;
+  }
+  double level = std::floor(std::log2(ratio));
+  return static_cast<uint32_t>(
+      std::min(level, static_cast<double>(raster->levels.size() - 1)));
+}
+
+void gtk_panzoom_raster_set_cache_budget(GtkPanZoomRaster* raster,
+                                         size_t budget) {
+  gtk_panzoom_tile_cache_set_budget(raster->cache, budget);
+}
+
+size_t gtk_panzoom_raster_get_cache_budget(const GtkPanZoomRaster* raster) {
+  return gtk_panzoom_tile_cache_get_budget(raster->cache);
+}
+
+size_t gtk_panzoom_raster_get_cache_size(const GtkPanZoomRaster* raster) {
+  return gtk_panzoom_tile_cache_get_size(raster->cache);
+}
+
+void gtk_panzoom_raster_draw(GtkPanZoomRaster* raster, cairo_t* cr,
+                             const GtkPanZoomViewport* viewport) {
+  uint32_t level_idx = gtk_panzoom_raster_get_level(
+      raster, gtk_panzoom_viewport_get_pixel_size(viewport));
+  const Level& level = raster->levels[level_idx];
+  double level_pixel = std::ldexp(raster->pixel_size, level_idx);
+  double tile_span = raster->tile_size * level_pixel;
+
+  // Tile rows are numbered from the top of the image, where y is largest
+  double left = raster->origin[0];
+  double top = raster->origin[1] + raster->height * raster->pixel_size;
+  double clip[4];
+  gtk_panzoom_viewport_get_clip_rect(viewport, cr, clip);
+  double bounds[4] = {
+      std::floor((clip[0] - left) / tile_span),
+      std::floor((top - clip[3]) / tile_span),
+      std::ceil((clip[2] - left) / tile_span),
+      std::ceil((top - clip[1]) / tile_span),
+  };
+  double ntiles[2] = {static_cast<double>(level.ntiles_x),
+                      static_cast<double>(level.ntiles_y)};
+  for (int axis = 0; axis < 2; axis++) {
+    bounds[axis] = std::max(bounds[axis], 0.0);
+    bounds[axis + 2] = std::min(bounds[axis + 2], ntiles[axis]);
+  }
+  if (!(bounds[0] < bounds[2] && bounds[1] < bounds[3])) {
+    return;
+  }
+
+  cairo_save(cr);
+  // NOTE(josh): Without antialiasing each device pixel is covered by exactly
+  // one tile, so there are no seams where the edges of tiles meet.
+  cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+  uint64_t tile_begin[2] = {static_cast<uint64_t>(bounds[0]),
+                            static_cast<uint64_t>(bounds[1])};
+  uint64_t tile_end[2] = {static_cast<uint64_t>(bounds[2]),
+                          static_cast<uint64_t>(bounds[3])};
+  for (uint64_t tile_y = tile_begin[1]; tile_y < tile_end[1]; tile_y++) {
+    for (uint64_t tile_x = tile_begin[0]; tile_x < tile_end[0]; tile_x++) {
+      cairo_surface_t* tile = raster->get_tile(level_idx, tile_x, tile_y);
+      if (!tile) {
+        continue;
+      }
+      uint64_t ncols = std::min<uint64_t>(
+          raster->tile_size, level.width - tile_x * raster->tile_size);
+      uint64_t nrows = std::min<uint64_t>(
+          raster->tile_size, level.height - tile_y * raster->tile_size);
+      cairo_save(cr);
+      cairo_translate(cr, left + tile_x * tile_span, top - tile_y * tile_span);
+      cairo_scale(cr, level_pixel, -level_pixel);
+      cairo_set_source_surface(cr, tile, 0, 0);
+      // Sample the edge of the tile, rather than transparent black, when
+      // filtering the pixels along its border
+      cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+      cairo_rectangle(cr, 0, 0, ncols, nrows);
+      cairo_fill(cr);
+      cairo_restore(cr);
+      cairo_surface_destroy(tile);
+    }
+  }
+  cairo_restore(cr);
+}
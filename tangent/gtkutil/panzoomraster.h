@@ -0,0 +1,90 @@
+#pragma once
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cairo/cairo.h>
+
+#include "tangent/gtkutil/panzoomviewport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A raster image which may be far larger than memory, stored as a pyramid
+/// of square tiles in a single file. Level zero is the full resolution image
+/// and each following level halves the width and height of the previous one
+/// (rounding up), down to a level which fits in a single tile. Each level is
+/// stored as a row-major grid of tiles, and each tile as `tile_size` rows of
+/// `tile_size` pixels in the layout of CAIRO_FORMAT_ARGB32 (native-endian,
+/// premultiplied alpha), padded with transparent pixels beyond the edge of
+/// the level. The file is memory-mapped, so the operating system pages tiles
+/// in and out as they are drawn, and decoded tiles are retained as cairo
+/// surfaces in a least-recently-used cache.
+typedef struct _GtkPanZoomRaster GtkPanZoomRaster;
+
+/// Default size (in pixels) of the edge of a tile in a pyramid file
+#define GTK_PANZOOM_RASTER_DEFAULT_TILE_SIZE 256
+
+/// Default budget (in bytes) of the cache of decoded tiles
+#define GTK_PANZOOM_RASTER_DEFAULT_CACHE_BUDGET (64 * 1024 * 1024)
+
+/// Build a pyramid file at `out_path` from the PNG image at `png_path`. The
+/// source is decoded one band of `tile_size` rows at a time and each coarser
+/// level is computed from the tiles of the previous one, so neither the
+/// source nor any level is ever held in memory as a whole. Returns zero on
+/// failure, in which case `error`, if not NULL, receives a message which the
+/// caller must free().
+int gtk_panzoom_raster_build(const char* png_path, const char* out_path,
+                             uint32_t tile_size, char** error);
+
+/// Map the pyramid file at `path`. Returns NULL on failure, in which case
+/// `error`, if not NULL, receives a message which the caller must free().
+GtkPanZoomRaster* gtk_panzoom_raster_open(const char* path, char** error);
+
+/// Release all cached tiles, unmap the file, and free the raster
+void gtk_panzoom_raster_free(GtkPanZoomRaster* raster);
+
+/// Return the width and height, in pixels, of the full resolution image
+uint64_t gtk_panzoom_raster_get_width(const GtkPanZoomRaster* raster);
+uint64_t gtk_panzoom_raster_get_height(const GtkPanZoomRaster* raster);
+
+/// Return the number of levels in the pyramid
+uint32_t gtk_panzoom_raster_get_level_count(const GtkPanZoomRaster* raster);
+
+/// Place the image in the virtual plane with the bottom left corner at
+/// (x, y) and each pixel of the full resolution image spanning `pixel_size`
+/// virtual units. By default the image is at the origin with unit pixels.
+void gtk_panzoom_raster_set_placement(GtkPanZoomRaster* raster, double x,
+                                      double y, double pixel_size);
+
+/// Get the rectangle of the virtual plane covered by the image, as (x_min,
+/// y_min, x_max, y_max).
+void gtk_panzoom_raster_get_bounds(const GtkPanZoomRaster* raster,
+                                   double rect[4]);
+
+/// Return the index of the coarsest level whose pixels are no larger than
+/// `pixel_size` virtual units (the finest level if none are), i.e. the level
+/// which is drawn when one device pixel spans `pixel_size`.
+uint32_t gtk_panzoom_raster_get_level(const GtkPanZoomRaster* raster,
+                                      double pixel_size);
+
+/// Change the budget, in bytes, of the cache of decoded tiles, releasing
+/// tiles if necessary.
+void gtk_panzoom_raster_set_cache_budget(GtkPanZoomRaster* raster,
+                                         size_t budget);
+size_t gtk_panzoom_raster_get_cache_budget(const GtkPanZoomRaster* raster);
+
+/// Return the number of bytes of decoded tiles currently retained
+size_t gtk_panzoom_raster_get_cache_size(const GtkPanZoomRaster* raster);
+
+/// Draw the tiles of the level matching `viewport` which intersect the
+/// visible rectangle and the clip of `cr`. The transformation of `cr` must
+/// map the virtual plane to device pixels of `viewport` (as it does in draw
+/// handlers and layer callbacks).
+void gtk_panzoom_raster_draw(GtkPanZoomRaster* raster, cairo_t* cr,
+                             const GtkPanZoomViewport* viewport);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
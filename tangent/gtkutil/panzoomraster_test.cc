@@ -0,0 +1,289 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <png.h>
+#include <unistd.h>
+
+#include "tangent/gtkutil/panzoomraster.h"
+
+namespace {
+
+// An odd size, so that every level has a partial tile and every reduction
+// repeats an edge pixel. With tiles of 4 pixels the levels are 13 x 9,
+// 7 x 5, and 4 x 3.
+const uint32_t kWidth = 13;
+const uint32_t kHeight = 9;
+const uint32_t kTileSize = 4;
+const uint32_t kLevelCount = 3;
+
+// Transparent pixels drawn above and to the right of the image
+const uint32_t kMargin = 2;
+
+// Mirrors the header at the start of a pyramid file
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t tile_size;
+  uint64_t width;
+  uint64_t height;
+  uint32_t nlevels;
+  uint32_t reserved;
+};
+
+struct LevelHeader {
+  uint64_t width;
+  uint64_t height;
+  uint64_t offset;
+};
+
+// A file in the test temporary directory, which is removed when this goes out
+// of scope
+struct TempFile {
+  explicit TempFile(const char* name) : path(::testing::TempDir() + name) {}
+  ~TempFile() { std::remove(path.c_str()); }
+  std::string path;
+};
+
+// The source image: straight (not premultiplied) RGBA bytes, row-major from
+// the top. The color channels are random, and alpha cycles through fully
+// transparent, fully opaque, and random values so that the reductions mix
+// all three.
+std::vector<uint8_t> make_source() {
+  std::mt19937 rng(0x5eed);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<uint8_t> rgba;
+  for (uint32_t idx = 0; idx < kWidth * kHeight; idx++) {
+    for (int channel = 0; channel < 3; channel++) {
+      rgba.push_back(static_cast<uint8_t>(byte(rng)));
+    }
+    int alpha = idx % 3 == 0 ? 0 : idx % 3 == 1 ? 255 : byte(rng);
+    rgba.push_back(static_cast<uint8_t>(alpha));
+  }
+  return rgba;
+}
+
+bool write_png(const std::vector<uint8_t>& rgba, const std::string& path) {
+  png_image image = png_image();
+  image.version = PNG_IMAGE_VERSION;
+  image.width = kWidth;
+  image.height = kHeight;
+  image.format = PNG_FORMAT_RGBA;
+  return png_image_write_to_file(&image, path.c_str(), 0, rgba.data(), 0,
+                                 nullptr);
+}
+
+// Convert a straight RGBA pixel to a cairo ARGB32 pixel, premultiplying with
+// rounding to nearest
+uint32_t to_argb32(const uint8_t* rgba) {
+  uint32_t alpha = rgba[3];
+  uint32_t red = (rgba[0] * alpha + 127) / 255;
+  uint32_t green = (rgba[1] * alpha + 127) / 255;
+  uint32_t blue = (rgba[2] * alpha + 127) / 255;
+  return alpha << 24 | red << 16 | green << 8 | blue;
+}
+
+// A level of the pyramid as premultiplied ARGB32 pixels, row-major from the
+// top
+struct Level {
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint32_t> pixels;
+};
+
+// The expected levels of the pyramid: the premultiplied source, then each
+// level reduced from the previous by averaging 2x2 blocks, with the last row
+// and column repeated where the previous level is odd.
+std::vector<Level> make_levels(const std::vector<uint8_t>& rgba) {
+  std::vector<Level> levels(1);
+  levels[0].width = kWidth;
+  levels[0].height = kHeight;
+  for (size_t idx = 0; idx < rgba.size(); idx += 4) {
+    levels[0].pixels.push_back(to_argb32(&rgba[idx]));
+  }
+
+  while (levels.size() < kLevelCount) {
+    const Level& prev = levels.back();
+    Level next;
+    next.width = (prev.width + 1) / 2;
+    next.height = (prev.height + 1) / 2;
+    for (uint32_t y = 0; y < next.height; y++) {
+      for (uint32_t x = 0; x < next.width; x++) {
+        uint32_t xs[2] = {2 * x, std::min(2 * x + 1, prev.width - 1)};
+        uint32_t ys[2] = {2 * y, std::min(2 * y + 1, prev.height - 1)};
+        uint32_t pixel = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+          uint32_t sum = 0;
+          for (uint32_t src_y : ys) {
+            for (uint32_t src_x : xs) {
+              sum += (prev.pixels[src_y * prev.width + src_x] >> shift) & 0xff;
+            }
+          }
+          pixel |= ((sum + 2) / 4) << shift;
+        }
+        next.pixels.push_back(pixel);
+      }
+    }
+    levels.push_back(next);
+  }
+  return levels;
+}
+
+// Draw the raster into a viewport where each device pixel is one pixel of
+// `level`, with a margin above and to the right of the image, and return the
+// device pixels, row-major from the top.
+std::vector<uint32_t> draw_level(GtkPanZoomRaster* raster, const Level& level,
+                                 uint32_t level_idx) {
+  double pixel_size = 1 << level_idx;
+  GtkPanZoomViewport viewport;
+  viewport.width = level.width + kMargin;
+  viewport.height = level.height + kMargin;
+  viewport.scale = pixel_size * std::max(viewport.width, viewport.height);
+  // The top of every level is aligned to the top of the image, so the rows
+  // of device pixels are aligned to the rows of the level
+  viewport.offset[0] = 0;
+  viewport.offset[1] =
+      kHeight + (kMargin - static_cast<double>(viewport.height)) * pixel_size;
+
+  cairo_surface_t* surface = cairo_image_surface_create(
+      CAIRO_FORMAT_ARGB32, viewport.width, viewport.height);
+  cairo_t* cr = cairo_create(surface);
+  gtk_panzoom_viewport_apply(&viewport, cr);
+  gtk_panzoom_raster_draw(raster, cr, &viewport);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+
+  std::vector<uint32_t> out;
+  const uint8_t* data = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  for (int y = 0; y < viewport.height; y++) {
+    const uint32_t* row = reinterpret_cast<const uint32_t*>(data + y * stride);
+    out.insert(out.end(), row, row + viewport.width);
+  }
+  cairo_surface_destroy(surface);
+  return out;
+}
+
+// The contents of a pyramid file whose level headers match the layout
+// computed with unchecked arithmetic, in which the size of each level wraps
+// around 64 bits
+std::vector<char> make_wrapped_pyramid(uint64_t width, uint64_t height,
+                                       uint32_t tile_size) {
+  std::vector<LevelHeader> levels;
+  while (true) {
+    levels.push_back(LevelHeader{width, height, 0});
+    if (width <= tile_size && height <= tile_size) {
+      break;
+    }
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  uint64_t offset = sizeof(FileHeader) + levels.size() * sizeof(LevelHeader);
+  for (LevelHeader& level : levels) {
+    offset = (offset + 4095) / 4096 * 4096;
+    level.offset = offset;
+    uint64_t ntiles_x = (level.width + tile_size - 1) / tile_size;
+    uint64_t ntiles_y = (level.height + tile_size - 1) / tile_size;
+    offset += ntiles_x * ntiles_y * 4 * tile_size * tile_size;
+  }
+
+  FileHeader header{};
+  memcpy(header.magic, "PZRASTER", sizeof(header.magic));
+  header.version = 1;
+  header.tile_size = tile_size;
+  header.width = levels[0].width;
+  header.height = levels[0].height;
+  header.nlevels = static_cast<uint32_t>(levels.size());
+  std::vector<char> buffer(offset, 0);
+  memcpy(buffer.data(), &header, sizeof(header));
+  memcpy(buffer.data() + sizeof(header), levels.data(),
+         levels.size() * sizeof(LevelHeader));
+  return buffer;
+}
+
+}  // namespace
+
+TEST(PanZoomRaster, RoundTrip) {
+  TempFile png("panzoomraster_round_trip.png");
+  TempFile pyramid("panzoomraster_round_trip.pzr");
+  const std::string& path = pyramid.path;
+  std::vector<uint8_t> source = make_source();
+  ASSERT_TRUE(write_png(source, png.path));
+  char* error = nullptr;
+  ASSERT_TRUE(gtk_panzoom_raster_build(png.path.c_str(), path.c_str(),
+                                       kTileSize, &error))
+      << error;
+  GtkPanZoomRaster* raster = gtk_panzoom_raster_open(path.c_str(), &error);
+  ASSERT_NE(raster, nullptr) << error;
+  EXPECT_EQ(gtk_panzoom_raster_get_width(raster), kWidth);
+  EXPECT_EQ(gtk_panzoom_raster_get_height(raster), kHeight);
+  ASSERT_EQ(gtk_panzoom_raster_get_level_count(raster), kLevelCount);
+
+  // The coarsest level whose pixels are no larger than a device pixel, up to
+  // the coarsest level of the pyramid
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 0.25), 0u);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 1.0), 0u);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 1.99), 0u);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 2.0), 1u);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 3.99), 1u);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 4.0), 2u);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 1e6), 2u);
+  gtk_panzoom_raster_set_placement(raster, 0, 0, 0.5);
+  EXPECT_EQ(gtk_panzoom_raster_get_level(raster, 1.0), 1u);
+  gtk_panzoom_raster_set_placement(raster, 0, 0, 1.0);
+
+  std::vector<Level> levels = make_levels(source);
+  for (uint32_t level_idx = 0; level_idx < kLevelCount; level_idx++) {
+    const Level& level = levels[level_idx];
+    std::vector<uint32_t> device = draw_level(raster, level, level_idx);
+    uint32_t device_width = level.width + kMargin;
+    ASSERT_EQ(device.size(), device_width * (level.height + kMargin));
+    for (uint32_t y = 0; y < level.height + kMargin; y++) {
+      for (uint32_t x = 0; x < device_width; x++) {
+        uint32_t expect = 0;
+        if (y >= kMargin && x < level.width) {
+          expect = level.pixels[(y - kMargin) * level.width + x];
+        }
+        // Pixels outside of the image, including the padding of the partial
+        // tiles, are not drawn
+        EXPECT_EQ(device[y * device_width + x], expect)
+            << "level " << level_idx << " (" << x << ", " << y << ")";
+      }
+    }
+  }
+  EXPECT_GT(gtk_panzoom_raster_get_cache_size(raster), 0u);
+  gtk_panzoom_raster_free(raster);
+
+  // A truncated file is rejected
+  ASSERT_EQ(truncate(path.c_str(), 4096 + 16), 0);
+  EXPECT_EQ(gtk_panzoom_raster_open(path.c_str(), &error), nullptr);
+  ASSERT_NE(error, nullptr);
+  free(error);
+}
+
+TEST(PanZoomRaster, RejectsOverflowingLayout) {
+  // The image is within the limits of the header, but the pyramid spans
+  // 2^64 + 73744 bytes, so with unchecked arithmetic it appears to fit in the
+  // 73744 bytes of the file.
+  TempFile pyramid("panzoomraster_overflow.pzr");
+  const std::string& path = pyramid.path;
+  std::vector<char> buffer =
+      make_wrapped_pyramid(103079205888ULL, 33554433ULL, 2);
+  ASSERT_LT(buffer.size(), 1u << 20);
+  FILE* file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(fwrite(buffer.data(), 1, buffer.size(), file), buffer.size());
+  fclose(file);
+
+  char* error = nullptr;
+  EXPECT_EQ(gtk_panzoom_raster_open(path.c_str(), &error), nullptr);
+  ASSERT_NE(error, nullptr);
+  EXPECT_NE(std::string(error).find(path), std::string::npos);
+  free(error);
+}
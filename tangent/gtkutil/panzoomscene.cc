@@ -0,0 +1,729 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/gtkutil/panzoomscene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const int32_t kNull = -1;
+
+// Axis aligned bounding box in the virtual plane
+struct Box {
+  double min[2];
+  double max[2];
+};
+
+Box merge(const Box& a, const Box& b) {
+  return Box{{std::min(a.min[0], b.min[0]), std::min(a.min[1], b.min[1])},
+             {std::max(a.max[0], b.max[0]), std::max(a.max[1], b.max[1])}};
+}
+
+// NOTE(josh): The perimeter is used as the cost of a box (rather than the
+// area) so that degenerate boxes, such as those of points and horizontal
+// lines, are still distinguished.
+double get_perimeter(const Box& box) {
+  return 2 * ((box.max[0] - box.min[0]) + (box.max[1] - box.min[1]));
+}
+
+bool overlaps(const Box& a, const Box& b) {
+  return a.min[0] <= b.max[0] && b.min[0] <= a.max[0] &&
+         a.min[1] <= b.max[1] && b.min[1] <= a.max[1];
+}
+
+// Dynamic bounding volume hierarchy. Each leaf holds the box of one
+// primitive. Internal nodes hold the union of their children and the tree is
+// kept balanced with rotations, so that insert and remove are O(log n).
+class BoxTree {
+ public:
+  // Insert a leaf and return its node index
+  int32_t insert(const Box& box, GtkPanZoomSceneId id) {
+    int32_t leaf = allocate();
+    nodes_[leaf].box = box;
+    nodes_[leaf].id = id;
+    nodes_[leaf].height = 0;
+    insert_leaf(leaf);
+    return leaf;
+  }
+
+  void remove(int32_t leaf) {
+    remove_leaf(leaf);
+    release(leaf);
+  }
+
+  void clear() {
+    nodes_.clear();
+    root_ = kNull;
+    free_list_ = kNull;
+  }
+
+  // Return the union of all leaves, or NULL if the tree is empty
+  const Box* get_bounds() const {
+    return root_ == kNull ? nullptr : &nodes_[root_].box;
+  }
+
+  // Append the id of every leaf intersecting `box` to `out`
+  void query(const Box& box, std::vector<GtkPanZoomSceneId>* out) const {
+    if (root_ == kNull) {
+      return;
+    }
+    std::vector<int32_t> stack;
+    stack.push_back(root_);
+    while (!stack.empty()) {
+      const Node& node = nodes_[stack.back()];
+      stack.pop_back();
+      if (!overlaps(node.box, box)) {
+        continue;
+      }
+      if (node.is_leaf()) {
+        out->push_back(node.id);
+      } else {
+        stack.push_back(node.child[0]);
+        stack.push_back(node.child[1]);
+      }
+    }
+  }
+
+ private:
+  struct Node {
+    bool is_leaf() const {
+      return child[0] == kNull;
+    }
+
+    Box box;
+    GtkPanZoomSceneId id;
+    int32_t parent;
+    int32_t child[2];
+    int32_t height;  ///< zero for leaves
+  };
+
+  int32_t allocate() {
+    int32_t idx = free_list_;
+    if (idx == kNull) {
+      idx = static_cast<int32_t>(nodes_.size());
+      nodes_.emplace_back();
+    } else {
+      free_list_ = nodes_[idx].parent;
+    }
+    Node& node = nodes_[idx];
+    node.id = 0;
+    node.parent = kNull;
+    node.child[0] = kNull;
+    node.child[1] = kNull;
+    node.height = 0;
+    return idx;
+  }
+
+  // Freed nodes are chained through their parent index
+  void release(int32_t idx) {
+    nodes_[idx].parent = free_list_;
+    nodes_[idx].height = -1;
+    free_list_ = idx;
+  }
+
+  // Recompute the box and height of an internal node from its children
+  void refit(int32_t idx) {
+    Node& node = nodes_[idx];
+    const Node& left = nodes_[node.child[0]];
+    const Node& right = nodes_[node.child[1]];
+    node.box = merge(left.box, right.box);
+    node.height = 1 + std::max(left.height, right.height);
+  }
+
+  // Walk from `idx` to the root, rebalancing and refitting each ancestor
+  void refit_ancestors(int32_t idx) {
+    while (idx != kNull) {
+      idx = balance(idx);
+      refit(idx);
+      idx = nodes_[idx].parent;
+    }
+  }
+
+  void replace_child(int32_t parent, int32_t old_child, int32_t new_child) {
+    if (parent == kNull) {
+      root_ = new_child;
+    } else if (nodes_[parent].child[0] == old_child) {
+      nodes_[parent].child[0] = new_child;
+    } else {
+      nodes_[parent].child[1] = new_child;
+    }
+  }
+
+  // Return the cost of descending into `idx` when inserting `box`
+  double get_descent_cost(int32_t idx, const Box& box) const {
+    const Node& node = nodes_[idx];
+    double merged = get_perimeter(merge(node.box, box));
+    if (node.is_leaf()) {
+      return merged;
+    }
+    return merged - get_perimeter(node.box);
+  }
+
+  void insert_leaf(int32_t leaf) {
+    if (root_ == kNull) {
+      root_ = leaf;
+      nodes_[leaf].parent = kNull;
+      return;
+    }
+
+    // Find the best sibling by descending the tree, choosing the child
+    // whose box grows the least.
+    const Box box = nodes_[leaf].box;
+    int32_t sibling = root_;
+    while (!nodes_[sibling].is_leaf()) {
+      const Node& node = nodes_[sibling];
+      double perimeter = get_perimeter(node.box);
+      double merged = get_perimeter(merge(node.box, box));
+      // cost of making a new parent for this node and the leaf
+      double cost = 2 * merged;
+      // minimum cost of pushing the leaf further down the tree
+      double inheritance = 2 * (merged - perimeter);
+      double cost_left = get_descent_cost(node.child[0], box) + inheritance;
+      double cost_right = get_descent_cost(node.child[1], box) + inheritance;
+      if (cost < cost_left && cost < cost_right) {
+        break;
+      }
+      sibling = cost_left < cost_right ? node.child[0] : node.child[1];
+    }
+
+    int32_t old_parent = nodes_[sibling].parent;
+    int32_t new_parent = allocate();
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].child[0] = sibling;
+    nodes_[new_parent].child[1] = leaf;
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+    replace_child(old_parent, sibling, new_parent);
+    refit_ancestors(new_parent);
+  }
+
+  void remove_leaf(int32_t leaf) {
+    if (leaf == root_) {
+      root_ = kNull;
+      return;
+    }
+
+    int32_t parent = nodes_[leaf].parent;
+    int32_t grandparent = nodes_[parent].parent;
+    int32_t sibling = nodes_[parent].child[0] == leaf
+                          ? nodes_[parent].child[1]
+                          : nodes_[parent].child[0];
+    replace_child(grandparent, parent, sibling);
+    nodes_[sibling].parent = grandparent;
+    release(parent);
+    refit_ancestors(grandparent);
+  }
+
+  // If the subtree rooted at `idx_a` is imbalanced, rotate its taller child
+  // up into its place. Returns the index of the new root of the subtree.
+  int32_t balance(int32_t idx_a) {
+    if (nodes_[idx_a].is_leaf() || nodes_[idx_a].height < 2) {
+      return idx_a;
+    }
+
+    int32_t idx_b = nodes_[idx_a].child[0];
+    int32_t idx_c = nodes_[idx_a].child[1];
+    int32_t skew = nodes_[idx_c].height - nodes_[idx_b].height;
+    if (skew > 1) {
+      return rotate(idx_a, 1);
+    }
+    if (skew < -1) {
+      return rotate(idx_a, 0);
+    }
+    return idx_a;
+  }
+
+  // Rotate child `side` of `idx_a` up to replace `idx_a`. The taller of the
+  // grandchildren stays with the promoted node and the shorter one is given
+  // to `idx_a`.
+  int32_t rotate(int32_t idx_a, int side) {
+    int32_t idx_up = nodes_[idx_a].child[side];
+    int32_t idx_f = nodes_[idx_up].child[0];
+    int32_t idx_g = nodes_[idx_up].child[1];
+
+    // Promote `idx_up` into the place of `idx_a`
+    nodes_[idx_up].child[0] = idx_a;
+    nodes_[idx_up].parent = nodes_[idx_a].parent;
+    nodes_[idx_a].parent = idx_up;
+    replace_child(nodes_[idx_up].parent, idx_a, idx_up);
+
+    int32_t keep = idx_f;
+    int32_t give = idx_g;
+    if (nodes_[idx_g].height > nodes_[idx_f].height) {
+      keep = idx_g;
+      give = idx_f;
+    }
+    nodes_[idx_up].child[1] = keep;
+    nodes_[idx_a].child[side] = give;
+    nodes_[give].parent = idx_a;
+    refit(idx_a);
+    refit(idx_up);
+    return idx_up;
+  }
+
+  std::vector<Node> nodes_;
+  int32_t root_ = kNull;
+  int32_t free_list_ = kNull;
+};
+
+struct Primitive {
+  GtkPanZoomPrimitiveKind kind;
+  uint32_t style_id;
+  std::vector<double> xy;
+  double radius;
+  std::string text;
+  int32_t node;  ///< leaf of this primitive in the tree
+};
+
+// Return true if `n` coordinate pairs is valid for the kind of primitive and
+// all coordinates are finite.
+bool validate(GtkPanZoomPrimitiveKind kind, const double* xy, size_t n) {
+  switch (kind) {
+    case GTK_PANZOOM_PRIMITIVE_POINT:
+    case GTK_PANZOOM_PRIMITIVE_CIRCLE:
+    case GTK_PANZOOM_PRIMITIVE_TEXT:
+      if (n != 1) {
+        return false;
+      }
+      break;
+    case GTK_PANZOOM_PRIMITIVE_POLYLINE:
+    case GTK_PANZOOM_PRIMITIVE_POLYGON:
+      if (n < 2) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  for (size_t idx = 0; idx < 2 * n; idx++) {
+    if (!std::isfinite(xy[idx])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Box get_box(const Primitive& prim) {
+  Box box{{prim.xy[0], prim.xy[1]}, {prim.xy[0], prim.xy[1]}};
+  for (size_t idx = 2; idx < prim.xy.size(); idx += 2) {
+    for (size_t dim = 0; dim < 2; dim++) {
+      box.min[dim] = std::min(box.min[dim], prim.xy[idx + dim]);
+      box.max[dim] = std::max(box.max[dim], prim.xy[idx + dim]);
+    }
+  }
+  if (prim.kind == GTK_PANZOOM_PRIMITIVE_CIRCLE) {
+    for (size_t dim = 0; dim < 2; dim++) {
+      box.min[dim] -= prim.radius;
+      box.max[dim] += prim.radius;
+    }
+  }
+  return box;
+}
+
+// Return the distance from `point` to the segment from `a` to `b`
+double get_segment_distance(const double point[2], const double a[2],
+                            const double b[2]) {
+  double dir[2] = {b[0] - a[0], b[1] - a[1]};
+  double rel[2] = {point[0] - a[0], point[1] - a[1]};
+  double len2 = dir[0] * dir[0] + dir[1] * dir[1];
+  double param = 0;
+  if (len2 > 0) {
+    param = std::min(1.0, std::max(0.0, (rel[0] * dir[0] + rel[1] * dir[1]) /
+                                            len2));
+  }
+  return std::hypot(rel[0] - param * dir[0], rel[1] - param * dir[1]);
+}
+
+// Return true if `point` is inside the polygon (even-odd rule)
+bool is_inside(const double point[2], const std::vector<double>& xy) {
+  bool inside = false;
+  size_t npoints = xy.size() / 2;
+  for (size_t idx = 0, prev = npoints - 1; idx < npoints; prev = idx++) {
+    const double* a = &xy[2 * idx];
+    const double* b = &xy[2 * prev];
+    if ((a[1] > point[1]) != (b[1] > point[1]) &&
+        point[0] < a[0] + (b[0] - a[0]) * (point[1] - a[1]) / (b[1] - a[1])) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+// Return the distance from `point` to the primitive
+double get_distance(const double point[2], const Primitive& prim) {
+  const std::vector<double>& xy = prim.xy;
+  switch (prim.kind) {
+    case GTK_PANZOOM_PRIMITIVE_CIRCLE: {
+      double dist = std::hypot(point[0] - xy[0], point[1] - xy[1]);
+      return std::max(0.0, dist - prim.radius);
+    }
+
+    case GTK_PANZOOM_PRIMITIVE_POLYLINE:
+    case GTK_PANZOOM_PRIMITIVE_POLYGON: {
+      bool closed = prim.kind == GTK_PANZOOM_PRIMITIVE_POLYGON;
+      if (closed && is_inside(point, xy)) {
+        return 0.0;
+      }
+      size_t nsegments = xy.size() / 2 - (closed ? 0 : 1);
+      double dist = INFINITY;
+      for (size_t idx = 0; idx < nsegments; idx++) {
+        size_t next = (idx + 1) % (xy.size() / 2);
+        dist = std::min(
+            dist, get_segment_distance(point, &xy[2 * idx], &xy[2 * next]));
+      }
+      return dist;
+    }
+
+    default:
+      return std::hypot(point[0] - xy[0], point[1] - xy[1]);
+  }
+}
+
+// Set the source of `cr` to the color and return true, unless the color is
+// fully transparent.
+bool set_source(cairo_t* cr, const double rgba[4]) {
+  if (!(rgba[3] > 0)) {
+    return false;
+  }
+  cairo_set_source_rgba(cr, rgba[0], rgba[1], rgba[2], rgba[3]);
+  return true;
+}
+
+// Fill and/or stroke the current path, then clear it
+void paint_path(cairo_t* cr, const GtkPanZoomStyle& style, double pixel_size,
+                bool fill, bool stroke) {
+  if (fill && set_source(cr, style.fill_rgba)) {
+    cairo_fill_preserve(cr);
+  }
+  if (stroke && style.line_width > 0 && set_source(cr, style.stroke_rgba)) {
+    cairo_set_line_width(cr, style.line_width * pixel_size);
+    cairo_stroke_preserve(cr);
+  }
+  cairo_new_path(cr);
+}
+
+void draw_primitive(cairo_t* cr, const Primitive& prim,
+                    const GtkPanZoomStyle& style, double pixel_size) {
+  const std::vector<double>& xy = prim.xy;
+  switch (prim.kind) {
+    case GTK_PANZOOM_PRIMITIVE_POINT: {
+      cairo_arc(cr, xy[0], xy[1], style.point_size * pixel_size, 0,
+                2 * M_PI);
+      paint_path(cr, style, pixel_size, true, false);
+      break;
+    }
+
+    case GTK_PANZOOM_PRIMITIVE_POLYLINE:
+    case GTK_PANZOOM_PRIMITIVE_POLYGON: {
+      cairo_move_to(cr, xy[0], xy[1]);
+      for (size_t idx = 2; idx < xy.size(); idx += 2) {
+        cairo_line_to(cr, xy[idx], xy[idx + 1]);
+      }
+      bool closed = prim.kind == GTK_PANZOOM_PRIMITIVE_POLYGON;
+      if (closed) {
+        cairo_close_path(cr);
+      }
+      paint_path(cr, style, pixel_size, closed, true);
+      break;
+    }
+
+    case GTK_PANZOOM_PRIMITIVE_CIRCLE: {
+      cairo_arc(cr, xy[0], xy[1], prim.radius, 0, 2 * M_PI);
+      paint_path(cr, style, pixel_size, true, true);
+      break;
+    }
+
+    case GTK_PANZOOM_PRIMITIVE_TEXT: {
+      if (!set_source(cr, style.fill_rgba)) {
+        break;
+      }
+      // NOTE(josh): text is drawn in pixel units, upright, with its baseline
+      // starting at the anchor.
+      cairo_save(cr);
+      cairo_translate(cr, xy[0], xy[1]);
+      cairo_scale(cr, pixel_size, -pixel_size);
+      cairo_set_font_size(cr, style.font_size);
+      cairo_move_to(cr, 0, 0);
+      cairo_show_text(cr, prim.text.c_str());
+      cairo_new_path(cr);
+      cairo_restore(cr);
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+}  // namespace
+
+struct _GtkPanZoomScene {
+  // Return the style for the given id, or the default style
+  const GtkPanZoomStyle& get_style(uint32_t style_id) const {
+    auto found = styles.find(style_id);
+    if (found == styles.end()) {
+      return default_style;
+    }
+    return found->second;
+  }
+
+  // Return the ids of all primitives intersecting `box`, in the order they
+  // were added.
+  void query(const Box& box, std::vector<GtkPanZoomSceneId>* ids) const {
+    ids->clear();
+    tree.query(box, ids);
+    std::sort(ids->begin(), ids->end());
+  }
+
+  BoxTree tree;
+  std::unordered_map<GtkPanZoomSceneId, Primitive> primitives;
+  std::unordered_map<uint32_t, GtkPanZoomStyle> styles;
+  GtkPanZoomStyle default_style;
+  GtkPanZoomSceneId next_id;
+};
+
+void gtk_panzoom_style_init(GtkPanZoomStyle* style) {
+  const double black[4] = {0, 0, 0, 1};
+  std::copy(black, black + 4, style->stroke_rgba);
+  std::copy(black, black + 4, style->fill_rgba);
+  style->line_width = 1.0;
+  style->point_size = 2.0;
+  style->font_size = 12.0;
+}
+
+GtkPanZoomScene* gtk_panzoom_scene_new(void) {
+  GtkPanZoomScene* scene = new GtkPanZoomScene();
+  gtk_panzoom_style_init(&scene->default_style);
+  // NOTE(josh): the default fill is transparent so that polygons and circles
+  // are drawn as outlines, but points and text are still visible.
+  scene->default_style.fill_rgba[3] = 0.0;
+  scene->next_id = 1;
+  return scene;
+}
+
+void gtk_panzoom_scene_free(GtkPanZoomScene* scene) {
+  delete scene;
+}
+
+void gtk_panzoom_scene_set_style(GtkPanZoomScene* scene, uint32_t style_id,
+                                 const GtkPanZoomStyle* style) {
+  scene->styles[style_id] = *style;
+}
+
+GtkPanZoomSceneId gtk_panzoom_scene_add(GtkPanZoomScene* scene,
+                                        GtkPanZoomPrimitiveKind kind,
+                                        uint32_t style_id, const double* xy,
+                                        size_t n, double radius,
+                                        const char* text) {
+  if (!validate(kind, xy, n)) {
+    return 0;
+  }
+  if (kind == GTK_PANZOOM_PRIMITIVE_CIRCLE &&
+      !(std::isfinite(radius) && radius >= 0)) {
+    return 0;
+  }
+  if (kind == GTK_PANZOOM_PRIMITIVE_TEXT && !text) {
+    return 0;
+  }
+
+  GtkPanZoomSceneId id = scene->next_id++;
+  Primitive& prim = scene->primitives[id];
+  prim.kind = kind;
+  prim.style_id = style_id;
+  prim.xy.assign(xy, xy + 2 * n);
+  prim.radius = radius;
+  if (kind == GTK_PANZOOM_PRIMITIVE_TEXT) {
+    prim.text = text;
+  }
+  prim.node = scene->tree.insert(get_box(prim), id);
+  return id;
+}
+
+GtkPanZoomSceneId gtk_panzoom_scene_add_point(GtkPanZoomScene* scene,
+                                              uint32_t style_id, double x,
+                                              double y) {
+  const double xy[2] = {x, y};
+  return gtk_panzoom_scene_add(scene, GTK_PANZOOM_PRIMITIVE_POINT, style_id,
+                               xy, 1, 0.0, nullptr);
+}
+
+GtkPanZoomSceneId gtk_panzoom_scene_add_polyline(GtkPanZoomScene* scene,
+                                                 uint32_t style_id,
+                                                 const double* xy, size_t n) {
+  return gtk_panzoom_scene_add(scene, GTK_PANZOOM_PRIMITIVE_POLYLINE, style_id,
+                               xy, n, 0.0, nullptr);
+}
+
+GtkPanZoomSceneId gtk_panzoom_scene_add_polygon(GtkPanZoomScene* scene,
+                                                uint32_t style_id,
+                                                const double* xy, size_t n) {
+  return gtk_panzoom_scene_add(scene, GTK_PANZOOM_PRIMITIVE_POLYGON, style_id,
+                               xy, n, 0.0, nullptr);
+}
+
+GtkPanZoomSceneId gtk_panzoom_scene_add_circle(GtkPanZoomScene* scene,
+                                               uint32_t style_id, double x,
+                                               double y, double radius) {
+  const double xy[2] = {x, y};
+  return gtk_panzoom_scene_add(scene, GTK_PANZOOM_PRIMITIVE_CIRCLE, style_id,
+                               xy, 1, radius, nullptr);
+}
+
+GtkPanZoomSceneId gtk_panzoom_scene_add_text(GtkPanZoomScene* scene,
+                                             uint32_t style_id, double x,
+                                             double y, const char* text) {
+  const double xy[2] = {x, y};
+  return gtk_panzoom_scene_add(scene, GTK_PANZOOM_PRIMITIVE_TEXT, style_id, xy,
+                               1, 0.0, text);
+}
+
+void gtk_panzoom_scene_add_points(GtkPanZoomScene* scene, uint32_t style_id,
+                                  const double* xy, size_t n,
+                                  GtkPanZoomSceneId* ids) {
+  scene->primitives.reserve(scene->primitives.size() + n);
+  for (size_t idx = 0; idx < n; idx++) {
+    GtkPanZoomSceneId id = gtk_panzoom_scene_add(
+        scene, GTK_PANZOOM_PRIMITIVE_POINT, style_id, xy + 2 * idx, 1, 0.0,
+        nullptr);
+    if (ids) {
+      ids[idx] = id;
+    }
+  }
+}
+
+int gtk_panzoom_scene_set_coords(GtkPanZoomScene* scene, GtkPanZoomSceneId id,
+                                 const double* xy, size_t n) {
+  auto found = scene->primitives.find(id);
+  if (found == scene->primitives.end()) {
+    return 0;
+  }
+  Primitive& prim = found->second;
+  if (!validate(prim.kind, xy, n)) {
+    return 0;
+  }
+  prim.xy.assign(xy, xy + 2 * n);
+  scene->tree.remove(prim.node);
+  prim.node = scene->tree.insert(get_box(prim), id);
+  return 1;
+}
+
+int gtk_panzoom_scene_set_primitive_style(GtkPanZoomScene* scene,
+                                          GtkPanZoomSceneId id,
+                                          uint32_t style_id) {
+  auto found = scene->primitives.find(id);
+  if (found == scene->primitives.end()) {
+    return 0;
+  }
+  found->second.style_id = style_id;
+  return 1;
+}
+
+int gtk_panzoom_scene_remove(GtkPanZoomScene* scene, GtkPanZoomSceneId id) {
+  auto found = scene->primitives.find(id);
+  if (found == scene->primitives.end()) {
+    return 0;
+  }
+  scene->tree.remove(found->second.node);
+  scene->primitives.erase(found);
+  return 1;
+}
+
+void gtk_panzoom_scene_clear(GtkPanZoomScene* scene) {
+  scene->tree.clear();
+  scene->primitives.clear();
+}
+
+size_t gtk_panzoom_scene_get_count(const GtkPanZoomScene* scene) {
+  return scene->primitives.size();
+}
+
+int gtk_panzoom_scene_get_bounds(const GtkPanZoomScene* scene,
+                                 double rect[4]) {
+  const Box* bounds = scene->tree.get_bounds();
+  if (!bounds) {
+    return 0;
+  }
+  rect[0] = bounds->min[0];
+  rect[1] = bounds->min[1];
+  rect[2] = bounds->max[0];
+  rect[3] = bounds->max[1];
+  return 1;
+}
+
+size_t gtk_panzoom_scene_query(const GtkPanZoomScene* scene,
+                               const double rect[4], GtkPanZoomSceneId* ids,
+                               size_t capacity) {
+  std::vector<GtkPanZoomSceneId> found;
+  scene->query(Box{{rect[0], rect[1]}, {rect[2], rect[3]}}, &found);
+  std::copy_n(found.begin(), std::min(capacity, found.size()), ids);
+  return found.size();
+}
+
+size_t gtk_panzoom_scene_pick(const GtkPanZoomScene* scene,
+                              const double point[2], double tolerance,
+                              GtkPanZoomSceneId* ids, size_t capacity) {
+  std::vector<GtkPanZoomSceneId> candidates;
+  scene->query(Box{{point[0] - tolerance, point[1] - tolerance},
+                   {point[0] + tolerance, point[1] + tolerance}},
+               &candidates);
+
+  std::vector<std::pair<double, GtkPanZoomSceneId>> hits;
+  for (GtkPanZoomSceneId id : candidates) {
+    double dist = get_distance(point, scene->primitives.at(id));
+    if (dist <= tolerance) {
+      hits.emplace_back(dist, id);
+    }
+  }
+
+  // Nearest first, and then top-most (most recently added) first
+  std::sort(hits.begin(), hits.end(),
+            [](const std::pair<double, GtkPanZoomSceneId>& a,
+               const std::pair<double, GtkPanZoomSceneId>& b) {
+              return a.first < b.first ||
+                     (a.first == b.first && a.second > b.second);
+            });
+  for (size_t idx = 0; idx < hits.size() && idx < capacity; idx++) {
+    ids[idx] = hits[idx].second;
+  }
+  return hits.size();
+}
+
+void gtk_panzoom_scene_draw(const GtkPanZoomScene* scene, cairo_t* cr,
+                            const GtkPanZoomViewport* viewport) {
+  double pixel_size = gtk_panzoom_viewport_get_pixel_size(viewport);
+  double visible[4] = {0, 0, 0, 0};
+  gtk_panzoom_viewport_get_visible_rect(viewport, visible);
+  double clip[4] = {0, 0, 0, 0};
+  cairo_clip_extents(cr, &clip[0], &clip[1], &clip[2], &clip[3]);
+
+  // Points, strokes, and text extend beyond their boxes by an amount which is
+  // fixed in pixels, so grow the query by the largest such amount.
+  double margin = 0;
+  for (const auto& pair : scene->styles) {
+    const GtkPanZoomStyle& style = pair.second;
+    margin = std::max({margin, style.line_width / 2, style.point_size,
+                       style.font_size});
+  }
+  const GtkPanZoomStyle& fallback = scene->default_style;
+  margin = std::max({margin, fallback.line_width / 2, fallback.point_size,
+                     fallback.font_size});
+  margin *= pixel_size;
+
+  Box query{{std::max(visible[0], clip[0]) - margin,
+             std::max(visible[1], clip[1]) - margin},
+            {std::min(visible[2], clip[2]) + margin,
+             std::min(visible[3], clip[3]) + margin}};
+  std::vector<GtkPanZoomSceneId> ids;
+  scene->query(query, &ids);
+
+  cairo_save(cr);
+  for (GtkPanZoomSceneId id : ids) {
+    const Primitive& prim = scene->primitives.at(id);
+    draw_primitive(cr, prim, scene->get_style(prim.style_id), pixel_size);
+  }
+  cairo_restore(cr);
+}
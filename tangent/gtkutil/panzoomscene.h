@@ -0,0 +1,138 @@
+#pragma once
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cairo/cairo.h>
+
+#include "tangent/gtkutil/panzoomviewport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Retained store of primitives in the virtual plane of a GtkPanZoomArea.
+/// Primitives are indexed by their bounding boxes in a dynamic AABB tree
+/// so that insert, update, and remove are O(log n) and drawing only visits
+/// primitives which intersect the visible rectangle.
+typedef struct _GtkPanZoomScene GtkPanZoomScene;
+
+/// Identifies a primitive within a scene. Zero is never a valid id.
+typedef uint64_t GtkPanZoomSceneId;
+
+typedef enum {
+  GTK_PANZOOM_PRIMITIVE_POINT,
+  GTK_PANZOOM_PRIMITIVE_POLYLINE,
+  GTK_PANZOOM_PRIMITIVE_POLYGON,
+  GTK_PANZOOM_PRIMITIVE_CIRCLE,
+  GTK_PANZOOM_PRIMITIVE_TEXT,
+} GtkPanZoomPrimitiveKind;
+
+/// Drawing style shared by all primitives with the same style id. Sizes are
+/// in device pixels so that they are independent of zoom. A color with zero
+/// alpha is not drawn.
+typedef struct _GtkPanZoomStyle {
+  double stroke_rgba[4];  ///< outline of polygons and circles, polylines
+  double fill_rgba[4];    ///< interior of polygons and circles, points, text
+  double line_width;      ///< stroke width in pixels
+  double point_size;      ///< radius of points in pixels
+  double font_size;       ///< size of text in pixels
+} GtkPanZoomStyle;
+
+/// Fill `style` with the style used for any style id which has not been set
+void gtk_panzoom_style_init(GtkPanZoomStyle* style);
+
+GtkPanZoomScene* gtk_panzoom_scene_new(void);
+void gtk_panzoom_scene_free(GtkPanZoomScene* scene);
+
+/// Set the style for all primitives with the given style id
+void gtk_panzoom_scene_set_style(GtkPanZoomScene* scene, uint32_t style_id,
+                                 const GtkPanZoomStyle* style);
+
+/// Add a primitive. `xy` holds `n` interleaved (x, y) pairs: one for a point,
+/// circle, or text anchor, and at least two for a polyline or polygon.
+/// `radius` is only used by circles and `text` only by text (it is copied).
+/// Returns the id of the new primitive, or zero if the arguments are invalid.
+GtkPanZoomSceneId gtk_panzoom_scene_add(GtkPanZoomScene* scene,
+                                        GtkPanZoomPrimitiveKind kind,
+                                        uint32_t style_id, const double* xy,
+                                        size_t n, double radius,
+                                        const char* text);
+
+GtkPanZoomSceneId gtk_panzoom_scene_add_point(GtkPanZoomScene* scene,
+                                              uint32_t style_id, double x,
+                                              double y);
+GtkPanZoomSceneId gtk_panzoom_scene_add_polyline(GtkPanZoomScene* scene,
+                                                 uint32_t style_id,
+                                                 const double* xy, size_t n);
+GtkPanZoomSceneId gtk_panzoom_scene_add_polygon(GtkPanZoomScene* scene,
+                                                uint32_t style_id,
+                                                const double* xy, size_t n);
+GtkPanZoomSceneId gtk_panzoom_scene_add_circle(GtkPanZoomScene* scene,
+                                               uint32_t style_id, double x,
+                                               double y, double radius);
+GtkPanZoomSceneId gtk_panzoom_scene_add_text(GtkPanZoomScene* scene,
+                                             uint32_t style_id, double x,
+                                             double y, const char* text);
+
+/// Bulk insert `n` points stored as interleaved (x, y) pairs. If `ids` is
+/// not NULL it receives the `n` new ids.
+void gtk_panzoom_scene_add_points(GtkPanZoomScene* scene, uint32_t style_id,
+                                  const double* xy, size_t n,
+                                  GtkPanZoomSceneId* ids);
+
+/// Replace the coordinates of a primitive (see gtk_panzoom_scene_add() for
+/// the layout of `xy`). Returns zero if `id` is not in the scene or `n` is
+/// invalid for the kind of primitive.
+int gtk_panzoom_scene_set_coords(GtkPanZoomScene* scene, GtkPanZoomSceneId id,
+                                 const double* xy, size_t n);
+
+/// Change the style of a primitive. Returns zero if `id` is not in the scene.
+int gtk_panzoom_scene_set_primitive_style(GtkPanZoomScene* scene,
+                                          GtkPanZoomSceneId id,
+                                          uint32_t style_id);
+
+/// Remove a primitive. Returns zero if `id` is not in the scene.
+int gtk_panzoom_scene_remove(GtkPanZoomScene* scene, GtkPanZoomSceneId id);
+
+/// Remove all primitives. Styles are retained.
+void gtk_panzoom_scene_clear(GtkPanZoomScene* scene);
+
+/// Return the number of primitives in the scene
+size_t gtk_panzoom_scene_get_count(const GtkPanZoomScene* scene);
+
+/// Get the bounding box of all primitives as (x_min, y_min, x_max, y_max).
+/// Returns zero if the scene is empty.
+int gtk_panzoom_scene_get_bounds(const GtkPanZoomScene* scene,
+                                 double rect[4]);
+
+/// Store the ids of primitives whose bounding boxes intersect `rect`
+/// (x_min, y_min, x_max, y_max) into `ids`, in the order they were added.
+/// At most `capacity` ids are stored. Returns the total number of
+/// intersecting primitives, which may exceed `capacity`.
+size_t gtk_panzoom_scene_query(const GtkPanZoomScene* scene,
+                               const double rect[4], GtkPanZoomSceneId* ids,
+                               size_t capacity);
+
+/// Store the ids of primitives within `tolerance` (in virtual units) of
+/// `point` into `ids`, nearest first. Points and text are measured to their
+/// anchor, polylines to their segments, and polygons and circles to their
+/// boundary (or zero if `point` is inside). Among primitives at the same
+/// distance, the one drawn last (i.e. on top) comes first. At most
+/// `capacity` ids are stored. Returns the total number of primitives within
+/// tolerance, which may exceed `capacity`.
+size_t gtk_panzoom_scene_pick(const GtkPanZoomScene* scene,
+                              const double point[2], double tolerance,
+                              GtkPanZoomSceneId* ids, size_t capacity);
+
+/// Draw the primitives which intersect the visible rectangle of `viewport`
+/// (and the clip of `cr`). The transformation of `cr` must already map the
+/// virtual plane to device pixels of `viewport` (see
+/// gtk_panzoom_viewport_apply()). Primitives are drawn in the order they were
+/// added. Text is culled by its anchor, with a margin of one font size.
+void gtk_panzoom_scene_draw(const GtkPanZoomScene* scene, cairo_t* cr,
+                            const GtkPanZoomViewport* viewport);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
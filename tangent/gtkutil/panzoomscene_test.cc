@@ -0,0 +1,301 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/gtkutil/panzoomscene.h"
+
+namespace {
+
+// What the test knows about each primitive in the scene
+struct Model {
+  double box[4];  ///< x_min, y_min, x_max, y_max
+};
+
+class SceneFuzz {
+ public:
+  explicit SceneFuzz(GtkPanZoomScene* scene) : scene_(scene), rng_(0) {}
+
+  // Add, move, or remove a random primitive
+  void step() {
+    std::uniform_int_distribution<int> op_dist(0, 9);
+    int op = op_dist(rng_);
+    if (models_.empty() || op < 6) {
+      add();
+    } else if (op < 8) {
+      move(pick_id());
+    } else {
+      GtkPanZoomSceneId id = pick_id();
+      ASSERT_TRUE(gtk_panzoom_scene_remove(scene_, id));
+      models_.erase(id);
+    }
+  }
+
+  // Compare the result of a random query against a linear scan
+  void check_query() {
+    double corner[2] = {coord(), coord()};
+    std::uniform_real_distribution<double> size_dist(0, 30);
+    double rect[4] = {corner[0], corner[1], corner[0] + size_dist(rng_),
+                      corner[1] + size_dist(rng_)};
+
+    // std::map iterates in order of id, which is the order of insertion
+    std::vector<GtkPanZoomSceneId> expect;
+    for (const auto& pair : models_) {
+      const double* box = pair.second.box;
+      if (box[0] <= rect[2] && rect[0] <= box[2] && box[1] <= rect[3] &&
+          rect[1] <= box[3]) {
+        expect.push_back(pair.first);
+      }
+    }
+
+    std::vector<GtkPanZoomSceneId> actual(models_.size() + 1);
+    size_t count = gtk_panzoom_scene_query(scene_, rect, actual.data(),
+                                           actual.size());
+    ASSERT_EQ(count, expect.size());
+    actual.resize(count);
+    EXPECT_EQ(actual, expect);
+
+    // A short buffer receives a prefix, and the total is still returned
+    if (count > 1) {
+      std::vector<GtkPanZoomSceneId> prefix(count / 2);
+      EXPECT_EQ(gtk_panzoom_scene_query(scene_, rect, prefix.data(),
+                                        prefix.size()),
+                count);
+      EXPECT_TRUE(std::equal(prefix.begin(), prefix.end(), expect.begin()));
+    }
+  }
+
+  void check_bounds() {
+    ASSERT_EQ(gtk_panzoom_scene_get_count(scene_), models_.size());
+    double rect[4];
+    if (models_.empty()) {
+      EXPECT_FALSE(gtk_panzoom_scene_get_bounds(scene_, rect));
+      return;
+    }
+    double expect[4] = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+    for (const auto& pair : models_) {
+      const double* box = pair.second.box;
+      expect[0] = std::min(expect[0], box[0]);
+      expect[1] = std::min(expect[1], box[1]);
+      expect[2] = std::max(expect[2], box[2]);
+      expect[3] = std::max(expect[3], box[3]);
+    }
+    ASSERT_TRUE(gtk_panzoom_scene_get_bounds(scene_, rect));
+    for (size_t idx = 0; idx < 4; idx++) {
+      EXPECT_EQ(rect[idx], expect[idx]);
+    }
+  }
+
+  size_t get_count() const {
+    return models_.size();
+  }
+
+ private:
+  double coord() {
+    std::uniform_real_distribution<double> dist(-100, 100);
+    return dist(rng_);
+  }
+
+  GtkPanZoomSceneId pick_id() {
+    std::uniform_int_distribution<size_t> dist(0, models_.size() - 1);
+    auto iter = models_.begin();
+    std::advance(iter, dist(rng_));
+    return iter->first;
+  }
+
+  // Generate random coordinates for a point, a circle, or a polyline of up
+  // to four vertices, and the bounding box of the primitive
+  void generate(GtkPanZoomPrimitiveKind kind, std::vector<double>* xy,
+                double* radius, Model* model) {
+    size_t npoints = 1;
+    if (kind == GTK_PANZOOM_PRIMITIVE_POLYLINE) {
+      npoints = std::uniform_int_distribution<size_t>(2, 4)(rng_);
+    }
+    xy->resize(2 * npoints);
+    (*xy)[0] = coord();
+    (*xy)[1] = coord();
+    std::uniform_real_distribution<double> step_dist(-10, 10);
+    for (size_t idx = 2; idx < xy->size(); idx++) {
+      (*xy)[idx] = (*xy)[idx - 2] + step_dist(rng_);
+    }
+    *radius = 0;
+    if (kind == GTK_PANZOOM_PRIMITIVE_CIRCLE) {
+      *radius = std::uniform_real_distribution<double>(0, 5)(rng_);
+    }
+    model->box[0] = model->box[2] = (*xy)[0];
+    model->box[1] = model->box[3] = (*xy)[1];
+    for (size_t idx = 0; idx < xy->size(); idx += 2) {
+      model->box[0] = std::min(model->box[0], (*xy)[idx]);
+      model->box[1] = std::min(model->box[1], (*xy)[idx + 1]);
+      model->box[2] = std::max(model->box[2], (*xy)[idx]);
+      model->box[3] = std::max(model->box[3], (*xy)[idx + 1]);
+    }
+    model->box[0] -= *radius;
+    model->box[1] -= *radius;
+    model->box[2] += *radius;
+    model->box[3] += *radius;
+  }
+
+  void add() {
+    const GtkPanZoomPrimitiveKind kKinds[] = {GTK_PANZOOM_PRIMITIVE_POINT,
+                                              GTK_PANZOOM_PRIMITIVE_POLYLINE,
+                                              GTK_PANZOOM_PRIMITIVE_CIRCLE};
+    GtkPanZoomPrimitiveKind kind =
+        kKinds[std::uniform_int_distribution<int>(0, 2)(rng_)];
+    std::vector<double> xy;
+    double radius = 0;
+    Model model;
+    generate(kind, &xy, &radius, &model);
+    GtkPanZoomSceneId id = gtk_panzoom_scene_add(
+        scene_, kind, 0, xy.data(), xy.size() / 2, radius, nullptr);
+    ASSERT_NE(id, 0u);
+    // Ids increase, so that sorting by id sorts by order of insertion
+    if (!models_.empty()) {
+      ASSERT_GT(id, models_.rbegin()->first);
+    }
+    models_[id] = model;
+    kinds_[id] = kind;
+    radii_[id] = radius;
+  }
+
+  // Move a primitive to new random coordinates of the same shape. It keeps
+  // its place in the order of insertion.
+  void move(GtkPanZoomSceneId id) {
+    GtkPanZoomPrimitiveKind kind = kinds_[id];
+    std::vector<double> xy;
+    double radius = 0;
+    Model model;
+    generate(kind, &xy, &radius, &model);
+    if (kind == GTK_PANZOOM_PRIMITIVE_CIRCLE) {
+      // set_coords() keeps the radius
+      radius = radii_[id];
+      model.box[0] = xy[0] - radius;
+      model.box[1] = xy[1] - radius;
+      model.box[2] = xy[0] + radius;
+      model.box[3] = xy[1] + radius;
+    }
+    ASSERT_TRUE(
+        gtk_panzoom_scene_set_coords(scene_, id, xy.data(), xy.size() / 2));
+    models_[id] = model;
+  }
+
+  GtkPanZoomScene* scene_;
+  std::mt19937 rng_;
+  std::map<GtkPanZoomSceneId, Model> models_;
+  std::map<GtkPanZoomSceneId, GtkPanZoomPrimitiveKind> kinds_;
+  std::map<GtkPanZoomSceneId, double> radii_;
+};
+
+// Pick at (x, y) and return all of the hits
+std::vector<GtkPanZoomSceneId> pick(GtkPanZoomScene* scene, double x, double y,
+                                    double tolerance) {
+  double point[2] = {x, y};
+  std::vector<GtkPanZoomSceneId> ids(16);
+  size_t count =
+      gtk_panzoom_scene_pick(scene, point, tolerance, ids.data(), ids.size());
+  ids.resize(std::min(count, ids.size()));
+  return ids;
+}
+
+}  // namespace
+
+TEST(PanZoomScene, QueryMatchesLinearScan) {
+  GtkPanZoomScene* scene = gtk_panzoom_scene_new();
+  SceneFuzz fuzz(scene);
+  for (int iter = 0; iter < 4000; iter++) {
+    fuzz.step();
+    if (iter % 16 == 0) {
+      fuzz.check_query();
+      fuzz.check_bounds();
+    }
+    if (::testing::Test::HasFatalFailure()) {
+      break;
+    }
+  }
+  EXPECT_GT(fuzz.get_count(), 100u);
+  for (int iter = 0; iter < 100; iter++) {
+    fuzz.check_query();
+  }
+
+  gtk_panzoom_scene_clear(scene);
+  EXPECT_EQ(gtk_panzoom_scene_get_count(scene), 0u);
+  double rect[4] = {-1e9, -1e9, 1e9, 1e9};
+  EXPECT_EQ(gtk_panzoom_scene_query(scene, rect, nullptr, 0), 0u);
+  gtk_panzoom_scene_free(scene);
+}
+
+TEST(PanZoomScene, QueryReturnsInsertionOrder) {
+  GtkPanZoomScene* scene = gtk_panzoom_scene_new();
+  // Insert along a diagonal in an order which is unrelated to position
+  std::vector<GtkPanZoomSceneId> added;
+  for (int idx = 0; idx < 64; idx++) {
+    int pos = (idx * 37) % 64;
+    added.push_back(gtk_panzoom_scene_add_point(scene, 0, pos, pos));
+  }
+  // Moving a primitive does not change its place in the order
+  double xy[2] = {100, 100};
+  ASSERT_TRUE(gtk_panzoom_scene_set_coords(scene, added[3], xy, 1));
+  ASSERT_TRUE(gtk_panzoom_scene_remove(scene, added[10]));
+  added.erase(added.begin() + 10);
+
+  double rect[4] = {-1, -1, 200, 200};
+  std::vector<GtkPanZoomSceneId> ids(added.size());
+  ASSERT_EQ(gtk_panzoom_scene_query(scene, rect, ids.data(), ids.size()),
+            added.size());
+  EXPECT_EQ(ids, added);
+
+  // Invalid ids and coordinates are rejected
+  EXPECT_FALSE(gtk_panzoom_scene_remove(scene, added[0] + 1000));
+  EXPECT_FALSE(gtk_panzoom_scene_set_coords(scene, added[0] + 1000, xy, 1));
+  double line[2] = {0, 0};
+  EXPECT_EQ(gtk_panzoom_scene_add_polyline(scene, 0, line, 1), 0u);
+  gtk_panzoom_scene_free(scene);
+}
+
+TEST(PanZoomScene, PickOrder) {
+  GtkPanZoomScene* scene = gtk_panzoom_scene_new();
+  const double kSquare[8] = {0, 0, 10, 0, 10, 10, 0, 10};
+  const double kInner[8] = {2, 2, 8, 2, 8, 8, 2, 8};
+  const double kLine[4] = {0, 12, 10, 12};
+  GtkPanZoomSceneId square =
+      gtk_panzoom_scene_add_polygon(scene, 0, kSquare, 4);
+  GtkPanZoomSceneId point = gtk_panzoom_scene_add_point(scene, 0, 3, 3);
+  GtkPanZoomSceneId inner = gtk_panzoom_scene_add_polygon(scene, 0, kInner, 4);
+  GtkPanZoomSceneId line = gtk_panzoom_scene_add_polyline(scene, 0, kLine, 2);
+  GtkPanZoomSceneId circle = gtk_panzoom_scene_add_circle(scene, 0, 20, 0, 5);
+
+  // Inside both polygons and on the point, all at distance zero, so the
+  // top-most (last added) comes first
+  EXPECT_EQ(pick(scene, 3, 3, 0.5),
+            (std::vector<GtkPanZoomSceneId>{inner, point, square}));
+
+  // Inside the outer polygon only, 1 from the inner one and 2 from the point
+  EXPECT_EQ(pick(scene, 1, 3, 2.5),
+            (std::vector<GtkPanZoomSceneId>{square, inner, point}));
+
+  // Nearest first, regardless of the order of insertion: 0.5 from the line
+  // and 1.5 from the top edge of the square
+  EXPECT_EQ(pick(scene, 5, 11.5, 2.0),
+            (std::vector<GtkPanZoomSceneId>{line, square}));
+  EXPECT_EQ(pick(scene, 5, 11.5, 1.0),
+            (std::vector<GtkPanZoomSceneId>{line}));
+
+  // Inside the circle is distance zero, outside it is measured to the
+  // boundary
+  EXPECT_EQ(pick(scene, 21, 1, 0.0),
+            (std::vector<GtkPanZoomSceneId>{circle}));
+  EXPECT_EQ(pick(scene, 26, 0, 0.5), (std::vector<GtkPanZoomSceneId>{}));
+  EXPECT_EQ(pick(scene, 26, 0, 1.0),
+            (std::vector<GtkPanZoomSceneId>{circle}));
+
+  // A short buffer receives the nearest, and the total is returned
+  double point_xy[2] = {3, 3};
+  GtkPanZoomSceneId nearest = 0;
+  EXPECT_EQ(gtk_panzoom_scene_pick(scene, point_xy, 0.5, &nearest, 1), 3u);
+  EXPECT_EQ(nearest, inner);
+  gtk_panzoom_scene_free(scene);
+}
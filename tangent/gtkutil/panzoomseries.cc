@@ -0,0 +1,210 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/gtkutil/panzoomseries.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+/// Number of samples summarized by each entry of the bottom of the pyramid.
+/// Ranges are resolved to this granularity by scanning the raw samples.
+const size_t kBlockSize = 64;
+
+// Minimum and maximum of y over some range of samples, along with the index
+// at which each occurs
+struct Extrema {
+  void merge(const Extrema& other) {
+    if (other.min < min || (other.min == min && other.imin < imin)) {
+      min = other.min;
+      imin = other.imin;
+    }
+    if (other.max > max || (other.max == max && other.imax < imax)) {
+      max = other.max;
+      imax = other.imax;
+    }
+  }
+
+  void merge(const double* y, size_t begin, size_t end) {
+    for (size_t idx = begin; idx < end; idx++) {
+      merge(Extrema{y[idx], y[idx], idx, idx});
+    }
+  }
+
+  double min;
+  double max;
+  size_t imin;
+  size_t imax;
+};
+
+const Extrema kEmpty = {INFINITY, -INFINITY, 0, 0};
+
+}  // namespace
+
+struct _GtkPanZoomSeries {
+  // Return the extrema of y over samples [begin, end)
+  Extrema query(size_t begin, size_t end) const {
+    Extrema out = kEmpty;
+    // Scan the unaligned head and tail of the range
+    size_t head_end = std::min(end, (begin + kBlockSize - 1) / kBlockSize *
+                                        kBlockSize);
+    out.merge(y, begin, head_end);
+    if (head_end >= end) {
+      return out;
+    }
+    size_t tail_begin = std::max(head_end, end / kBlockSize * kBlockSize);
+    out.merge(y, tail_begin, end);
+
+    // The aligned middle is covered by entries of the pyramid. Entry j of
+    // level k + 1 is the union of entries 2j and 2j + 1 of level k.
+    size_t first = head_end / kBlockSize;
+    size_t last = tail_begin / kBlockSize;
+    for (size_t level = 0; first < last; level++) {
+      if (first & 1) {
+        out.merge(levels[level][first++]);
+      }
+      if (last & 1) {
+        out.merge(levels[level][--last]);
+      }
+      first >>= 1;
+      last >>= 1;
+    }
+    return out;
+  }
+
+  const double* x;
+  const double* y;
+  size_t n;
+  std::vector<std::vector<Extrema>> levels;
+};
+
+GtkPanZoomSeries* gtk_panzoom_series_new(const double* x, const double* y,
+                                         size_t n) {
+  GtkPanZoomSeries* series = new GtkPanZoomSeries();
+  series->x = x;
+  series->y = y;
+  series->n = n;
+
+  std::vector<Extrema> level((n + kBlockSize - 1) / kBlockSize);
+  for (size_t idx = 0; idx < level.size(); idx++) {
+    level[idx] = kEmpty;
+    level[idx].merge(y, idx * kBlockSize, std::min(n, (idx + 1) * kBlockSize));
+  }
+  while (level.size() > 1) {
+    std::vector<Extrema> parent((level.size() + 1) / 2);
+    for (size_t idx = 0; idx < parent.size(); idx++) {
+      parent[idx] = level[2 * idx];
+      if (2 * idx + 1 < level.size()) {
+        parent[idx].merge(level[2 * idx + 1]);
+      }
+    }
+    series->levels.emplace_back();
+    series->levels.back().swap(level);
+    level.swap(parent);
+  }
+  series->levels.emplace_back();
+  series->levels.back().swap(level);
+  return series;
+}
+
+void gtk_panzoom_series_free(GtkPanZoomSeries* series) {
+  delete series;
+}
+
+size_t gtk_panzoom_series_get_count(const GtkPanZoomSeries* series) {
+  return series->n;
+}
+
+int gtk_panzoom_series_get_extrema(const GtkPanZoomSeries* series,
+                                   size_t begin, size_t end, double out[2]) {
+  end = std::min(end, series->n);
+  if (begin >= end) {
+    return 0;
+  }
+  Extrema extrema = series->query(begin, end);
+  out[0] = extrema.min;
+  out[1] = extrema.max;
+  return 1;
+}
+
+size_t gtk_panzoom_series_decimate(const GtkPanZoomSeries* series,
+                                   double x_min, double x_max, double x_step,
+                                   double* xy, size_t capacity) {
+  const double* x = series->x;
+  const double* y = series->y;
+  size_t n = series->n;
+  if (n == 0 || !(x_step > 0) || !(x_max >= x_min)) {
+    return 0;
+  }
+
+  size_t begin = std::lower_bound(x, x + n, x_min) - x;
+  size_t end = std::upper_bound(x, x + n, x_max) - x;
+  begin = begin > 0 ? begin - 1 : begin;
+  end = std::min(n, end + 1);
+
+  size_t count = 0;
+  auto emit = [&](size_t idx) {
+    if (count < capacity) {
+      xy[2 * count + 0] = x[idx];
+      xy[2 * count + 1] = y[idx];
+    }
+    count++;
+  };
+
+  size_t column_begin = begin;
+  while (column_begin < end) {
+    // Find the samples within the same pixel column as `column_begin`
+    double column = std::floor((x[column_begin] - x_min) / x_step);
+    double column_x_end = x_min + (column + 1) * x_step;
+    size_t column_end =
+        std::lower_bound(x + column_begin, x + end, column_x_end) - x;
+    column_end = std::max(column_end, column_begin + 1);
+
+    if (column_end - column_begin <= 4) {
+      for (size_t idx = column_begin; idx < column_end; idx++) {
+        emit(idx);
+      }
+    } else {
+      Extrema extrema = series->query(column_begin, column_end);
+      size_t keep[4] = {column_begin, extrema.imin, extrema.imax,
+                        column_end - 1};
+      std::sort(keep, keep + 4);
+      for (size_t idx = 0; idx < 4; idx++) {
+        if (idx == 0 || keep[idx] != keep[idx - 1]) {
+          emit(keep[idx]);
+        }
+      }
+    }
+    column_begin = column_end;
+  }
+  return count;
+}
+
+void gtk_panzoom_series_append_path(const GtkPanZoomSeries* series,
+                                    cairo_t* cr,
+                                    const GtkPanZoomViewport* viewport) {
+  double pixel_size = gtk_panzoom_viewport_get_pixel_size(viewport);
+  double visible[4] = {0, 0, 0, 0};
+  gtk_panzoom_viewport_get_visible_rect(viewport, visible);
+
+  // At most four points for each visible column, plus the column on either
+  // side and the partial columns at each end
+  size_t capacity = 4 * (static_cast<size_t>(viewport->width) + 4);
+  std::vector<double> xy(2 * capacity);
+  size_t count = gtk_panzoom_series_decimate(
+      series, visible[0], visible[2], pixel_size, xy.data(), capacity);
+  if (count > capacity) {
+    xy.resize(2 * count);
+    count = gtk_panzoom_series_decimate(series, visible[0], visible[2],
+                                        pixel_size, xy.data(), count);
+  }
+  if (count == 0) {
+    return;
+  }
+
+  cairo_new_sub_path(cr);
+  cairo_move_to(cr, xy[0], xy[1]);
+  for (size_t idx = 1; idx < count; idx++) {
+    cairo_line_to(cr, xy[2 * idx], xy[2 * idx + 1]);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <stddef.h>
+
+#include <cairo/cairo.h>
+
+#include "tangent/gtkutil/panzoomviewport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A series of samples (x[i], y[i]) with non-decreasing x, such as a time
+/// series, along with a multi-resolution pyramid of the minimum and maximum
+/// of y over blocks of samples. The pyramid allows the series to be reduced
+/// to at most four points (first, min, max, last) per pixel column in time
+/// proportional to the number of visible columns rather than the number of
+/// samples, which produces the same image as drawing every sample.
+typedef struct _GtkPanZoomSeries GtkPanZoomSeries;
+
+/// Build the pyramid for `n` samples. The series does not copy `x` or `y`,
+/// which must remain valid and unmodified for the lifetime of the series.
+/// `x` must be non-decreasing and all values must be finite.
+GtkPanZoomSeries* gtk_panzoom_series_new(const double* x, const double* y,
+                                         size_t n);
+void gtk_panzoom_series_free(GtkPanZoomSeries* series);
+
+/// Return the number of samples in the series
+size_t gtk_panzoom_series_get_count(const GtkPanZoomSeries* series);
+
+/// Get the range of y over the samples with index in [begin, end) as
+/// (min, max). Returns zero if the range is empty.
+int gtk_panzoom_series_get_extrema(const GtkPanZoomSeries* series,
+                                   size_t begin, size_t end, double out[2]);
+
+/// Reduce the samples with x in [x_min, x_max] (plus one sample on either
+/// side, so that lines leaving the range are drawn) to at most four points
+/// per column of width `x_step`, and store them as interleaved (x, y) pairs
+/// in `xy`, in order of increasing x. At most `capacity` points are stored.
+/// Returns the total number of points, which may exceed `capacity`.
+size_t gtk_panzoom_series_decimate(const GtkPanZoomSeries* series,
+                                   double x_min, double x_max, double x_step,
+                                   double* xy, size_t capacity);
+
+/// Append the series, decimated to the pixel columns of `viewport`, to the
+/// current path of `cr` as a new sub-path. The transformation of `cr` must
+/// map the virtual plane to device pixels of `viewport` (see
+/// gtk_panzoom_viewport_apply()).
+void gtk_panzoom_series_append_path(const GtkPanZoomSeries* series,
+                                    cairo_t* cr,
+                                    const GtkPanZoomViewport* viewport);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,230 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/gtkutil/panzoomseries.h"
+
+namespace {
+
+std::vector<double> make_samples(size_t n, std::mt19937* rng) {
+  std::normal_distribution<double> dist(0, 1);
+  std::vector<double> y(n);
+  for (double& value : y) {
+    value = dist(*rng);
+  }
+  return y;
+}
+
+// Check get_extrema() over [begin, end) against a linear scan
+void check_extrema(const GtkPanZoomSeries* series, const std::vector<double>& y,
+                   size_t begin, size_t end) {
+  double out[2] = {0, 0};
+  if (begin >= end) {
+    EXPECT_FALSE(gtk_panzoom_series_get_extrema(series, begin, end, out));
+    return;
+  }
+  ASSERT_TRUE(gtk_panzoom_series_get_extrema(series, begin, end, out))
+      << "[" << begin << ", " << end << ")";
+  EXPECT_EQ(out[0], *std::min_element(y.begin() + begin, y.begin() + end))
+      << "[" << begin << ", " << end << ")";
+  EXPECT_EQ(out[1], *std::max_element(y.begin() + begin, y.begin() + end))
+      << "[" << begin << ", " << end << ")";
+}
+
+// Decimate the series, retrying with a larger buffer if needed
+std::vector<double> decimate(const GtkPanZoomSeries* series, double x_min,
+                             double x_max, double x_step) {
+  std::vector<double> xy(2 * 16);
+  size_t count = gtk_panzoom_series_decimate(series, x_min, x_max, x_step,
+                                             xy.data(), xy.size() / 2);
+  if (count > xy.size() / 2) {
+    xy.resize(2 * count);
+    EXPECT_EQ(gtk_panzoom_series_decimate(series, x_min, x_max, x_step,
+                                          xy.data(), count),
+              count);
+  }
+  xy.resize(2 * count);
+  return xy;
+}
+
+}  // namespace
+
+TEST(PanZoomSeries, ExtremaMatchesLinearScan) {
+  std::mt19937 rng(0);
+  const size_t kSizes[] = {0, 1, 37, 63, 64, 65, 200, 64 * 1024 + 1};
+  for (size_t n : kSizes) {
+    std::vector<double> y = make_samples(n, &rng);
+    std::vector<double> x(n);
+    for (size_t idx = 0; idx < n; idx++) {
+      x[idx] = static_cast<double>(idx);
+    }
+    GtkPanZoomSeries* series = gtk_panzoom_series_new(x.data(), y.data(), n);
+    ASSERT_EQ(gtk_panzoom_series_get_count(series), n);
+
+    if (n <= 200) {
+      // Every range, aligned or not
+      for (size_t begin = 0; begin <= n; begin++) {
+        for (size_t end = begin; end <= n; end++) {
+          check_extrema(series, y, begin, end);
+        }
+      }
+    } else {
+      std::uniform_int_distribution<size_t> dist(0, n);
+      for (int iter = 0; iter < 1000; iter++) {
+        size_t begin = dist(rng);
+        size_t end = dist(rng);
+        check_extrema(series, y, std::min(begin, end), std::max(begin, end));
+      }
+      check_extrema(series, y, 0, n);
+      check_extrema(series, y, 1, n);
+      check_extrema(series, y, 0, n - 1);
+      check_extrema(series, y, 63, n - 63);
+    }
+
+    // The end is clamped to the count
+    if (n > 0) {
+      double out[2];
+      ASSERT_TRUE(gtk_panzoom_series_get_extrema(series, 0, n + 10, out));
+      EXPECT_EQ(out[0], *std::min_element(y.begin(), y.end()));
+      EXPECT_EQ(out[1], *std::max_element(y.begin(), y.end()));
+    }
+    gtk_panzoom_series_free(series);
+  }
+}
+
+TEST(PanZoomSeries, DecimateKeepsColumnExtrema) {
+  // Samples with strictly increasing x and irregular spacing, so that some
+  // columns are dense, some hold a few samples, and some are empty
+  std::mt19937 rng(1);
+  const size_t kCount = 20000;
+  std::exponential_distribution<double> gap_dist(1.0);
+  std::vector<double> x(kCount);
+  std::vector<double> y = make_samples(kCount, &rng);
+  x[0] = 0;
+  for (size_t idx = 1; idx < kCount; idx++) {
+    double scale = (idx / 1000) % 2 ? 1.0 : 0.01;
+    x[idx] = x[idx - 1] + 1e-6 + scale * gap_dist(rng);
+  }
+  GtkPanZoomSeries* series =
+      gtk_panzoom_series_new(x.data(), y.data(), kCount);
+
+  const double kRanges[][3] = {
+      {x[0] - 1, x[kCount - 1] + 1, 1.0},
+      {x[100], x[5000], 0.5},
+      {x[3500] + 0.25, x[12345] - 0.25, 3.0},
+      {x[7000], x[7001], 0.01},
+  };
+  for (const auto& range : kRanges) {
+    double x_min = range[0];
+    double x_max = range[1];
+    double x_step = range[2];
+    std::vector<double> xy = decimate(series, x_min, x_max, x_step);
+    ASSERT_GE(xy.size(), 4u);
+
+    // Map each point back to its sample and check that x is non-decreasing
+    std::vector<size_t> indices;
+    for (size_t idx = 0; idx < xy.size(); idx += 2) {
+      size_t sample = std::lower_bound(x.begin(), x.end(), xy[idx]) - x.begin();
+      ASSERT_LT(sample, kCount);
+      ASSERT_EQ(x[sample], xy[idx]);
+      EXPECT_EQ(y[sample], xy[idx + 1]);
+      if (!indices.empty()) {
+        ASSERT_GT(sample, indices.back());
+      }
+      indices.push_back(sample);
+    }
+
+    // One sample on either side of the range is included, if it exists
+    size_t begin = std::lower_bound(x.begin(), x.end(), x_min) - x.begin();
+    size_t end = std::upper_bound(x.begin(), x.end(), x_max) - x.begin();
+    begin = begin > 0 ? begin - 1 : 0;
+    end = std::min(kCount, end + 1);
+    EXPECT_EQ(indices.front(), begin);
+    EXPECT_EQ(indices.back(), end - 1);
+
+    // Group the samples of [begin, end) and the output by column
+    std::map<int64_t, std::vector<size_t>> samples_by_column;
+    std::map<int64_t, std::vector<size_t>> kept_by_column;
+    for (size_t idx = begin; idx < end; idx++) {
+      int64_t column = std::floor((x[idx] - x_min) / x_step);
+      samples_by_column[column].push_back(idx);
+    }
+    for (size_t idx : indices) {
+      int64_t column = std::floor((x[idx] - x_min) / x_step);
+      kept_by_column[column].push_back(idx);
+    }
+    ASSERT_EQ(kept_by_column.size(), samples_by_column.size());
+
+    for (const auto& pair : samples_by_column) {
+      const std::vector<size_t>& samples = pair.second;
+      const std::vector<size_t>& kept = kept_by_column[pair.first];
+      ASSERT_LE(kept.size(), 4u);
+      ASSERT_FALSE(kept.empty());
+
+      // The first and last sample of each column are kept, so that lines
+      // between columns are unchanged
+      EXPECT_EQ(kept.front(), samples.front());
+      EXPECT_EQ(kept.back(), samples.back());
+
+      // The exact minimum and maximum of each column are kept
+      double min = INFINITY;
+      double max = -INFINITY;
+      for (size_t idx : samples) {
+        min = std::min(min, y[idx]);
+        max = std::max(max, y[idx]);
+      }
+      double kept_min = INFINITY;
+      double kept_max = -INFINITY;
+      for (size_t idx : kept) {
+        kept_min = std::min(kept_min, y[idx]);
+        kept_max = std::max(kept_max, y[idx]);
+      }
+      EXPECT_EQ(kept_min, min);
+      EXPECT_EQ(kept_max, max);
+      if (samples.size() <= 4) {
+        EXPECT_EQ(kept, samples);
+      }
+    }
+  }
+  gtk_panzoom_series_free(series);
+}
+
+TEST(PanZoomSeries, DecimateReturnsTotalCount) {
+  // Repeated values of x are allowed
+  std::vector<double> x = {0, 1, 1, 1, 2, 3, 3, 4, 5, 6, 7, 8, 9};
+  std::vector<double> y = {0, 5, -5, 2, 1, 7, 0, 3, 1, 4, 1, 5, 9};
+  GtkPanZoomSeries* series =
+      gtk_panzoom_series_new(x.data(), y.data(), x.size());
+  std::vector<double> full = decimate(series, 0, 9, 0.5);
+  ASSERT_EQ(full.size(), 2 * x.size());
+  for (size_t idx = 2; idx < full.size(); idx += 2) {
+    EXPECT_GE(full[idx], full[idx - 2]);
+  }
+
+  // A short buffer receives a prefix, and the total count is returned
+  size_t count = full.size() / 2;
+  EXPECT_EQ(gtk_panzoom_series_decimate(series, 0, 9, 0.5, nullptr, 0),
+            count);
+  std::vector<double> prefix(6);
+  EXPECT_EQ(gtk_panzoom_series_decimate(series, 0, 9, 0.5, prefix.data(), 3),
+            count);
+  EXPECT_TRUE(std::equal(prefix.begin(), prefix.end(), full.begin()));
+
+  // Neighbours outside of the range are included
+  std::vector<double> inner = decimate(series, 4.5, 6.5, 0.5);
+  EXPECT_EQ(inner, (std::vector<double>{4, 3, 5, 1, 6, 4, 7, 1}));
+
+  // Degenerate arguments produce nothing
+  EXPECT_EQ(decimate(series, 9, 0, 1).size(), 0u);
+  EXPECT_EQ(decimate(series, 0, 9, 0).size(), 0u);
+  gtk_panzoom_series_free(series);
+
+  GtkPanZoomSeries* empty = gtk_panzoom_series_new(nullptr, nullptr, 0);
+  EXPECT_EQ(decimate(empty, 0, 1, 1).size(), 0u);
+  gtk_panzoom_series_free(empty);
+}
@@ -3,6 +3,9 @@
 #include "tangent/gtkutil/panzoomview.h"
 
 #include <algorithm>
+#include <cstdlib>
+
+#include "tangent/gtkutil/pngwriter.h"
 
 namespace Gtk {
 
@@ -88,6 +91,26 @@ double PanZoomView::GetMaxDim() {
   return std::max(get_allocated_width(), get_allocated_height());
 }
 
+double PanZoomView::GetPixelSize() {
+  return GetScale() / GetMaxDim();
+}
+
+Eigen::AlignedBox2d PanZoomView::GetVisibleRect() {
+  Eigen::Vector2d size(get_allocated_width(), get_allocated_height());
+  return Eigen::AlignedBox2d(GetOffset(), GetOffset() + size * GetPixelSize());
+}
+
+GtkPanZoomViewport PanZoomView::GetViewport() {
+  Eigen::Vector2d offset = GetOffset();
+  GtkPanZoomViewport viewport;
+  viewport.offset[0] = offset[0];
+  viewport.offset[1] = offset[1];
+  viewport.scale = GetScale();
+  viewport.width = get_allocated_width();
+  viewport.height = get_allocated_height();
+  return viewport;
+}
+
 Eigen::Vector2d PanZoomView::RawPoint(double x, double y) {
   return Eigen::Vector2d(x, get_allocated_height() - y);
 }
@@ -96,6 +119,93 @@ Eigen::Vector2d PanZoomView::TransformPoint(double x, double y) {
   return GetOffset() + RawPoint(x, y) * (GetScale() / GetMaxDim());
 }
 
+Eigen::Matrix2Xd PanZoomView::TransformPoints(const Eigen::Matrix2Xd& points) {
+  double pixel_size = GetPixelSize();
+  Eigen::Vector2d scale(pixel_size, -pixel_size);
+  Eigen::Vector2d translate =
+      GetOffset() + Eigen::Vector2d(0, pixel_size * get_allocated_height());
+  return (scale.asDiagonal() * points).colwise() + translate;
+}
+
+Eigen::Matrix2Xd PanZoomView::InverseTransformPoints(
+    const Eigen::Matrix2Xd& points) {
+  double pixel_size = GetPixelSize();
+  Eigen::Vector2d scale(1.0 / pixel_size, -1.0 / pixel_size);
+  Eigen::Vector2d translate =
+      GetOffset() + Eigen::Vector2d(0, pixel_size * get_allocated_height());
+  return scale.asDiagonal() * (points.colwise() - translate);
+}
+
+void PanZoomView::InvalidateBox(const Eigen::AlignedBox2d& box) {
+  if (box.isEmpty()) {
+    return;
+  }
+  GtkPanZoomViewport viewport = GetViewport();
+  const double rect[4] = {box.min()[0], box.min()[1], box.max()[0],
+                          box.max()[1]};
+  cairo_rectangle_int_t damage;
+  gtk_panzoom_viewport_get_device_rect(&viewport, rect, 1.0, &damage);
+  if (damage.width > 0 && damage.height > 0) {
+    queue_draw_area(damage.x, damage.y, damage.width, damage.height);
+  }
+}
+
+Eigen::AlignedBox2d PanZoomView::GetClipBox(
+    const Cairo::RefPtr<Cairo::Context>& ctx) {
+  double x1 = 0;
+  double y1 = 0;
+  double x2 = 0;
+  double y2 = 0;
+  ctx->get_clip_extents(x1, y1, x2, y2);
+  return GetVisibleRect().intersection(
+      Eigen::AlignedBox2d(Eigen::Vector2d(x1, y1), Eigen::Vector2d(x2, y2)));
+}
+
+namespace {
+
+// Edge length of each tile and height of each band of an export, in pixels
+const int kExportTileSize = 512;
+
+// Render each tile of a band of an export by emitting sig_draw
+void ExportBand(GtkPanZoomExportTile* tiles, size_t ntiles, void* user_data) {
+  PanZoomView* view = static_cast<PanZoomView*>(user_data);
+  for (size_t idx = 0; idx < ntiles; idx++) {
+    auto surface = Cairo::RefPtr<Cairo::Surface>(
+        new Cairo::Surface(tiles[idx].surface, /*has_reference=*/false));
+    auto ctx = Cairo::Context::create(surface);
+    ctx->set_source_rgb(1, 1, 1);
+    ctx->paint();
+    gtk_panzoom_viewport_apply(&tiles[idx].viewport, ctx->cobj());
+    ctx->set_line_width(0.001);
+    view->sig_draw.emit(ctx);
+  }
+}
+
+}  // namespace
+
+bool PanZoomView::ExportPng(const std::string& path,
+                            const Eigen::AlignedBox2d& box, double pixel_size,
+                            std::string* error) {
+  if (box.isEmpty()) {
+    if (error) {
+      *error = "Invalid export region";
+    }
+    return false;
+  }
+  const double rect[4] = {box.min()[0], box.min()[1], box.max()[0],
+                          box.max()[1]};
+  char* message = nullptr;
+  if (!gtk_panzoom_png_export(path.c_str(), rect, pixel_size, kExportTileSize,
+                              ExportBand, this, &message)) {
+    if (error) {
+      *error = message;
+    }
+    free(message);
+    return false;
+  }
+  return true;
+}
+
 bool PanZoomView::on_motion_notify_event(GdkEventMotion* event) {
   Gtk::DrawingArea::on_motion_notify_event(event);
   GdkEventMotion transformed = *event;
@@ -4,6 +4,8 @@
 #include <gtkmm.h>
 #include <Eigen/Dense>
 
+#include "tangent/gtkutil/panzoomviewport.h"
+
 namespace Gtk {
 
 /// A drawing area with built in mouse handlers for pan-zoom control
@@ -63,6 +65,16 @@ class PanZoomView : public Gtk::DrawingArea {
   /// return the maximum dimension of the
   double GetMaxDim();
 
+  /// Return the length (in virtual units) of one device pixel
+  double GetPixelSize();
+
+  /// Return the rectangle of the virtual plane which is currently visible
+  Eigen::AlignedBox2d GetVisibleRect();
+
+  /// Return a snapshot of the current mapping between pixels of the widget
+  /// and the virtual plane, for use with the gtk_panzoom_viewport functions
+  GtkPanZoomViewport GetViewport();
+
   /// Convert the point (x,y) in GTK coordinates, with the origin at the top
   /// left, to a point in traditional cartesian coordinates, where the origin
   /// is at the bottom left.
@@ -72,6 +84,32 @@ class PanZoomView : public Gtk::DrawingArea {
   /// and scaling of the viewport
   Eigen::Vector2d TransformPoint(double x, double y);
 
+  /// Apply TransformPoint() to each column of `points`. The offset, scale and
+  /// allocation are read only once.
+  Eigen::Matrix2Xd TransformPoints(const Eigen::Matrix2Xd& points);
+
+  /// Inverse of TransformPoints(): map each column of `points` from the
+  /// virtual plane to GTK coordinates.
+  Eigen::Matrix2Xd InverseTransformPoints(const Eigen::Matrix2Xd& points);
+
+  /// Queue a redraw of only the device rectangle which covers `box` (plus a
+  /// margin of one pixel for antialiasing), for content within `box` that
+  /// has changed.
+  void InvalidateBox(const Eigen::AlignedBox2d& box);
+
+  /// Return the part of the virtual plane which is visible and within the
+  /// clip of `ctx`, for use in sig_draw handlers to redraw only the damaged
+  /// region.
+  Eigen::AlignedBox2d GetClipBox(const Cairo::RefPtr<Cairo::Context>& ctx);
+
+  /// Render the virtual rectangle `box` at `pixel_size` virtual units per
+  /// pixel to a PNG file at `path` by emitting sig_draw for one tile at a
+  /// time. Rows are encoded one band at a time, so the whole image is never
+  /// held in memory. Returns false on failure, with a description in `error`
+  /// if it is not null.
+  bool ExportPng(const std::string& path, const Eigen::AlignedBox2d& box,
+                 double pixel_size, std::string* error = nullptr);
+
   template <typename Event>
   void TransformEvent(Event* event) {
     Eigen::Vector2d transformed_point = TransformPoint(event->x, event->y);
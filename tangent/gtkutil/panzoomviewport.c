@@ -0,0 +1,104 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/gtkutil/panzoomviewport.h"
+
+#include <math.h>
+
+// Return the larger dimension of the viewport, in pixels. A viewport which
+// has not yet been allocated is treated as a single pixel.
+static double get_max_dim(const GtkPanZoomViewport* viewport) {
+  return fmax(1.0, fmax(viewport->width, viewport->height));
+}
+
+double gtk_panzoom_viewport_get_pixel_size(
+    const GtkPanZoomViewport* viewport) {
+  return viewport->scale / get_max_dim(viewport);
+}
+
+void gtk_panzoom_viewport_get_visible_rect(const GtkPanZoomViewport* viewport,
+                                           double rect[4]) {
+  double pixel_size = gtk_panzoom_viewport_get_pixel_size(viewport);
+  rect[0] = viewport->offset[0];
+  rect[1] = viewport->offset[1];
+  rect[2] = viewport->offset[0] + viewport->width * pixel_size;
+  rect[3] = viewport->offset[1] + viewport->height * pixel_size;
+}
+
+void gtk_panzoom_viewport_get_matrix(const GtkPanZoomViewport* viewport,
+                                     cairo_matrix_t* matrix) {
+  double pixel_size = gtk_panzoom_viewport_get_pixel_size(viewport);
+  cairo_matrix_init(matrix, pixel_size, 0, 0, -pixel_size, viewport->offset[0],
+                    viewport->offset[1] + pixel_size * viewport->height);
+}
+
+// NOTE(josh): The transformation is a scale and translation so we don't need
+// the off-diagonal terms of the matrix. Keeping the loops free of calls lets
+// the compiler vectorize them.
+void gtk_panzoom_viewport_transform_points(const GtkPanZoomViewport* viewport,
+                                           const double* in, double* out,
+                                           size_t n) {
+  cairo_matrix_t matrix;
+  gtk_panzoom_viewport_get_matrix(viewport, &matrix);
+  const double scale[2] = {matrix.xx, matrix.yy};
+  const double translate[2] = {matrix.x0, matrix.y0};
+  for (size_t idx = 0; idx < 2 * n; idx += 2) {
+    out[idx + 0] = scale[0] * in[idx + 0] + translate[0];
+    out[idx + 1] = scale[1] * in[idx + 1] + translate[1];
+  }
+}
+
+void gtk_panzoom_viewport_inverse_transform_points(
+    const GtkPanZoomViewport* viewport, const double* in, double* out,
+    size_t n) {
+  cairo_matrix_t matrix;
+  gtk_panzoom_viewport_get_matrix(viewport, &matrix);
+  const double scale[2] = {1.0 / matrix.xx, 1.0 / matrix.yy};
+  const double translate[2] = {matrix.x0, matrix.y0};
+  for (size_t idx = 0; idx < 2 * n; idx += 2) {
+    out[idx + 0] = scale[0] * (in[idx + 0] - translate[0]);
+    out[idx + 1] = scale[1] * (in[idx + 1] - translate[1]);
+  }
+}
+
+void gtk_panzoom_viewport_get_device_rect(const GtkPanZoomViewport* viewport,
+                                          const double rect[4], double margin,
+                                          cairo_rectangle_int_t* out) {
+  // NOTE(josh): y is flipped, so the top left corner in GTK coordinates is
+  // (x_min, y_max) in the virtual plane
+  double corners[4] = {rect[0], rect[3], rect[2], rect[1]};
+  gtk_panzoom_viewport_inverse_transform_points(viewport, corners, corners, 2);
+  double x_begin = fmax(0.0, floor(corners[0] - margin));
+  double y_begin = fmax(0.0, floor(corners[1] - margin));
+  double x_end = fmin(viewport->width, ceil(corners[2] + margin));
+  double y_end = fmin(viewport->height, ceil(corners[3] + margin));
+  out->x = (int)x_begin;
+  out->y = (int)y_begin;
+  out->width = x_end > x_begin ? (int)(x_end - x_begin) : 0;
+  out->height = y_end > y_begin ? (int)(y_end - y_begin) : 0;
+}
+
+void gtk_panzoom_viewport_get_clip_rect(const GtkPanZoomViewport* viewport,
+                                        cairo_t* cr, double rect[4]) {
+  double clip[4] = {0, 0, 0, 0};
+  cairo_clip_extents(cr, &clip[0], &clip[1], &clip[2], &clip[3]);
+  gtk_panzoom_viewport_get_visible_rect(viewport, rect);
+  rect[0] = fmax(rect[0], clip[0]);
+  rect[1] = fmax(rect[1], clip[1]);
+  rect[2] = fmin(rect[2], clip[2]);
+  rect[3] = fmin(rect[3], clip[3]);
+}
+
+int gtk_panzoom_viewport_equal(const GtkPanZoomViewport* a,
+                               const GtkPanZoomViewport* b) {
+  return a->offset[0] == b->offset[0] && a->offset[1] == b->offset[1] &&
+         a->scale == b->scale && a->width == b->width &&
+         a->height == b->height;
+}
+
+void gtk_panzoom_viewport_apply(const GtkPanZoomViewport* viewport,
+                                cairo_t* cr) {
+  double max_dim = get_max_dim(viewport);
+  double scale = viewport->scale;
+  cairo_scale(cr, max_dim / scale, -max_dim / scale);
+  cairo_translate(cr, 0, -scale * viewport->height / max_dim);
+  cairo_translate(cr, -viewport->offset[0], -viewport->offset[1]);
+}
@@ -0,0 +1,76 @@
+#pragma once
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <stddef.h>
+
+#include <cairo/cairo.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Snapshot of the state which determines the mapping between device pixels
+/// of a GtkPanZoomArea and its virtual cartesian plane. Taking a snapshot
+/// reads the adjustments and the widget allocation once, so the snapshot may
+/// be used to transform many points, or handed to code which must not touch
+/// the widget (e.g. a worker thread).
+typedef struct _GtkPanZoomViewport {
+  double offset[2];  ///< virtual coordinates of the bottom left corner
+  double scale;      ///< length (in virtual units) of the larger dimension
+  int width;         ///< width of the drawing area in pixels
+  int height;        ///< height of the drawing area in pixels
+} GtkPanZoomViewport;
+
+/// Return the length (in virtual units) of one device pixel
+double gtk_panzoom_viewport_get_pixel_size(const GtkPanZoomViewport* viewport);
+
+/// Get the rectangle of the virtual plane which is visible in the viewport,
+/// as (x_min, y_min, x_max, y_max).
+void gtk_panzoom_viewport_get_visible_rect(const GtkPanZoomViewport* viewport,
+                                           double rect[4]);
+
+/// Get the affine transformation which maps GTK coordinates of the viewport
+/// (in pixels, with the origin at the top left) to the virtual plane.
+void gtk_panzoom_viewport_get_matrix(const GtkPanZoomViewport* viewport,
+                                     cairo_matrix_t* matrix);
+
+/// Map `n` points, stored as interleaved (x, y) pairs, from GTK coordinates
+/// of the viewport to the virtual plane. `in` and `out` may be the same
+/// buffer.
+void gtk_panzoom_viewport_transform_points(const GtkPanZoomViewport* viewport,
+                                           const double* in, double* out,
+                                           size_t n);
+
+/// Map `n` points, stored as interleaved (x, y) pairs, from the virtual plane
+/// to GTK coordinates of the viewport. This is the inverse of
+/// gtk_panzoom_viewport_transform_points().
+void gtk_panzoom_viewport_inverse_transform_points(
+    const GtkPanZoomViewport* viewport, const double* in, double* out,
+    size_t n);
+
+/// Get the smallest rectangle of whole pixels, in GTK coordinates of the
+/// viewport, which covers `rect` (x_min, y_min, x_max, y_max) in the virtual
+/// plane grown by `margin` pixels on each side, clipped to the viewport. The
+/// width or height of `out` is zero if no part of `rect` is visible.
+void gtk_panzoom_viewport_get_device_rect(const GtkPanZoomViewport* viewport,
+                                          const double rect[4], double margin,
+                                          cairo_rectangle_int_t* out);
+
+/// Get the part of the virtual plane which is visible and within the clip of
+/// `cr`, as (x_min, y_min, x_max, y_max). The transformation of `cr` must
+/// map the virtual plane to device pixels of `viewport` (as it does in draw
+/// handlers). Handlers may use this to redraw only the damaged region.
+void gtk_panzoom_viewport_get_clip_rect(const GtkPanZoomViewport* viewport,
+                                        cairo_t* cr, double rect[4]);
+
+/// Return true if the two viewports describe the same mapping
+int gtk_panzoom_viewport_equal(const GtkPanZoomViewport* a,
+                               const GtkPanZoomViewport* b);
+
+/// Multiply the current transformation matrix of `cr` such that drawing
+/// commands in the virtual plane map to device pixels of the viewport.
+void gtk_panzoom_viewport_apply(const GtkPanZoomViewport* viewport,
+                                cairo_t* cr);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
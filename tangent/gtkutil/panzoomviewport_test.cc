@@ -0,0 +1,164 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tangent/gtkutil/panzoomviewport.h"
+
+namespace {
+
+const GtkPanZoomViewport kViewport = {{-3.5, 12.25}, 20.0, 640, 480};
+
+// The mapping of gtk_panzoom_area_transform_point(): flip y about the height
+// of the allocation, then scale by scale / max(width, height) and offset.
+void reference_transform(const GtkPanZoomViewport& viewport,
+                         const double in[2], double out[2]) {
+  double max_dim = std::max(viewport.width, viewport.height);
+  double rawpoint[2] = {in[0], viewport.height - in[1]};
+  for (size_t idx = 0; idx < 2; idx++) {
+    out[idx] =
+        viewport.offset[idx] + rawpoint[idx] * (viewport.scale / max_dim);
+  }
+}
+
+}  // namespace
+
+TEST(PanZoomViewport, TransformMatchesPerPointTransform) {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> dist(-100, 700);
+  std::vector<double> in(2 * 101);
+  for (double& value : in) {
+    value = dist(rng);
+  }
+  std::vector<double> out(in.size());
+  gtk_panzoom_viewport_transform_points(&kViewport, in.data(), out.data(),
+                                        in.size() / 2);
+  for (size_t idx = 0; idx < in.size(); idx += 2) {
+    double expect[2];
+    reference_transform(kViewport, &in[idx], expect);
+    EXPECT_NEAR(out[idx + 0], expect[0], 1e-9);
+    EXPECT_NEAR(out[idx + 1], expect[1], 1e-9);
+  }
+
+  // The top left pixel maps to the top left of the visible rectangle, and the
+  // bottom right pixel to the bottom right
+  double rect[4];
+  gtk_panzoom_viewport_get_visible_rect(&kViewport, rect);
+  double corners[4] = {0, 0, 640, 480};
+  gtk_panzoom_viewport_transform_points(&kViewport, corners, corners, 2);
+  EXPECT_NEAR(corners[0], rect[0], 1e-9);
+  EXPECT_NEAR(corners[1], rect[3], 1e-9);
+  EXPECT_NEAR(corners[2], rect[2], 1e-9);
+  EXPECT_NEAR(corners[3], rect[1], 1e-9);
+  EXPECT_DOUBLE_EQ(rect[0], -3.5);
+  EXPECT_DOUBLE_EQ(rect[1], 12.25);
+  EXPECT_DOUBLE_EQ(rect[2], -3.5 + 20.0);
+  EXPECT_DOUBLE_EQ(rect[3], 12.25 + 15.0);
+  EXPECT_DOUBLE_EQ(gtk_panzoom_viewport_get_pixel_size(&kViewport),
+                   20.0 / 640);
+}
+
+TEST(PanZoomViewport, InverseTransformIsInverse) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> dist(-1000, 1000);
+  std::vector<double> in(2 * 64);
+  for (double& value : in) {
+    value = dist(rng);
+  }
+  std::vector<double> virt(in.size());
+  std::vector<double> round_trip(in.size());
+  gtk_panzoom_viewport_transform_points(&kViewport, in.data(), virt.data(),
+                                        in.size() / 2);
+  gtk_panzoom_viewport_inverse_transform_points(
+      &kViewport, virt.data(), round_trip.data(), in.size() / 2);
+  for (size_t idx = 0; idx < in.size(); idx++) {
+    EXPECT_NEAR(round_trip[idx], in[idx], 1e-9);
+  }
+
+  // In place, and starting from the virtual plane
+  std::vector<double> points = in;
+  gtk_panzoom_viewport_inverse_transform_points(&kViewport, points.data(),
+                                                points.data(), in.size() / 2);
+  gtk_panzoom_viewport_transform_points(&kViewport, points.data(),
+                                        points.data(), in.size() / 2);
+  for (size_t idx = 0; idx < in.size(); idx++) {
+    EXPECT_NEAR(points[idx], in[idx], 1e-9);
+  }
+}
+
+TEST(PanZoomViewport, MatrixMatchesTransform) {
+  cairo_matrix_t matrix;
+  gtk_panzoom_viewport_get_matrix(&kViewport, &matrix);
+  double point[2] = {123.0, 45.0};
+  double expect[2];
+  reference_transform(kViewport, point, expect);
+  EXPECT_NEAR(matrix.xx * point[0] + matrix.xy * point[1] + matrix.x0,
+              expect[0], 1e-9);
+  EXPECT_NEAR(matrix.yx * point[0] + matrix.yy * point[1] + matrix.y0,
+              expect[1], 1e-9);
+}
+
+TEST(PanZoomViewport, UnallocatedViewport) {
+  // A viewport which has not been allocated is treated as a single pixel
+  GtkPanZoomViewport viewport = {{1, 2}, 3, 0, 0};
+  EXPECT_DOUBLE_EQ(gtk_panzoom_viewport_get_pixel_size(&viewport), 3.0);
+  double point[2] = {0, 0};
+  gtk_panzoom_viewport_inverse_transform_points(&viewport, point, point, 1);
+  gtk_panzoom_viewport_transform_points(&viewport, point, point, 1);
+  EXPECT_DOUBLE_EQ(point[0], 0);
+  EXPECT_DOUBLE_EQ(point[1], 0);
+}
+
+TEST(PanZoomViewport, DeviceRect) {
+  // One virtual unit is 32 pixels. The visible rectangle is [-3.5, 16.5] x
+  // [12.25, 27.25].
+  cairo_rectangle_int_t out;
+  const double kInside[4] = {0.0, 20.0, 1.0, 21.0};
+  gtk_panzoom_viewport_get_device_rect(&kViewport, kInside, 0, &out);
+  EXPECT_EQ(out.x, 112);
+  EXPECT_EQ(out.y, 200);
+  EXPECT_EQ(out.width, 32);
+  EXPECT_EQ(out.height, 32);
+
+  // The margin is in pixels, and partial pixels are covered
+  const double kPartial[4] = {0.01, 20.01, 0.99, 20.99};
+  gtk_panzoom_viewport_get_device_rect(&kViewport, kPartial, 2, &out);
+  EXPECT_EQ(out.x, 110);
+  EXPECT_EQ(out.y, 198);
+  EXPECT_EQ(out.width, 36);
+  EXPECT_EQ(out.height, 36);
+
+  // Clamped at every edge of the viewport
+  const double kCovering[4] = {-100, -100, 100, 100};
+  gtk_panzoom_viewport_get_device_rect(&kViewport, kCovering, 1, &out);
+  EXPECT_EQ(out.x, 0);
+  EXPECT_EQ(out.y, 0);
+  EXPECT_EQ(out.width, 640);
+  EXPECT_EQ(out.height, 480);
+
+  const double kOverlapsBottomLeft[4] = {-10, 0, -3.0, 13.0};
+  gtk_panzoom_viewport_get_device_rect(&kViewport, kOverlapsBottomLeft, 0,
+                                       &out);
+  EXPECT_EQ(out.x, 0);
+  EXPECT_EQ(out.y, 456);
+  EXPECT_EQ(out.width, 16);
+  EXPECT_EQ(out.height, 24);
+
+  // Entirely outside of the viewport
+  const double kOutside[4] = {50, 50, 60, 60};
+  gtk_panzoom_viewport_get_device_rect(&kViewport, kOutside, 1, &out);
+  EXPECT_EQ(out.width, 0);
+  EXPECT_EQ(out.height, 0);
+}
+
+TEST(PanZoomViewport, Equal) {
+  GtkPanZoomViewport other = kViewport;
+  EXPECT_TRUE(gtk_panzoom_viewport_equal(&kViewport, &other));
+  other.width++;
+  EXPECT_FALSE(gtk_panzoom_viewport_equal(&kViewport, &other));
+  other = kViewport;
+  other.offset[1] += 1e-9;
+  EXPECT_FALSE(gtk_panzoom_viewport_equal(&kViewport, &other));
+}
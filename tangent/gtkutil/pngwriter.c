@@ -0,0 +1,237 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/gtkutil/pngwriter.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <png.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct _GtkPanZoomPngWriter {
+  FILE* file;
+  png_structp png;
+  png_infop info;
+  uint32_t width;
+  uint32_t height;
+  uint32_t rows_written;
+  uint8_t* row;     ///< one row converted to RGBA
+  char error[256];  ///< description of the last failure
+};
+
+// Store a copy of the formatted message in `error`, if it is not NULL, for
+// the caller to free()
+static void set_error(char** error, const char* format, ...) {
+  if (!error) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int size = vsnprintf(NULL, 0, format, args) + 1;
+  va_end(args);
+  *error = malloc(size);
+  va_start(args, format);
+  vsnprintf(*error, size, format, args);
+  va_end(args);
+}
+
+// Record the libpng error message and unwind to the setjmp() of the call
+// which failed
+static void on_png_error(png_structp png, png_const_charp message) {
+  GtkPanZoomPngWriter* writer = png_get_error_ptr(png);
+  snprintf(writer->error, sizeof(writer->error), "libpng: %s", message);
+  longjmp(png_jmpbuf(png), 1);
+}
+
+static void on_png_warning(png_structp png, png_const_charp message) {}
+
+// Convert a row of premultiplied ARGB32 pixels to straight RGBA bytes
+static void unpremultiply_row(const uint32_t* in, uint8_t* out,
+                              uint32_t width) {
+  for (uint32_t idx = 0; idx < width; idx++, out += 4) {
+    uint32_t pixel = in[idx];
+    uint32_t alpha = pixel >> 24;
+    if (alpha == 0) {
+      out[0] = out[1] = out[2] = out[3] = 0;
+      continue;
+    }
+    uint32_t rgb[3] = {(pixel >> 16) & 0xff, (pixel >> 8) & 0xff,
+                       pixel & 0xff};
+    for (size_t channel = 0; channel < 3; channel++) {
+      out[channel] = (uint8_t)((rgb[channel] * 255 + alpha / 2) / alpha);
+    }
+    out[3] = (uint8_t)alpha;
+  }
+}
+
+GtkPanZoomPngWriter* gtk_panzoom_png_writer_new(const char* path,
+                                                uint32_t width,
+                                                uint32_t height,
+                                                char** error) {
+  GtkPanZoomPngWriter* writer = calloc(1, sizeof(GtkPanZoomPngWriter));
+  writer->width = width;
+  writer->height = height;
+  writer->row = malloc(4 * (size_t)width);
+
+  writer->file = fopen(path, "wb");
+  if (!writer->file) {
+    snprintf(writer->error, sizeof(writer->error), "Failed to open %s: %s",
+             path, strerror(errno));
+    goto fail;
+  }
+  writer->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, writer,
+                                        on_png_error, on_png_warning);
+  if (writer->png) {
+    writer->info = png_create_info_struct(writer->png);
+  }
+  if (!writer->info) {
+    snprintf(writer->error, sizeof(writer->error),
+             "Failed to initialize libpng");
+    goto fail;
+  }
+  if (setjmp(png_jmpbuf(writer->png))) {
+    goto fail;
+  }
+  // NOTE(josh): libpng rejects images wider or taller than one million
+  // pixels unless the limits are raised
+  png_set_user_limits(writer->png, width, height);
+  png_init_io(writer->png, writer->file);
+  png_set_IHDR(writer->png, writer->info, width, height, 8,
+               PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(writer->png, writer->info);
+  return writer;
+
+fail:
+  set_error(error, "%s", writer->error);
+  gtk_panzoom_png_writer_free(writer);
+  return NULL;
+}
+
+int gtk_panzoom_png_writer_write_rows(GtkPanZoomPngWriter* writer,
+                                      const uint8_t* data, int stride,
+                                      uint32_t nrows) {
+  if (writer->rows_written + nrows > writer->height) {
+    snprintf(writer->error, sizeof(writer->error),
+             "Too many rows: %u + %u > %u", writer->rows_written, nrows,
+             writer->height);
+    return 0;
+  }
+  if (setjmp(png_jmpbuf(writer->png))) {
+    return 0;
+  }
+  for (uint32_t idx = 0; idx < nrows; idx++) {
+    unpremultiply_row((const uint32_t*)(data + (size_t)idx * stride),
+                      writer->row, writer->width);
+    png_write_row(writer->png, writer->row);
+  }
+  writer->rows_written += nrows;
+  return 1;
+}
+
+int gtk_panzoom_png_writer_finish(GtkPanZoomPngWriter* writer) {
+  if (writer->rows_written != writer->height) {
+    snprintf(writer->error, sizeof(writer->error),
+             "Only %u of %u rows were written", writer->rows_written,
+             writer->height);
+    return 0;
+  }
+  if (setjmp(png_jmpbuf(writer->png))) {
+    return 0;
+  }
+  png_write_end(writer->png, writer->info);
+  int result = fclose(writer->file);
+  writer->file = NULL;
+  if (result != 0) {
+    snprintf(writer->error, sizeof(writer->error), "Failed to close: %s",
+             strerror(errno));
+    return 0;
+  }
+  return 1;
+}
+
+const char* gtk_panzoom_png_writer_get_error(
+    const GtkPanZoomPngWriter* writer) {
+  return writer->error[0] ? writer->error : NULL;
+}
+
+void gtk_panzoom_png_writer_free(GtkPanZoomPngWriter* writer) {
+  if (!writer) {
+    return;
+  }
+  if (writer->png) {
+    png_destroy_write_struct(&writer->png, &writer->info);
+  }
+  if (writer->file) {
+    fclose(writer->file);
+  }
+  free(writer->row);
+  free(writer);
+}
+
+int gtk_panzoom_png_export(const char* path, const double rect[4],
+                           double pixel_size, int tile_size,
+                           GtkPanZoomExportBandFunc render_band,
+                           void* user_data, char** error) {
+  double dims[2] = {ceil((rect[2] - rect[0]) / pixel_size),
+                    ceil((rect[3] - rect[1]) / pixel_size)};
+  if (!(pixel_size > 0) || tile_size < 1 || !(dims[0] >= 1) ||
+      !(dims[1] >= 1) || dims[0] > INT_MAX / 4 || dims[1] > INT_MAX) {
+    set_error(error, "Invalid export of (%g, %g, %g, %g) at pixel size %g",
+              rect[0], rect[1], rect[2], rect[3], pixel_size);
+    return 0;
+  }
+  int width = (int)dims[0];
+  int height = (int)dims[1];
+
+  GtkPanZoomPngWriter* writer =
+      gtk_panzoom_png_writer_new(path, width, height, error);
+  if (!writer) {
+    return 0;
+  }
+
+  // NOTE(josh): only one band of rows is held in memory at a time. Each tile
+  // of the band is rendered through a surface which refers to a region of the
+  // band, so tiles can be rendered concurrently without copying.
+  int band_height = tile_size < height ? tile_size : height;
+  int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+  uint8_t* band = malloc((size_t)stride * band_height);
+  size_t ntiles = ((size_t)width + tile_size - 1) / tile_size;
+  GtkPanZoomExportTile* tiles = calloc(ntiles, sizeof(GtkPanZoomExportTile));
+
+  int ok = 1;
+  for (int row = 0; ok && row < height; row += band_height) {
+    int rows = band_height < height - row ? band_height : height - row;
+    memset(band, 0, (size_t)stride * rows);
+    for (size_t idx = 0; idx < ntiles; idx++) {
+      int col = (int)idx * tile_size;
+      int cols = tile_size < width - col ? tile_size : width - col;
+      GtkPanZoomExportTile* tile = &tiles[idx];
+      tile->viewport.offset[0] = rect[0] + col * pixel_size;
+      tile->viewport.offset[1] = rect[3] - (row + rows) * pixel_size;
+      tile->viewport.scale = (cols > rows ? cols : rows) * pixel_size;
+      tile->viewport.width = cols;
+      tile->viewport.height = rows;
+      tile->surface = cairo_image_surface_create_for_data(
+          band + 4 * (size_t)col, CAIRO_FORMAT_ARGB32, cols, rows, stride);
+    }
+    render_band(tiles, ntiles, user_data);
+    for (size_t idx = 0; idx < ntiles; idx++) {
+      cairo_surface_flush(tiles[idx].surface);
+      cairo_surface_destroy(tiles[idx].surface);
+      tiles[idx].surface = NULL;
+    }
+    ok = gtk_panzoom_png_writer_write_rows(writer, band, stride, rows);
+  }
+  ok = ok && gtk_panzoom_png_writer_finish(writer);
+  if (!ok) {
+    set_error(error, "%s", gtk_panzoom_png_writer_get_error(writer));
+  }
+
+  free(tiles);
+  free(band);
+  gtk_panzoom_png_writer_free(writer);
+  return ok;
+}
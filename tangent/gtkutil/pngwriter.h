@@ -0,0 +1,74 @@
+#pragma once
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cairo/cairo.h>
+
+#include "tangent/gtkutil/panzoomviewport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Writes a PNG file a few rows at a time, so that images which are far too
+/// large to hold in memory (e.g. poster exports) may be encoded as they are
+/// rendered. Rows are given in the pixel layout of CAIRO_FORMAT_ARGB32
+/// (native-endian, premultiplied alpha) and written as 8-bit RGBA.
+typedef struct _GtkPanZoomPngWriter GtkPanZoomPngWriter;
+
+/// Create `path` and write the PNG header for an image of the given size.
+/// Returns NULL on failure, in which case `error`, if not NULL, receives a
+/// message which the caller must free().
+GtkPanZoomPngWriter* gtk_panzoom_png_writer_new(const char* path,
+                                                uint32_t width,
+                                                uint32_t height,
+                                                char** error);
+
+/// Append `nrows` rows of `width` ARGB32 pixels, the first of which starts at
+/// `data`, with `stride` bytes between rows. Returns zero on failure, after
+/// which the writer may only be freed.
+int gtk_panzoom_png_writer_write_rows(GtkPanZoomPngWriter* writer,
+                                      const uint8_t* data, int stride,
+                                      uint32_t nrows);
+
+/// Write the end of the image and close the file. All rows must have been
+/// written. Returns zero on failure.
+int gtk_panzoom_png_writer_finish(GtkPanZoomPngWriter* writer);
+
+/// Return a description of the last failure, or NULL if there was none
+const char* gtk_panzoom_png_writer_get_error(
+    const GtkPanZoomPngWriter* writer);
+
+/// Close the file, if it is still open, and free the writer. A file which
+/// was not finished is incomplete.
+void gtk_panzoom_png_writer_free(GtkPanZoomPngWriter* writer);
+
+/// One tile of a band of rows of an export. `surface` refers to the pixels
+/// of the band covered by the tile and `viewport` maps them to the virtual
+/// plane.
+typedef struct _GtkPanZoomExportTile {
+  GtkPanZoomViewport viewport;
+  cairo_surface_t* surface;
+} GtkPanZoomExportTile;
+
+/// Render each of the `ntiles` tiles of one band of an export. The surfaces
+/// are transparent when this is called, and are flushed afterward.
+typedef void (*GtkPanZoomExportBandFunc)(GtkPanZoomExportTile* tiles,
+                                         size_t ntiles, void* user_data);
+
+/// Render the virtual rectangle `rect` (x_min, y_min, x_max, y_max) at
+/// `pixel_size` virtual units per pixel to a PNG file at `path`. The image is
+/// encoded one band of `tile_size` rows at a time, so the whole image is
+/// never held in memory. Each band is split into tiles of at most
+/// `tile_size` columns, which `render_band` may render concurrently. Returns
+/// zero on failure, in which case `error`, if not NULL, receives a message
+/// which the caller must free().
+int gtk_panzoom_png_export(const char* path, const double rect[4],
+                           double pixel_size, int tile_size,
+                           GtkPanZoomExportBandFunc render_band,
+                           void* user_data, char** error);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
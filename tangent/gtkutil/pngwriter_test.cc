@@ -0,0 +1,220 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <png.h>
+
+#include "tangent/gtkutil/pngwriter.h"
+
+namespace {
+
+const uint32_t kWidth = 7;
+const uint32_t kHeight = 5;
+
+// Stride of the test image, which is padded beyond the width
+const int kStride = 4 * (kWidth + 3);
+
+std::string get_path(const char* name) {
+  return ::testing::TempDir() + name;
+}
+
+// Straight (not premultiplied) RGBA value of pixel (x, y) of the test image
+void get_pixel(uint32_t x, uint32_t y, uint8_t rgba[4]) {
+  const uint8_t kAlpha[] = {0, 1, 64, 128, 200, 255, 255};
+  rgba[0] = static_cast<uint8_t>(37 * x + 11 * y);
+  rgba[1] = static_cast<uint8_t>(255 - 29 * y);
+  rgba[2] = static_cast<uint8_t>(17 * x * y);
+  rgba[3] = kAlpha[(x + y) % 7];
+}
+
+// The test image in the layout of CAIRO_FORMAT_ARGB32
+std::vector<uint32_t> make_image() {
+  std::vector<uint32_t> image(kStride / 4 * kHeight, 0xdeadbeef);
+  for (uint32_t y = 0; y < kHeight; y++) {
+    for (uint32_t x = 0; x < kWidth; x++) {
+      uint8_t rgba[4];
+      get_pixel(x, y, rgba);
+      uint32_t alpha = rgba[3];
+      uint32_t pixel = alpha << 24;
+      for (size_t channel = 0; channel < 3; channel++) {
+        uint32_t value = (rgba[channel] * alpha + 127) / 255;
+        pixel |= value << (16 - 8 * channel);
+      }
+      image[y * kStride / 4 + x] = pixel;
+    }
+  }
+  return image;
+}
+
+// Read `path` as 8-bit RGBA. Returns false if it is not a complete PNG.
+bool read_png(const std::string& path, png_image* image,
+              std::vector<uint8_t>* buffer) {
+  *image = png_image();
+  image->version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(image, path.c_str())) {
+    return false;
+  }
+  image->format = PNG_FORMAT_RGBA;
+  buffer->resize(PNG_IMAGE_SIZE(*image));
+  if (!png_image_finish_read(image, nullptr, buffer->data(), 0, nullptr)) {
+    png_image_free(image);
+    return false;
+  }
+  return true;
+}
+
+// Fill each pixel of each tile with its center in the virtual plane, rounded
+// down, as (red, green)
+void export_band(GtkPanZoomExportTile* tiles, size_t ntiles, void* user_data) {
+  int* nbands = static_cast<int*>(user_data);
+  (*nbands)++;
+  for (size_t idx = 0; idx < ntiles; idx++) {
+    cairo_surface_t* surface = tiles[idx].surface;
+    uint8_t* data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    for (int y = 0; y < tiles[idx].viewport.height; y++) {
+      for (int x = 0; x < tiles[idx].viewport.width; x++) {
+        double point[2] = {x + 0.5, y + 0.5};
+        gtk_panzoom_viewport_transform_points(&tiles[idx].viewport, point,
+                                              point, 1);
+        uint32_t red = static_cast<uint32_t>(std::floor(point[0]));
+        uint32_t green = static_cast<uint32_t>(std::floor(point[1]));
+        reinterpret_cast<uint32_t*>(data + y * stride)[x] =
+            0xff000000 | (red << 16) | (green << 8);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(PngWriter, RoundTrip) {
+  std::string path = get_path("pngwriter_round_trip.png");
+  std::vector<uint32_t> image = make_image();
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(image.data());
+
+  GtkPanZoomPngWriter* writer =
+      gtk_panzoom_png_writer_new(path.c_str(), kWidth, kHeight, nullptr);
+  ASSERT_NE(writer, nullptr);
+  // Rows may be written in bands of any size
+  ASSERT_TRUE(gtk_panzoom_png_writer_write_rows(writer, data, kStride, 2));
+  ASSERT_TRUE(gtk_panzoom_png_writer_write_rows(writer, data + 2 * kStride,
+                                                kStride, 0));
+  ASSERT_TRUE(gtk_panzoom_png_writer_write_rows(writer, data + 2 * kStride,
+                                                kStride, kHeight - 2));
+  ASSERT_TRUE(gtk_panzoom_png_writer_finish(writer));
+  EXPECT_EQ(gtk_panzoom_png_writer_get_error(writer), nullptr);
+  gtk_panzoom_png_writer_free(writer);
+
+  png_image info;
+  std::vector<uint8_t> buffer;
+  ASSERT_TRUE(read_png(path, &info, &buffer));
+  ASSERT_EQ(info.width, kWidth);
+  ASSERT_EQ(info.height, kHeight);
+  for (uint32_t y = 0; y < kHeight; y++) {
+    for (uint32_t x = 0; x < kWidth; x++) {
+      uint8_t expect[4];
+      get_pixel(x, y, expect);
+      const uint8_t* actual = &buffer[4 * (y * kWidth + x)];
+      ASSERT_EQ(actual[3], expect[3]) << "(" << x << ", " << y << ")";
+      if (expect[3] == 0) {
+        EXPECT_EQ(actual[0] | actual[1] | actual[2], 0);
+        continue;
+      }
+      // Premultiplication loses up to half a step of 255 / alpha
+      double tolerance = 0.5 + 127.5 / expect[3];
+      for (size_t channel = 0; channel < 3; channel++) {
+        EXPECT_NEAR(actual[channel], expect[channel], tolerance)
+            << "(" << x << ", " << y << ")[" << channel << "]";
+        if (expect[3] == 255) {
+          EXPECT_EQ(actual[channel], expect[channel]);
+        }
+      }
+    }
+  }
+  std::remove(path.c_str());
+}
+
+TEST(PngWriter, RejectsTooManyRows) {
+  std::string path = get_path("pngwriter_too_many_rows.png");
+  std::vector<uint32_t> image = make_image();
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(image.data());
+
+  GtkPanZoomPngWriter* writer =
+      gtk_panzoom_png_writer_new(path.c_str(), kWidth, kHeight, nullptr);
+  ASSERT_NE(writer, nullptr);
+  ASSERT_TRUE(gtk_panzoom_png_writer_write_rows(writer, data, kStride, 3));
+  EXPECT_FALSE(gtk_panzoom_png_writer_write_rows(writer, data, kStride, 3));
+  EXPECT_NE(gtk_panzoom_png_writer_get_error(writer), nullptr);
+  gtk_panzoom_png_writer_free(writer);
+  std::remove(path.c_str());
+}
+
+TEST(PngWriter, RejectsUnfinishedImage) {
+  std::string path = get_path("pngwriter_unfinished.png");
+  std::vector<uint32_t> image = make_image();
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(image.data());
+
+  GtkPanZoomPngWriter* writer =
+      gtk_panzoom_png_writer_new(path.c_str(), kWidth, kHeight, nullptr);
+  ASSERT_NE(writer, nullptr);
+  ASSERT_TRUE(
+      gtk_panzoom_png_writer_write_rows(writer, data, kStride, kHeight - 1));
+  EXPECT_FALSE(gtk_panzoom_png_writer_finish(writer));
+  EXPECT_NE(gtk_panzoom_png_writer_get_error(writer), nullptr);
+  gtk_panzoom_png_writer_free(writer);
+
+  // A writer which is freed before it is finished leaves an incomplete file
+  png_image info;
+  std::vector<uint8_t> buffer;
+  EXPECT_FALSE(read_png(path, &info, &buffer));
+  std::remove(path.c_str());
+}
+
+TEST(PngWriter, ReportsOpenFailure) {
+  char* error = nullptr;
+  EXPECT_EQ(gtk_panzoom_png_writer_new("/nonexistent/pngwriter.png", kWidth,
+                                       kHeight, &error),
+            nullptr);
+  ASSERT_NE(error, nullptr);
+  EXPECT_NE(std::string(error).find("/nonexistent/pngwriter.png"),
+            std::string::npos);
+  free(error);
+}
+
+TEST(PngWriter, ExportCoversRectInTiles) {
+  std::string path = get_path("pngwriter_export.png");
+  // 11 x 7 pixels, in bands of 4 rows and tiles of 4 columns
+  const double kRect[4] = {20.0, 30.0, 30.5, 37.0};
+  int nbands = 0;
+  char* error = nullptr;
+  ASSERT_TRUE(gtk_panzoom_png_export(path.c_str(), kRect, 1.0, 4, export_band,
+                                     &nbands, &error));
+  EXPECT_EQ(error, nullptr);
+  EXPECT_EQ(nbands, 2);
+
+  png_image info;
+  std::vector<uint8_t> buffer;
+  ASSERT_TRUE(read_png(path, &info, &buffer));
+  ASSERT_EQ(info.width, 11u);
+  ASSERT_EQ(info.height, 7u);
+  for (uint32_t y = 0; y < info.height; y++) {
+    for (uint32_t x = 0; x < info.width; x++) {
+      const uint8_t* actual = &buffer[4 * (y * info.width + x)];
+      EXPECT_EQ(actual[0], 20 + x) << "(" << x << ", " << y << ")";
+      EXPECT_EQ(actual[1], 36 - y) << "(" << x << ", " << y << ")";
+      EXPECT_EQ(actual[3], 255) << "(" << x << ", " << y << ")";
+    }
+  }
+  std::remove(path.c_str());
+
+  const double kEmpty[4] = {1.0, 1.0, 1.0, 2.0};
+  EXPECT_FALSE(gtk_panzoom_png_export(path.c_str(), kEmpty, 1.0, 4,
+                                      export_band, &nbands, &error));
+  ASSERT_NE(error, nullptr);
+  free(error);
+}
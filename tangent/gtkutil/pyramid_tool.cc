@@ -0,0 +1,92 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+//
+// Build a tiled, multi-resolution pyramid file from a PNG image, for display
+// with gtk_panzoom_area_add_raster_layer().
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "argue/argue.h"
+#include "tangent/gtkutil/panzoomraster.h"
+
+/// Parsed command line options
+struct ProgramOpts {
+  std::string infile_path;   ///< source PNG image
+  std::string outfile_path;  ///< pyramid file to write
+  int tile_size;             ///< edge length of a tile, in pixels
+};
+
+/// Configure the command line parser
+void setup_parser(argue::Parser* parser, ProgramOpts* opts) {
+  using argue::keywords::default_;
+  using argue::keywords::dest;
+  using argue::keywords::help;
+
+  // clang-format off
+  parser->add_argument(
+      "infile", dest=&opts->infile_path,
+      help="Path to the PNG image to read. Interlaced images are not "
+           "supported.");
+
+  parser->add_argument(
+      "outfile", dest=&opts->outfile_path,
+      help="Path to the pyramid file to write");
+
+  parser->add_argument(
+      "-t", "--tile-size", dest=&opts->tile_size,
+      default_=GTK_PANZOOM_RASTER_DEFAULT_TILE_SIZE,
+      help="Edge length of a tile, in pixels. Must be even.");
+  // clang-format on
+}
+
+int main(int argc, char** argv) {
+  argue::Parser::Metadata parser_opts{};
+  parser_opts.add_help = true;
+  parser_opts.name = "gtk-panzoom-pyramid";
+  parser_opts.author = "Josh Bialkowski";
+  parser_opts.copyright = "Copyright 2019";
+
+  argue::Parser parser{parser_opts};
+  ProgramOpts opts{};
+  setup_parser(&parser, &opts);
+  int parse_result = parser.parse_args(argc, argv);
+  switch (parse_result) {
+    case argue::PARSE_ABORTED:
+      exit(0);
+    case argue::PARSE_EXCEPTION:
+      exit(1);
+    case argue::PARSE_FINISHED:
+      break;
+  }
+
+  if (opts.tile_size <= 0) {
+    fmt::print(stderr, "Invalid tile size {}\n", opts.tile_size);
+    exit(1);
+  }
+
+  char* error = nullptr;
+  if (!gtk_panzoom_raster_build(opts.infile_path.c_str(),
+                                opts.outfile_path.c_str(), opts.tile_size,
+                                &error)) {
+    fmt::print(stderr, "Failed to build {}: {}\n", opts.outfile_path, error);
+    free(error);
+    exit(1);
+  }
+
+  GtkPanZoomRaster* raster =
+      gtk_panzoom_raster_open(opts.outfile_path.c_str(), &error);
+  if (!raster) {
+    fmt::print(stderr, "Failed to read back {}: {}\n", opts.outfile_path,
+               error);
+    free(error);
+    exit(1);
+  }
+  fmt::print("Wrote {} levels of {}x{} tiles for a {}x{} image\n",
+             gtk_panzoom_raster_get_level_count(raster), opts.tile_size,
+             opts.tile_size, gtk_panzoom_raster_get_width(raster),
+             gtk_panzoom_raster_get_height(raster));
+  gtk_panzoom_raster_free(raster);
+  return 0;
+}
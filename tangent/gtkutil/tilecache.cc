@@ -0,0 +1,163 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include "tangent/gtkutil/tilecache.h"
+
+#include <cstring>
+#include <list>
+#include <unordered_map>
+
+namespace {
+
+struct TileKey {
+  double zoom;
+  int64_t tile_x;
+  int64_t tile_y;
+
+  bool operator==(const TileKey& other) const {
+    return zoom == other.zoom && tile_x == other.tile_x &&
+           tile_y == other.tile_y;
+  }
+};
+
+struct TileKeyHash {
+  size_t operator()(const TileKey& key) const {
+    uint64_t zoom_bits = 0;
+    std::memcpy(&zoom_bits, &key.zoom, sizeof(zoom_bits));
+    uint64_t hash = zoom_bits;
+    hash = hash * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(key.tile_x);
+    hash = hash * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(key.tile_y);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+struct TileEntry {
+  TileKey key;
+  cairo_surface_t* surface;
+  size_t nbytes;
+};
+
+size_t get_nbytes(cairo_surface_t* surface) {
+  return static_cast<size_t>(cairo_image_surface_get_stride(surface)) *
+         static_cast<size_t>(cairo_image_surface_get_height(surface));
+}
+
+}  // namespace
+
+struct _GtkPanZoomTileCache {
+  typedef std::list<TileEntry> EntryList;
+
+  // Release the least recently used tiles until within budget, but never the
+  // most recently used tile.
+  void evict() {
+    while (size > budget && entries.size() > 1) {
+      TileEntry& entry = entries.back();
+      index.erase(entry.key);
+      size -= entry.nbytes;
+      cairo_surface_destroy(entry.surface);
+      entries.pop_back();
+    }
+  }
+
+  void erase(EntryList::iterator iter) {
+    index.erase(iter->key);
+    size -= iter->nbytes;
+    cairo_surface_destroy(iter->surface);
+    entries.erase(iter);
+  }
+
+  size_t budget;
+  size_t size;
+  EntryList entries;  ///< most recently used at the front
+  std::unordered_map<TileKey, EntryList::iterator, TileKeyHash> index;
+};
+
+GtkPanZoomTileCache* gtk_panzoom_tile_cache_new(size_t budget) {
+  GtkPanZoomTileCache* cache = new GtkPanZoomTileCache();
+  cache->budget = budget;
+  cache->size = 0;
+  return cache;
+}
+
+void gtk_panzoom_tile_cache_free(GtkPanZoomTileCache* cache) {
+  if (!cache) {
+    return;
+  }
+  gtk_panzoom_tile_cache_clear(cache);
+  delete cache;
+}
+
+cairo_surface_t* gtk_panzoom_tile_cache_lookup(GtkPanZoomTileCache* cache,
+                                               double zoom, int64_t tile_x,
+                                               int64_t tile_y) {
+  auto found = cache->index.find(TileKey{zoom, tile_x, tile_y});
+  if (found == cache->index.end()) {
+    return nullptr;
+  }
+  cache->entries.splice(cache->entries.begin(), cache->entries,
+                        found->second);
+  return cairo_surface_reference(found->second->surface);
+}
+
+void gtk_panzoom_tile_cache_insert(GtkPanZoomTileCache* cache, double zoom,
+                                   int64_t tile_x, int64_t tile_y,
+                                   cairo_surface_t* surface) {
+  TileKey key{zoom, tile_x, tile_y};
+  auto found = cache->index.find(key);
+  if (found != cache->index.end()) {
+    cache->erase(found->second);
+  }
+
+  TileEntry entry{key, cairo_surface_reference(surface), get_nbytes(surface)};
+  cache->entries.push_front(entry);
+  cache->index[key] = cache->entries.begin();
+  cache->size += entry.nbytes;
+  cache->evict();
+}
+
+void gtk_panzoom_tile_cache_clear(GtkPanZoomTileCache* cache) {
+  for (TileEntry& entry : cache->entries) {
+    cairo_surface_destroy(entry.surface);
+  }
+  cache->entries.clear();
+  cache->index.clear();
+  cache->size = 0;
+}
+
+size_t gtk_panzoom_tile_cache_remove_rect(GtkPanZoomTileCache* cache,
+                                          const double rect[4], int tile_size,
+                                          double margin) {
+  size_t count = 0;
+  auto iter = cache->entries.begin();
+  while (iter != cache->entries.end()) {
+    const TileKey& key = iter->key;
+    double extent = tile_size * key.zoom;
+    double pad = margin * key.zoom;
+    if (key.tile_x * extent < rect[2] + pad &&
+        (key.tile_x + 1) * extent > rect[0] - pad &&
+        key.tile_y * extent < rect[3] + pad &&
+        (key.tile_y + 1) * extent > rect[1] - pad) {
+      cache->erase(iter++);
+      count++;
+    } else {
+      ++iter;
+    }
+  }
+  return count;
+}
+
+void gtk_panzoom_tile_cache_set_budget(GtkPanZoomTileCache* cache,
+                                       size_t budget) {
+  cache->budget = budget;
+  cache->evict();
+}
+
+size_t gtk_panzoom_tile_cache_get_budget(const GtkPanZoomTileCache* cache) {
+  return cache->budget;
+}
+
+size_t gtk_panzoom_tile_cache_get_size(const GtkPanZoomTileCache* cache) {
+  return cache->size;
+}
+
+size_t gtk_panzoom_tile_cache_get_count(const GtkPanZoomTileCache* cache) {
+  return cache->entries.size();
+}
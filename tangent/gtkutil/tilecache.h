@@ -0,0 +1,67 @@
+#pragma once
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cairo/cairo.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Least-recently-used cache of rendered tiles. Tiles are keyed by a zoom
+/// level (any value which identifies the resolution at which the tile was
+/// rendered, such as the pixel size) and integer tile coordinates. The cache
+/// holds a reference to each tile surface and releases the least recently
+/// used tiles whenever the total size of the image data exceeds the budget.
+typedef struct _GtkPanZoomTileCache GtkPanZoomTileCache;
+
+/// Create a new, empty, cache which retains at most `budget` bytes of image
+/// data.
+GtkPanZoomTileCache* gtk_panzoom_tile_cache_new(size_t budget);
+
+/// Release all tiles and free the cache
+void gtk_panzoom_tile_cache_free(GtkPanZoomTileCache* cache);
+
+/// Return a new reference to the tile at the given key, or NULL if it is not
+/// in the cache. The caller must cairo_surface_destroy() the returned
+/// surface. The tile becomes the most recently used.
+cairo_surface_t* gtk_panzoom_tile_cache_lookup(GtkPanZoomTileCache* cache,
+                                               double zoom, int64_t tile_x,
+                                               int64_t tile_y);
+
+/// Add a tile to the cache, replacing any existing tile with the same key.
+/// The cache takes a new reference to `surface`. Less recently used tiles
+/// are released until the cache is within its budget, though the tile just
+/// inserted is always retained.
+void gtk_panzoom_tile_cache_insert(GtkPanZoomTileCache* cache, double zoom,
+                                   int64_t tile_x, int64_t tile_y,
+                                   cairo_surface_t* surface);
+
+/// Release all tiles
+void gtk_panzoom_tile_cache_clear(GtkPanZoomTileCache* cache);
+
+/// Release the tiles which intersect `rect` (x_min, y_min, x_max, y_max),
+/// assuming that the zoom of each tile is its pixel size and that tile
+/// (i, j) spans [i, i + 1) * tile_size * zoom by [j, j + 1) * tile_size *
+/// zoom. `rect` is grown by `margin` pixels at the zoom of each tile.
+/// Returns the number of tiles released.
+size_t gtk_panzoom_tile_cache_remove_rect(GtkPanZoomTileCache* cache,
+                                          const double rect[4], int tile_size,
+                                          double margin);
+
+/// Change the budget, releasing tiles if necessary
+void gtk_panzoom_tile_cache_set_budget(GtkPanZoomTileCache* cache,
+                                       size_t budget);
+
+size_t gtk_panzoom_tile_cache_get_budget(const GtkPanZoomTileCache* cache);
+
+/// Return the number of bytes of image data currently retained
+size_t gtk_panzoom_tile_cache_get_size(const GtkPanZoomTileCache* cache);
+
+/// Return the number of tiles currently retained
+size_t gtk_panzoom_tile_cache_get_count(const GtkPanZoomTileCache* cache);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
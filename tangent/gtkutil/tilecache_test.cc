@@ -0,0 +1,180 @@
+// Copyright (C) 2014,2019 Josh Bialkowski (josh.bialkowski@gmail.com)
+#include <gtest/gtest.h>
+
+#include "tangent/gtkutil/tilecache.h"
+
+namespace {
+
+const int kTileSize = 4;
+
+cairo_surface_t* make_tile() {
+  return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, kTileSize,
+                                    kTileSize);
+}
+
+// Return the number of bytes the cache charges for one tile
+size_t get_tile_bytes() {
+  cairo_surface_t* tile = make_tile();
+  size_t nbytes = static_cast<size_t>(cairo_image_surface_get_stride(tile)) *
+                  cairo_image_surface_get_height(tile);
+  cairo_surface_destroy(tile);
+  return nbytes;
+}
+
+// Insert a new tile and drop the local reference, so the cache holds the only
+// one
+void insert_tile(GtkPanZoomTileCache* cache, double zoom, int64_t tile_x,
+                 int64_t tile_y) {
+  cairo_surface_t* tile = make_tile();
+  gtk_panzoom_tile_cache_insert(cache, zoom, tile_x, tile_y, tile);
+  cairo_surface_destroy(tile);
+}
+
+// Return true if the tile is in the cache. This marks it as most recently
+// used.
+bool contains(GtkPanZoomTileCache* cache, double zoom, int64_t tile_x,
+              int64_t tile_y) {
+  cairo_surface_t* tile =
+      gtk_panzoom_tile_cache_lookup(cache, zoom, tile_x, tile_y);
+  if (!tile) {
+    return false;
+  }
+  cairo_surface_destroy(tile);
+  return true;
+}
+
+}  // namespace
+
+TEST(TileCache, LookupReturnsNewReference) {
+  GtkPanZoomTileCache* cache = gtk_panzoom_tile_cache_new(1 << 20);
+  EXPECT_EQ(gtk_panzoom_tile_cache_lookup(cache, 1.0, 0, 0), nullptr);
+
+  cairo_surface_t* tile = make_tile();
+  gtk_panzoom_tile_cache_insert(cache, 1.0, 2, -3, tile);
+  EXPECT_EQ(cairo_surface_get_reference_count(tile), 2u);
+
+  cairo_surface_t* found = gtk_panzoom_tile_cache_lookup(cache, 1.0, 2, -3);
+  EXPECT_EQ(found, tile);
+  EXPECT_EQ(cairo_surface_get_reference_count(tile), 3u);
+  cairo_surface_destroy(found);
+
+  // Each part of the key matters
+  EXPECT_FALSE(contains(cache, 0.5, 2, -3));
+  EXPECT_FALSE(contains(cache, 1.0, -3, 2));
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 1u);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_size(cache), get_tile_bytes());
+
+  gtk_panzoom_tile_cache_free(cache);
+  EXPECT_EQ(cairo_surface_get_reference_count(tile), 1u);
+  cairo_surface_destroy(tile);
+}
+
+TEST(TileCache, EvictsLeastRecentlyUsed) {
+  GtkPanZoomTileCache* cache =
+      gtk_panzoom_tile_cache_new(3 * get_tile_bytes());
+  insert_tile(cache, 1.0, 0, 0);
+  insert_tile(cache, 1.0, 1, 0);
+  insert_tile(cache, 1.0, 2, 0);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 3u);
+
+  // A lookup makes (0, 0) the most recently used, so (1, 0) is evicted
+  EXPECT_TRUE(contains(cache, 1.0, 0, 0));
+  insert_tile(cache, 1.0, 3, 0);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 3u);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_size(cache), 3 * get_tile_bytes());
+  EXPECT_FALSE(contains(cache, 1.0, 1, 0));
+
+  // Order of use is now (0, 0), (3, 0), (2, 0), oldest first
+  EXPECT_TRUE(contains(cache, 1.0, 0, 0));
+  EXPECT_TRUE(contains(cache, 1.0, 3, 0));
+  EXPECT_TRUE(contains(cache, 1.0, 2, 0));
+  gtk_panzoom_tile_cache_set_budget(cache, get_tile_bytes());
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_budget(cache), get_tile_bytes());
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 1u);
+  EXPECT_TRUE(contains(cache, 1.0, 2, 0));
+
+  gtk_panzoom_tile_cache_clear(cache);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 0u);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_size(cache), 0u);
+  gtk_panzoom_tile_cache_free(cache);
+}
+
+TEST(TileCache, InsertedTileIsAlwaysKept) {
+  GtkPanZoomTileCache* cache =
+      gtk_panzoom_tile_cache_new(get_tile_bytes() / 2);
+  insert_tile(cache, 1.0, 0, 0);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 1u);
+  EXPECT_TRUE(contains(cache, 1.0, 0, 0));
+
+  insert_tile(cache, 1.0, 1, 0);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 1u);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_size(cache), get_tile_bytes());
+  EXPECT_FALSE(contains(cache, 1.0, 0, 0));
+  EXPECT_TRUE(contains(cache, 1.0, 1, 0));
+
+  gtk_panzoom_tile_cache_set_budget(cache, 0);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 1u);
+  gtk_panzoom_tile_cache_free(cache);
+}
+
+TEST(TileCache, InsertReplacesExistingKey) {
+  GtkPanZoomTileCache* cache = gtk_panzoom_tile_cache_new(1 << 20);
+  cairo_surface_t* first = make_tile();
+  cairo_surface_t* second = make_tile();
+  gtk_panzoom_tile_cache_insert(cache, 0.25, 5, 7, first);
+  gtk_panzoom_tile_cache_insert(cache, 0.25, 5, 7, second);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 1u);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_size(cache), get_tile_bytes());
+  EXPECT_EQ(cairo_surface_get_reference_count(first), 1u);
+
+  cairo_surface_t* found = gtk_panzoom_tile_cache_lookup(cache, 0.25, 5, 7);
+  EXPECT_EQ(found, second);
+  cairo_surface_destroy(found);
+
+  gtk_panzoom_tile_cache_free(cache);
+  cairo_surface_destroy(first);
+  cairo_surface_destroy(second);
+}
+
+TEST(TileCache, RemoveRect) {
+  // At zoom 0.5 each tile spans kTileSize * 0.5 = 2 virtual units, and at
+  // zoom 1.0 it spans 4
+  GtkPanZoomTileCache* cache = gtk_panzoom_tile_cache_new(1 << 20);
+  const double kRect[4] = {2.5, 0.5, 3.0, 1.0};
+
+  for (int64_t tile_x = -1; tile_x < 3; tile_x++) {
+    insert_tile(cache, 0.5, tile_x, 0);
+  }
+  insert_tile(cache, 0.5, 1, 1);
+  insert_tile(cache, 1.0, 0, 0);
+  insert_tile(cache, 1.0, 1, 0);
+
+  // Without a margin only the tiles which overlap the rectangle go
+  EXPECT_EQ(gtk_panzoom_tile_cache_remove_rect(cache, kRect, kTileSize, 0),
+            2u);
+  EXPECT_FALSE(contains(cache, 0.5, 1, 0));
+  EXPECT_FALSE(contains(cache, 1.0, 0, 0));
+  EXPECT_TRUE(contains(cache, 0.5, 0, 0));
+  EXPECT_TRUE(contains(cache, 0.5, 2, 0));
+  EXPECT_TRUE(contains(cache, 0.5, 1, 1));
+  EXPECT_TRUE(contains(cache, 1.0, 1, 0));
+  insert_tile(cache, 0.5, 1, 0);
+  insert_tile(cache, 1.0, 0, 0);
+
+  // A margin of two pixels grows the rectangle to [1.5, 4.0] x [-0.5, 2.0]
+  // at zoom 0.5, which reaches tile 0 but only touches the edges of tile 2
+  // and of row 1. At zoom 1.0 it is [0.5, 5.0] x [-1.5, 3.0], which reaches
+  // tile 1.
+  EXPECT_EQ(gtk_panzoom_tile_cache_remove_rect(cache, kRect, kTileSize, 2),
+            4u);
+  EXPECT_FALSE(contains(cache, 0.5, 0, 0));
+  EXPECT_FALSE(contains(cache, 0.5, 1, 0));
+  EXPECT_FALSE(contains(cache, 1.0, 0, 0));
+  EXPECT_FALSE(contains(cache, 1.0, 1, 0));
+  EXPECT_TRUE(contains(cache, 0.5, -1, 0));
+  EXPECT_TRUE(contains(cache, 0.5, 2, 0));
+  EXPECT_TRUE(contains(cache, 0.5, 1, 1));
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_count(cache), 3u);
+  EXPECT_EQ(gtk_panzoom_tile_cache_get_size(cache), 3 * get_tile_bytes());
+  gtk_panzoom_tile_cache_free(cache);
+}
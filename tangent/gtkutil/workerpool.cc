@@ -0,0 +1,106 @@
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+#include "tangent/gtkutil/workerpool.h"
+
+#include <atomic>
+
+namespace colormap {
+
+// One call to `run()`. It is queued once for each pool thread which may help,
+// and is shared so that queue entries may outlive the call which created
+// them.
+struct WorkerPool::Batch {
+  // Claim and run indices until none are left
+  void drain() {
+    size_t ncalls = 0;
+    for (size_t idx = next++; idx < nworkers; idx = next++) {
+      fn(idx);
+      ncalls++;
+    }
+    if (ncalls) {
+      std::lock_guard<std::mutex> lock(mutex);
+      nfinished += ncalls;
+      if (nfinished == nworkers) {
+        cv.notify_all();
+      }
+    }
+  }
+
+  std::function<void(size_t)> fn;
+  size_t nworkers;
+  std::atomic<size_t> next;
+  size_t nfinished;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+WorkerPool::WorkerPool() : quit_{false} {}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+WorkerPool* WorkerPool::get_default() {
+  static WorkerPool pool;
+  return &pool;
+}
+
+void WorkerPool::run(size_t nworkers,
+                     const std::function<void(size_t)>& fn) {
+  if (nworkers < 2) {
+    if (nworkers) {
+      fn(0);
+    }
+    return;
+  }
+
+  std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+  batch->fn = fn;
+  batch->nworkers = nworkers;
+  batch->next = 0;
+  batch->nfinished = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (threads_.size() < nworkers - 1) {
+      threads_.emplace_back(&WorkerPool::thread_main, this);
+    }
+    for (size_t idx = 1; idx < nworkers; idx++) {
+      queue_.push_back(batch);
+    }
+  }
+  cv_.notify_all();
+
+  batch->drain();
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  batch->cv.wait(lock,
+                 [&batch] { return batch->nfinished == batch->nworkers; });
+}
+
+size_t WorkerPool::get_nthreads() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return threads_.size();
+}
+
+void WorkerPool::thread_main() {
+  while (true) {
+    std::shared_ptr<Batch> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return quit_ || !queue_.empty(); });
+      if (quit_) {
+        return;
+      }
+      batch = queue_.front();
+      queue_.pop_front();
+    }
+    batch->drain();
+  }
+}
+
+}  // namespace colormap
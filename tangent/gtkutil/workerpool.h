@@ -0,0 +1,48 @@
+#pragma once
+// Copyright 2018 Josh Bialkowski <josh.bialkowski@gmail.com>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace colormap {
+
+/// Persistent pool of threads for splitting data-parallel work, such as
+/// colorizing the rows of a field on every frame, without paying for thread
+/// creation on each call. Threads are started on demand and then re-used by
+/// all later calls.
+class WorkerPool {
+ public:
+  WorkerPool();
+  ~WorkerPool();
+
+  /// Return the process-wide pool shared by the colormap renderers
+  static WorkerPool* get_default();
+
+  /// Call `fn(idx)` once for each `idx` in [0, nworkers) and return when all
+  /// calls have finished. The calling thread is one of the workers, and also
+  /// picks up any indices which no pool thread has started, so `run()` never
+  /// waits on work queued by other callers.
+  void run(size_t nworkers, const std::function<void(size_t)>& fn);
+
+  /// Return the number of threads started so far
+  size_t get_nthreads();
+
+ private:
+  struct Batch;
+
+  void thread_main();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<Batch>> queue_;
+  std::vector<std::thread> threads_;
+  bool quit_;
+};
+
+}  // namespace colormap